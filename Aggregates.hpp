@@ -0,0 +1,58 @@
+// Aggregates.hpp
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <cmath>
+#include "ColumnStore.h"
+
+// Scalar aggregates over fetched rows, one per query category
+
+inline double average_result(const ColumnStore::Rows& rows){
+    double sum = 0.00;
+    int count = 0;
+    for (auto const& pr : rows) {
+        const auto& r = pr.second;
+        sum = sum + r.resalePrice;
+        count++;
+    }
+    return sum/count;
+}
+
+inline double min_result(const ColumnStore::Rows& rows){
+    double min = 999999999999;
+    for (auto const& pr : rows) {
+        const auto& r = pr.second;
+        if(min>= r.resalePrice){
+            min = r.resalePrice;
+        }
+    }
+    return min;
+}
+
+inline double min_result_per_sqm(const ColumnStore::Rows& rows){
+    double min = 999999999999;
+    for (auto const& pr : rows) {
+        const auto& r = pr.second;
+        if(min>= r.resalePrice / r.floorArea){
+            min = r.resalePrice / r.floorArea;
+        }
+    }
+    return min;
+}
+
+inline double sd_result(const ColumnStore::Rows& rows){
+    double sum = 0.00;
+    double squared_sum = 0.00;
+    int count = 0;
+    for (auto const& pr : rows) {
+        const auto& r = pr.second;
+        sum = sum + r.resalePrice;
+        squared_sum = squared_sum + r.resalePrice * r.resalePrice;
+        count++;
+    }
+
+    double mean = sum/count;
+    double variance = squared_sum/count - mean * mean;
+    return std::sqrt(variance);
+}
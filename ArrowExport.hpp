@@ -0,0 +1,465 @@
+// ArrowExport.hpp
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "ColumnStore.h"
+#include "QueryArena.hpp"
+#include "Metrics.hpp"
+
+// Just enough of a FlatBuffers writer for the Arrow IPC metadata. Like the
+// reference builder it fills the buffer back to front: children are written
+// before the tables that point at them, so every offset points forward.
+// Objects are named by their distance from the end of the buffer.
+class FlatBufferBuilder {
+public:
+    using Ref = uint32_t;
+
+    Ref createString(std::string_view s) {
+        pad(s.size() + 1, 4);
+        prepend("", 1);
+        prepend(s.data(), s.size());
+        return prependScalar(uint32_t(s.size()));
+    }
+
+    // Vector of fixed-layout structs (Arrow's are all 8-aligned)
+    template<typename T>
+    Ref createStructVector(const std::vector<T> &v) {
+        pad(v.size() * sizeof(T), 8);
+        prepend(v.data(), v.size() * sizeof(T));
+        return prependScalar(uint32_t(v.size()));
+    }
+
+    // Vector of offsets to tables or strings
+    Ref createRefVector(const std::vector<Ref> &refs) {
+        pad(refs.size() * 4, 4);
+        for (size_t i = refs.size(); i-- > 0; ) prependScalar(uint32_t(_buf.size() + 4 - refs[i]));
+        return prependScalar(uint32_t(refs.size()));
+    }
+
+    // A table is startTable(), add*() per present field, endTable()
+    void startTable() { _fields.clear(); }
+
+    template<typename T>
+    void addScalar(int slot, T value) {
+        Field f{ slot, sizeof(T), false, 0, {} };
+        std::memcpy(f.bytes, &value, sizeof(T));
+        _fields.push_back(f);
+    }
+
+    void addRef(int slot, Ref ref) { _fields.push_back({ slot, 4, true, ref, {} }); }
+
+    Ref endTable() {
+        // 1) Lay the fields out after the vtable offset, largest first, so
+        //    each one is aligned once the table start is
+        std::stable_sort(_fields.begin(), _fields.end(),
+                         [](const Field &a, const Field &b) { return a.size > b.size; });
+        size_t size = 4, align = 4;
+        int maxSlot = -1;
+        std::vector<size_t> at(_fields.size());
+        for (size_t i = 0; i < _fields.size(); i++) {
+            size = (size + _fields[i].size - 1) / _fields[i].size * _fields[i].size;
+            at[i] = size;
+            size += _fields[i].size;
+            align = std::max(align, _fields[i].size);
+            maxSlot = std::max(maxSlot, _fields[i].slot);
+        }
+        size = (size + align - 1) / align * align;
+
+        // 2) The table; it finds its vtable, written right before it, by a
+        //    signed offset back from its own start
+        pad(size, align);
+        const Ref table = Ref(_buf.size() + size);
+        std::vector<uint16_t> vtable(2 + size_t(maxSlot + 1), 0);
+        vtable[0] = uint16_t(vtable.size() * 2);
+        vtable[1] = uint16_t(size);
+        std::string bytes(size, '\0');
+        int32_t toVtable = vtable[0];
+        std::memcpy(&bytes[0], &toVtable, 4);
+        for (size_t i = 0; i < _fields.size(); i++) {
+            const Field &f = _fields[i];
+            if (f.isRef) {
+                uint32_t rel = uint32_t(table - at[i] - f.ref);
+                std::memcpy(&bytes[at[i]], &rel, 4);
+            } else {
+                std::memcpy(&bytes[at[i]], f.bytes, f.size);
+            }
+            vtable[2 + size_t(f.slot)] = uint16_t(at[i]);
+        }
+        prepend(bytes.data(), bytes.size());
+        prepend(vtable.data(), vtable.size() * 2);
+        return table;
+    }
+
+    // Root offset in front; the result is a multiple of 8 bytes long
+    std::string finish(Ref root) {
+        pad(4, 8);
+        prependScalar(uint32_t(_buf.size() + 4 - root));
+        return _buf;
+    }
+
+private:
+    struct Field {
+        int    slot;
+        size_t size;
+        bool   isRef;
+        Ref    ref;
+        char   bytes[8];
+    };
+
+    void prepend(const void *p, size_t n) { _buf.insert(0, static_cast<const char*>(p), n); }
+
+    template<typename T>
+    Ref prependScalar(T v) {
+        prepend(&v, sizeof(v));
+        return Ref(_buf.size());
+    }
+
+    // Zero-fill so that an n-byte object prepended next starts `align`-aligned
+    void pad(size_t n, size_t align) {
+        size_t over = (_buf.size() + n) % align;
+        if (over) _buf.insert(0, align - over, '\0');
+    }
+
+    std::string        _buf;
+    std::vector<Field> _fields;
+};
+
+// Fetched rows, or the whole store, as an Arrow IPC file: the format behind
+// .arrow / Feather v2, which pyarrow.ipc.open_file, pandas.read_feather,
+// Polars and DuckDB map without parsing. Numeric columns are plain
+// little-endian buffers. String columns are dictionary-encoded with the
+// store's own dictionaries: each is written once, up front, and batches carry
+// int32 codes. A string field a row doesn't hold (the covering-index path
+// only fills month and town) is null in the validity bitmap.
+class ArrowExport {
+public:
+    // Columns to write, in DataRow order; OR them together
+    enum ColumnMask : unsigned {
+        Month = 1u << 0, Town = 1u << 1, FlatType = 1u << 2, Block = 1u << 3,
+        StreetName = 1u << 4, StoreyRange = 1u << 5, FloorArea = 1u << 6,
+        FlatModel = 1u << 7, LeaseDate = 1u << 8, ResalePrice = 1u << 9,
+        AllColumns = (1u << 10) - 1
+    };
+
+    static constexpr size_t BATCH_ROWS = 64 * 1024;   // rows per record batch in exportStore
+
+    explicit ArrowExport(const ColumnStore &cs, unsigned columns = AllColumns) : _cs(cs) {
+        for (size_t c = 0; c < COLUMNS; c++) {
+            if (columns & (1u << c)) _columns.push_back(c);
+        }
+    }
+
+    // Create `path` and write the schema and every dictionary
+    bool open(const std::string &path) {
+        _path = path;
+        _out.open(path, std::ios::binary | std::ios::trunc);
+        if (!_out) {
+            std::cerr << "Error: Could not create Arrow file: " << path << std::endl;
+            return false;
+        }
+        write("ARROW1\0\0", 8);
+
+        // Dictionaries are snapshotted here; a caller that pinned a view first
+        // gets codes for every row it can see
+        for (size_t c : _columns) {
+            if (spec(c).dict) _dictSizes.push_back((_cs.*spec(c).dict)().cardinality());
+        }
+        FlatBufferBuilder fbb;
+        writeMessage(fbb, SCHEMA, buildSchema(fbb), {}, nullptr);
+
+        size_t dictIndex = 0;
+        for (size_t c : _columns) {
+            if (!spec(c).dict) continue;
+            const Dictionary &dict = (_cs.*spec(c).dict)();
+            const size_t n = _dictSizes[dictIndex++];
+
+            std::vector<int32_t> offsets(n + 1, 0);
+            std::string text;
+            for (size_t code = 0; code < n; code++) {
+                text += dict.decode(uint32_t(code));
+                offsets[code + 1] = int32_t(text.size());
+            }
+            Body body;
+            body.nodes.push_back({ int64_t(n), 0 });
+            body.add(nullptr, 0);   // no nulls, no validity bitmap
+            body.add(offsets.data(), offsets.size() * sizeof(int32_t));
+            body.add(text.data(), text.size());
+
+            FlatBufferBuilder batch;
+            FlatBufferBuilder::Ref data = buildRecordBatch(batch, n, body);
+            batch.startTable();
+            batch.addScalar<int64_t>(0, int64_t(c));   // id
+            batch.addRef(1, data);
+            FileBlock block;
+            writeMessage(batch, DICTIONARY_BATCH, batch.endTable(), body.bytes, &block);
+            _dictionaries.push_back(block);
+        }
+        return bool(_out);
+    }
+
+    // One record batch; string fields are encoded by row ID
+    bool writeBatch(const ColumnStore::Rows &rows) {
+        const size_t n = rows.size();
+        Body body;
+        std::vector<int32_t> codes;
+        std::vector<uint8_t> valid;
+        for (size_t c : _columns) {
+            const ColumnSpec &s = spec(c);
+            if (s.dict) {
+                const Dictionary &dict = (_cs.*s.dict)();
+                codes.assign(n, 0);
+                valid.assign((n + 7) / 8, 0);
+                size_t nulls = 0;
+                for (size_t i = 0; i < n; i++) {
+                    if ((rows[i].second.*s.text).data() == nullptr) { nulls++; continue; }
+                    codes[i] = int32_t(dict.code(size_t(rows[i].first)));
+                    valid[i / 8] |= uint8_t(1u << (i % 8));
+                }
+                body.nodes.push_back({ int64_t(n), int64_t(nulls) });
+                body.add(nulls ? valid.data() : nullptr, nulls ? valid.size() : 0);
+                body.add(codes.data(), n * sizeof(int32_t));
+            } else if (s.real) {
+                body.nodes.push_back({ int64_t(n), 0 });
+                body.add(nullptr, 0);
+                body.addEach(rows, [&](const ColumnStore::DataRow &r) { return r.*s.real; });
+            } else {
+                body.nodes.push_back({ int64_t(n), 0 });
+                body.add(nullptr, 0);
+                body.addEach(rows, [&](const ColumnStore::DataRow &r) { return int32_t(r.*s.integer); });
+            }
+        }
+
+        FlatBufferBuilder fbb;
+        FileBlock block;
+        writeMessage(fbb, RECORD_BATCH, buildRecordBatch(fbb, n, body), body.bytes, &block);
+        _batches.push_back(block);
+        _rowsExported.inc(n);
+        return bool(_out);
+    }
+
+    // End-of-stream marker, then the footer that indexes every block
+    bool close() {
+        const uint32_t eos[2] = { CONTINUATION, 0 };
+        write(eos, sizeof(eos));
+
+        FlatBufferBuilder fbb;
+        FlatBufferBuilder::Ref schema       = buildSchema(fbb);
+        FlatBufferBuilder::Ref dictionaries = fbb.createStructVector(_dictionaries);
+        FlatBufferBuilder::Ref batches      = fbb.createStructVector(_batches);
+        fbb.startTable();
+        fbb.addScalar<int16_t>(0, METADATA_V5);
+        fbb.addRef(1, schema);
+        fbb.addRef(2, dictionaries);
+        fbb.addRef(3, batches);
+        std::string footer = fbb.finish(fbb.endTable());
+        write(footer.data(), footer.size());
+        const int32_t footerSize = int32_t(footer.size());
+        write(&footerSize, sizeof(footerSize));
+        write("ARROW1", 6);
+
+        _out.close();
+        if (!_out) {
+            std::cerr << "Error: Could not write Arrow file: " << _path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Fetched rows of one query; string fields view the store's dictionaries
+    static bool exportRows(const ColumnStore &cs, const ColumnStore::Rows &rows,
+                           const std::string &path, unsigned columns = AllColumns) {
+        ArrowExport out(cs, columns);
+        return out.open(path) && out.writeBatch(rows) && out.close();
+    }
+
+    // Every row visible now, BATCH_ROWS per record batch read sequentially
+    static bool exportStore(const ColumnStore &cs, const std::string &path) {
+        auto view = cs.pin();
+        ArrowExport out(cs);
+        if (!out.open(path)) return false;
+        QueryArena arena;
+        for (size_t begin = 0; begin < view.rows; begin += BATCH_ROWS) {
+            QueryArena::Scope scope(arena);
+            size_t unreadable = 0;
+            auto rows = cs.fetchRowRange(begin, std::min(view.rows, begin + BATCH_ROWS), nullptr, &unreadable);
+            if (unreadable > 0) {
+                std::cerr << "Error: " << unreadable << " rows of the store could not be read; "
+                          << path << " is incomplete" << std::endl;
+                return false;
+            }
+            if (!out.writeBatch(rows)) return false;
+        }
+        return out.close();
+    }
+
+private:
+    // Arrow's Message.fbs / Schema.fbs / File.fbs constants
+    static constexpr int16_t  METADATA_V5      = 4;
+    static constexpr uint8_t  SCHEMA           = 1;   // MessageHeader union
+    static constexpr uint8_t  DICTIONARY_BATCH = 2;
+    static constexpr uint8_t  RECORD_BATCH     = 3;
+    static constexpr uint8_t  TYPE_INT         = 2;   // Type union
+    static constexpr uint8_t  TYPE_FLOAT       = 3;
+    static constexpr uint8_t  TYPE_UTF8        = 5;
+    static constexpr int16_t  PRECISION_DOUBLE = 2;
+    static constexpr uint32_t CONTINUATION     = 0xFFFFFFFFu;
+    static constexpr size_t   COLUMNS          = 10;
+
+    struct FieldNode { int64_t length; int64_t nullCount; };
+    struct BufferRef { int64_t offset; int64_t length; };
+    struct FileBlock { int64_t offset; int32_t metaDataLength; int32_t unused; int64_t bodyLength; };
+
+    // Message body: buffers back to back, each padded to 8 bytes
+    struct Body {
+        std::string            bytes;
+        std::vector<FieldNode> nodes;
+        std::vector<BufferRef> buffers;
+
+        void add(const void *p, size_t n) {
+            buffers.push_back({ int64_t(bytes.size()), int64_t(n) });
+            if (n) bytes.append(static_cast<const char*>(p), n);
+            bytes.append((8 - bytes.size() % 8) % 8, '\0');
+        }
+        template<typename Get>
+        void addEach(const ColumnStore::Rows &rows, Get get) {
+            using T = decltype(get(rows[0].second));
+            const size_t start = bytes.size();
+            buffers.push_back({ int64_t(start), int64_t(rows.size() * sizeof(T)) });
+            bytes.resize(start + (rows.size() * sizeof(T) + 7) / 8 * 8, '\0');
+            for (size_t i = 0; i < rows.size(); i++) {
+                T v = get(rows[i].second);
+                std::memcpy(&bytes[start + i * sizeof(T)], &v, sizeof(T));
+            }
+        }
+    };
+
+    struct ColumnSpec {
+        const char *name;
+        const Dictionary& (ColumnStore::*dict)() const;   // string columns
+        std::string_view ColumnStore::DataRow::*text;
+        double ColumnStore::DataRow::*real;
+        int    ColumnStore::DataRow::*integer;
+    };
+
+    static const ColumnSpec& spec(size_t c) {
+        using R = ColumnStore::DataRow;
+        static const ColumnSpec specs[COLUMNS] = {
+            { "month",               &ColumnStore::getMonthDict,       &R::month,       nullptr,         nullptr },
+            { "town",                &ColumnStore::getTownDict,        &R::town,        nullptr,         nullptr },
+            { "flat_type",           &ColumnStore::getFlatTypeDict,    &R::flatType,    nullptr,         nullptr },
+            { "block",               &ColumnStore::getBlockDict,       &R::block,       nullptr,         nullptr },
+            { "street_name",         &ColumnStore::getStreetNameDict,  &R::streetName,  nullptr,         nullptr },
+            { "storey_range",        &ColumnStore::getStoreyRangeDict, &R::storeyRange, nullptr,         nullptr },
+            { "floor_area_sqm",      nullptr,                          nullptr,         &R::floorArea,   nullptr },
+            { "flat_model",          &ColumnStore::getFlatModelDict,   &R::flatModel,   nullptr,         nullptr },
+            { "lease_commence_date", nullptr,                          nullptr,         nullptr,         &R::leaseDate },
+            { "resale_price",        nullptr,                          nullptr,         &R::resalePrice, nullptr },
+        };
+        return specs[c];
+    }
+
+    FlatBufferBuilder::Ref buildIntType(FlatBufferBuilder &fbb) {
+        fbb.startTable();
+        fbb.addScalar<int32_t>(0, 32);   // bitWidth
+        fbb.addScalar<uint8_t>(1, 1);    // is_signed
+        return fbb.endTable();
+    }
+
+    FlatBufferBuilder::Ref buildSchema(FlatBufferBuilder &fbb) {
+        std::vector<FlatBufferBuilder::Ref> fields;
+        size_t dictIndex = 0;
+        for (size_t c : _columns) {
+            const ColumnSpec &s = spec(c);
+            FlatBufferBuilder::Ref name     = fbb.createString(s.name);
+            FlatBufferBuilder::Ref children = fbb.createRefVector({});
+            uint8_t typeType;
+            FlatBufferBuilder::Ref type, encoding = 0;
+            if (s.dict) {
+                // The field's type is the value type; codes are int32
+                typeType = TYPE_UTF8;
+                fbb.startTable();
+                type = fbb.endTable();
+                FlatBufferBuilder::Ref indexType = buildIntType(fbb);
+                fbb.startTable();
+                fbb.addScalar<int64_t>(0, int64_t(c));   // id
+                fbb.addRef(1, indexType);
+                // codes compare like their strings unless an append added a value
+                bool ordered = _dictSizes[dictIndex] <= (_cs.*s.dict)().values.size();
+                fbb.addScalar<uint8_t>(2, ordered);
+                encoding = fbb.endTable();
+                dictIndex++;
+            } else if (s.real) {
+                typeType = TYPE_FLOAT;
+                fbb.startTable();
+                fbb.addScalar<int16_t>(0, PRECISION_DOUBLE);
+                type = fbb.endTable();
+            } else {
+                typeType = TYPE_INT;
+                type = buildIntType(fbb);
+            }
+            fbb.startTable();
+            fbb.addRef(0, name);
+            fbb.addScalar<uint8_t>(1, s.dict != nullptr);   // nullable
+            fbb.addScalar<uint8_t>(2, typeType);
+            fbb.addRef(3, type);
+            if (encoding) fbb.addRef(4, encoding);
+            fbb.addRef(5, children);
+            fields.push_back(fbb.endTable());
+        }
+        FlatBufferBuilder::Ref fieldVector = fbb.createRefVector(fields);
+        fbb.startTable();
+        fbb.addRef(1, fieldVector);   // endianness defaults to little
+        return fbb.endTable();
+    }
+
+    FlatBufferBuilder::Ref buildRecordBatch(FlatBufferBuilder &fbb, size_t length, const Body &body) {
+        FlatBufferBuilder::Ref nodes   = fbb.createStructVector(body.nodes);
+        FlatBufferBuilder::Ref buffers = fbb.createStructVector(body.buffers);
+        fbb.startTable();
+        fbb.addScalar<int64_t>(0, int64_t(length));
+        fbb.addRef(1, nodes);
+        fbb.addRef(2, buffers);
+        return fbb.endTable();
+    }
+
+    // Encapsulated message: continuation marker, metadata length, Message
+    // flatbuffer padded to 8, then the body
+    void writeMessage(FlatBufferBuilder &fbb, uint8_t headerType, FlatBufferBuilder::Ref header,
+                      const std::string &body, FileBlock *block) {
+        fbb.startTable();
+        fbb.addScalar<int16_t>(0, METADATA_V5);
+        fbb.addScalar<uint8_t>(1, headerType);
+        fbb.addRef(2, header);
+        fbb.addScalar<int64_t>(3, int64_t(body.size()));
+        std::string meta = fbb.finish(fbb.endTable());
+
+        if (block) *block = { int64_t(_offset), int32_t(8 + meta.size()), 0, int64_t(body.size()) };
+        const uint32_t prefix[2] = { CONTINUATION, uint32_t(meta.size()) };
+        write(prefix, sizeof(prefix));
+        write(meta.data(), meta.size());
+        write(body.data(), body.size());
+    }
+
+    void write(const void *p, size_t n) {
+        _out.write(static_cast<const char*>(p), std::streamsize(n));
+        _offset += n;
+    }
+
+    const ColumnStore     &_cs;
+    std::vector<size_t>    _columns;
+    std::vector<size_t>    _dictSizes;      // per string column, at open()
+    std::string            _path;
+    std::ofstream          _out;
+    size_t                 _offset = 0;
+    std::vector<FileBlock> _dictionaries;
+    std::vector<FileBlock> _batches;
+
+    Counter &_rowsExported = MetricsRegistry::shared().counter("hdb_arrow_rows_exported_total", "Rows written to Arrow IPC files");
+};
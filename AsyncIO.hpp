@@ -0,0 +1,299 @@
+// AsyncIO.hpp
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/types.h>
+#include "Constants.h"
+
+// io_uring is used when the kernel headers are present; build with
+// -DHDB_NO_IO_URING to force the thread-pool backend.
+#if defined(__linux__) && !defined(HDB_NO_IO_URING) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    define HDB_HAVE_IO_URING 1
+#    include <linux/io_uring.h>
+#    include <sys/syscall.h>
+#    include <sys/mman.h>
+     // linux/fs.h (pulled in above) defines a legacy BLOCK_SIZE macro of 1024,
+     // which would silently replace our Constants.h value everywhere after here
+#    undef BLOCK_SIZE
+#    undef BLOCK_SIZE_BITS
+#  endif
+#endif
+
+// One positional read
+struct ReadRequest {
+    int    fd;
+    off_t  offset;
+    size_t length;
+    char  *buffer;
+};
+
+// One batch; callers build it on the query arena
+using ReadRequests = std::pmr::vector<ReadRequest>;
+
+// Called once per request with its index in the batch and the bytes read (or -errno)
+using ReadCallback = std::function<void(size_t, ssize_t)>;
+
+// Reads the whole range, retrying short reads; returns bytes read or -errno
+inline ssize_t preadFull(const ReadRequest &req) {
+    size_t got = 0;
+    while (got < req.length) {
+        ssize_t r = ::pread(req.fd, req.buffer + got, req.length - got, req.offset + off_t(got));
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return got > 0 ? ssize_t(got) : -errno;
+        }
+        if (r == 0) break;   // EOF
+        got += size_t(r);
+    }
+    return ssize_t(got);
+}
+
+class IoBackend {
+public:
+    virtual ~IoBackend() = default;
+
+    // Submit every request as one batch and return once all have completed.
+    // onComplete runs on the calling thread, in completion (not submission) order.
+    virtual void readBatch(const ReadRequests &requests, const ReadCallback &onComplete) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Fallback: a fixed pool of threads issuing blocking preads
+class ThreadPoolReadBackend : public IoBackend {
+public:
+    explicit ThreadPoolReadBackend(size_t threads = IO_POOL_THREADS) {
+        for (size_t i = 0; i < threads; i++) {
+            _workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPoolReadBackend() override {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cv.notify_all();
+        for (auto &t : _workers) t.join();
+    }
+
+    void readBatch(const ReadRequests &requests, const ReadCallback &onComplete) override {
+        // Nothing to overlap: do it inline
+        if (requests.size() <= 1 || _workers.empty()) {
+            for (size_t i = 0; i < requests.size(); i++) onComplete(i, preadFull(requests[i]));
+            return;
+        }
+
+        struct Batch {
+            std::mutex m;
+            std::condition_variable cv;
+            std::vector<std::pair<size_t, ssize_t>> done;
+        };
+        auto batch = std::make_shared<Batch>();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (size_t i = 0; i < requests.size(); i++) {
+                ReadRequest req = requests[i];
+                _tasks.emplace_back([batch, req, i] {
+                    ssize_t r = preadFull(req);
+                    std::lock_guard<std::mutex> bl(batch->m);
+                    batch->done.emplace_back(i, r);
+                    batch->cv.notify_one();
+                });
+            }
+        }
+        _cv.notify_all();
+
+        // Deliver completions as they arrive
+        size_t delivered = 0;
+        std::vector<std::pair<size_t, ssize_t>> ready;
+        while (delivered < requests.size()) {
+            {
+                std::unique_lock<std::mutex> bl(batch->m);
+                batch->cv.wait(bl, [&] { return !batch->done.empty(); });
+                ready.swap(batch->done);
+            }
+            for (auto &c : ready) onComplete(c.first, c.second);
+            delivered += ready.size();
+            ready.clear();
+        }
+    }
+
+    const char* name() const override { return "threadpool-pread"; }
+
+private:
+    void workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [&] { return _stopping || !_tasks.empty(); });
+                if (_stopping && _tasks.empty()) return;
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread>          _workers;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex                        _mutex;
+    std::condition_variable           _cv;
+    bool                              _stopping = false;
+};
+
+#ifdef HDB_HAVE_IO_URING
+// io_uring through the raw syscalls (no liburing dependency).
+// Rings are not thread-safe, so ioBackend() hands out one per thread.
+class IoUringBackend : public IoBackend {
+public:
+    // nullptr if the kernel (or a seccomp policy) refuses io_uring
+    static std::unique_ptr<IoUringBackend> create(unsigned entries = IO_URING_ENTRIES) {
+        std::unique_ptr<IoUringBackend> ring(new IoUringBackend());
+        if (!ring->setup(entries)) return nullptr;
+        return ring;
+    }
+
+    ~IoUringBackend() override {
+        if (_sqes && _sqes != MAP_FAILED) ::munmap(_sqes, _sqesSize);
+        if (_cqPtr && _cqPtr != _sqPtr && _cqPtr != MAP_FAILED) ::munmap(_cqPtr, _cqSize);
+        if (_sqPtr && _sqPtr != MAP_FAILED) ::munmap(_sqPtr, _sqSize);
+        if (_ringFd >= 0) ::close(_ringFd);
+    }
+
+    void readBatch(const ReadRequests &requests, const ReadCallback &onComplete) override {
+        size_t next = 0, inflight = 0, done = 0;
+        while (done < requests.size()) {
+            // 1) Queue as many reads as the rings have room for
+            unsigned tail = *_sqTail;
+            unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+            unsigned toSubmit = 0;
+            while (next < requests.size() && inflight < _cqEntries && tail - head < _sqEntries) {
+                unsigned idx = tail & _sqMask;
+                io_uring_sqe *sqe = &_sqes[idx];
+                std::memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode    = IORING_OP_READ;
+                sqe->fd        = requests[next].fd;
+                sqe->off       = uint64_t(requests[next].offset);
+                sqe->addr      = reinterpret_cast<uint64_t>(requests[next].buffer);
+                sqe->len       = unsigned(requests[next].length);
+                sqe->user_data = next;
+                _sqArray[idx]  = idx;
+                tail++; next++; inflight++; toSubmit++;
+            }
+            __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+            // 2) Submit and wait for at least one completion
+            int r;
+            do {
+                r = int(::syscall(__NR_io_uring_enter, _ringFd, toSubmit, 1u,
+                                  IORING_ENTER_GETEVENTS, nullptr, 0));
+            } while (r < 0 && errno == EINTR);
+            if (r < 0) {
+                throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+            }
+
+            // 3) Reap whatever has completed, in whatever order it completed
+            unsigned cqHead = *_cqHead;
+            unsigned cqTail = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+            while (cqHead != cqTail) {
+                io_uring_cqe *cqe = &_cqes[cqHead & _cqMask];
+                size_t i = size_t(cqe->user_data);
+                ssize_t res = cqe->res;
+                cqHead++;
+                __atomic_store_n(_cqHead, cqHead, __ATOMIC_RELEASE);
+
+                // Old kernels lack IORING_OP_READ, and reads may come back short
+                if (res < 0 || size_t(res) < requests[i].length) {
+                    res = preadFull(requests[i]);
+                }
+                onComplete(i, res);
+                inflight--;
+                done++;
+            }
+        }
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    IoUringBackend() = default;
+
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        _ringFd = int(::syscall(__NR_io_uring_setup, entries, &p));
+        if (_ringFd < 0) return false;
+
+        _sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        _cqSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) _sqSize = _cqSize = std::max(_sqSize, _cqSize);
+
+        _sqPtr = ::mmap(nullptr, _sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _ringFd, IORING_OFF_SQ_RING);
+        if (_sqPtr == MAP_FAILED) return false;
+        _cqPtr = single ? _sqPtr
+                        : ::mmap(nullptr, _cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 _ringFd, IORING_OFF_CQ_RING);
+        if (_cqPtr == MAP_FAILED) return false;
+
+        _sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+        _sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES));
+        if (_sqes == MAP_FAILED) return false;
+
+        char *sq = static_cast<char*>(_sqPtr);
+        char *cq = static_cast<char*>(_cqPtr);
+        _sqHead    = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        _sqTail    = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        _sqMask    = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        _sqArray   = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        _cqHead    = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        _cqTail    = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        _cqMask    = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        _cqes      = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        _sqEntries = p.sq_entries;
+        _cqEntries = p.cq_entries;
+        return true;
+    }
+
+    int           _ringFd = -1;
+    void         *_sqPtr = nullptr;
+    void         *_cqPtr = nullptr;
+    size_t        _sqSize = 0, _cqSize = 0, _sqesSize = 0;
+    io_uring_sqe *_sqes = nullptr;
+    io_uring_cqe *_cqes = nullptr;
+    unsigned     *_sqHead = nullptr, *_sqTail = nullptr, *_sqArray = nullptr;
+    unsigned     *_cqHead = nullptr, *_cqTail = nullptr;
+    unsigned      _sqMask = 0, _cqMask = 0, _sqEntries = 0, _cqEntries = 0;
+};
+#endif
+
+// Backend for the calling thread: its own io_uring if available, else the shared pread pool
+inline IoBackend& ioBackend() {
+#ifdef HDB_HAVE_IO_URING
+    thread_local std::unique_ptr<IoUringBackend> ring = IoUringBackend::create();
+    if (ring) return *ring;
+#endif
+    static ThreadPoolReadBackend pool;
+    return pool;
+}
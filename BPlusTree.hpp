@@ -7,19 +7,26 @@
 #include <functional>
 #include <utility>
 #include <iostream>
+#include <atomic>
 #include "DiskManager.hpp"      // see below
 #include "DiskBPlusTreeNode.hpp"
 #include "SplitResult.hpp"
 #include "Interval.h"
+#include "Metrics.hpp"
+#include "Log.hpp"
+#include "RowIdRuns.hpp"
+#include "OptimisticLatch.hpp"
 
 template<typename Key, int n, typename Compare = std::less<Key>>
 class BPlusTree {
 public:
     using Node     = DiskBPlusTreeNode<Key,n>;
-    using Result   = std::vector<std::pair<Key,int>>;
+    using Result   = std::pmr::vector<std::pair<Key,int>>;   // on the query arena
+    static_assert(sizeof(Node) <= BLOCK_SIZE, "a node must fit in one disk block; lower n");
 
     explicit BPlusTree(const std::string &filename = "bptree.dat")
     : _rootOffset(-1)
+    , _height(0)
     , _disk(filename)
     , rowCount(0)
     {}
@@ -32,6 +39,7 @@ public:
             node.isLeaf = true;
             node.info[n] = -1;    // next ptr
             _rootOffset = _disk.writeNode(node);
+            _height = 1;
         }
         auto split = insertRecursive(_rootOffset, key, recordIndex);
         if (split) {
@@ -43,48 +51,74 @@ public:
             newRoot.info[0] = _rootOffset;
             newRoot.info[1] = split->newNodeOffset;
             _rootOffset = _disk.writeNode(newRoot);
+            _height++;
             delete split;
         }
         rowCount++;
     }
 
-    // Range search [start..end]
-    Result searchRange(const Key start, const Key end, bool gotEnd = true) {
-        Result results;
-        if (_rootOffset < 0) return results;
-
-        // 1) descend to leaf
-        int offset = _rootOffset;
-        Node curr = _disk.readNode(offset);
-        while (!curr.isLeaf) {
-            // find child index
-            std::vector<Key> keysVec;
-            keysVec.reserve(curr.numKeys);
-            for (int j = 0; j < curr.numKeys; j++) {
-                keysVec.push_back(curr.getKey(j));
-            }
+    // Number of (key, record) entries inserted
+    size_t size() const { return rowCount; }
+
+    // What a snapshot records besides the node image
+    struct Shape {
+        int32_t  rootOffset;
+        int32_t  height;
+        uint64_t rows;
+        uint64_t bytes;    // node space in use
+    };
+    Shape shape() const { return { _rootOffset, _height, rowCount, _disk.bytes() }; }
+
+    // fn(block) over the node space, BLOCK_SIZE bytes at a time (see DiskManager::forEachBlock)
+    template<typename Fn>
+    bool forEachBlock(Fn &&fn) { return _disk.forEachBlock(std::forward<Fn>(fn)); }
+
+    // Adopt a node image written from a tree of this type, in place of the
+    // empty tree this one must still be. See DiskManager::attachImage.
+    void attachImage(const Shape &shape, const char *image, const uint32_t *crcs) {
+        _disk.attachImage(image, size_t(shape.bytes), crcs);
+        _rootOffset = shape.rootOffset;
+        _height     = shape.height;
+        rowCount    = size_t(shape.rows);
+    }
 
-            // 2) find the first key >= start
-            auto pos = std::lower_bound(keysVec.begin(), keysVec.end(), start, Compare{});
-            // compute child index
-            int i = int(pos - keysVec.begin());
-            offset = curr.info[i];
-            curr   = _disk.readNode(offset);
+    // ─── Concurrent mode: optimistic lock coupling ───
+    // insertConcurrent() may run on many threads at once, next to any number
+    // of readers. From the first concurrent insert on, the search functions
+    // below walk the leaf chain the same way searchRangeConcurrent() does;
+    // only insert() still needs the tree to itself.
+    //
+    // Every node has a version latch (DiskManager::latch). Readers take no
+    // latch at all: they copy a node and keep the copy only if its version
+    // did not move meanwhile. Writers split any full node on the way down,
+    // so an insert latches at most a node and its parent, and only after
+    // validating that neither changed since it was read; any conflict
+    // restarts the insert from the root.
+    void insertConcurrent(const Key key, int recordIndex) {
+        _concurrent.store(true, std::memory_order_release);
+        while (!tryInsertConcurrent(key, recordIndex)) {
+            EngineMetrics::get().olcRestarts.inc();
         }
+        rowCount++;
+    }
 
-        // 2) scan leaf chain
-        while (true) {
-            for (int i = 0; i < curr.numKeys; i++) {
-                auto k = curr.getKey(i);
-                if (gotEnd && Compare{}(end, k))      // k > end ?
-                    return results;
-                if (!Compare{}(k, start))   // k >= start ?
-                    results.emplace_back(k, curr.info[i]);
-            }
-            int next = curr.info[n];
-            if (next < 0) break;
-            curr = _disk.readNode(next);
-        }
+    // Entries with start <= key <= end, in key order. Splits only ever move
+    // keys into a new node to the right, reachable through the leaf chain, so
+    // a reader that lands on a stale (too far left) leaf still sees every key
+    // that was present before it started; keys inserted during the scan may
+    // or may not be included.
+    Result searchRangeConcurrent(const Key start, const Key end) {
+        Result results(QueryArena::current());
+        walkChain(&start, [&](const Node &leaf) { return scanLeaf(leaf, start, end, true, results); });
+        return results;
+    }
+
+    // Range search [start..end]
+    Result searchRange(const Key start, const Key end, bool gotEnd = true) {
+        Result results(QueryArena::current());
+        walkLeaves(&start, [&](const Node &leaf) {
+            return scanLeaf(leaf, start, end, gotEnd, results);
+        });
         return results;
     }
 
@@ -95,133 +129,108 @@ public:
     }*/
 
     // 1) Closed‐closed: [start, end]
-    std::vector<int> rangeClosedClosed(Key start, Key end, bool gotEnd = true) {
-        auto all = searchRange(start, end, gotEnd);   // returns std::vector<std::pair<Key,int>>
-        std::vector<int> out;
-        out.reserve(all.size());
+    // Like every range function below, returns row IDs in ascending order.
+    RowIdList rangeClosedClosed(Key start, Key end, bool gotEnd = true) {
+        auto all = searchRange(start, end, gotEnd);   // (key, row ID) pairs in key order
+        RowIdRuns runs;
+        runs.reserve(all.size());
         for (auto &pr : all) {
-            out.push_back(pr.second);
+            runs.add(pr.second);
         }
+        auto out = runs.finish();
         if (gotEnd)
         {
-            std::cout << "rangeClosedClosed[" << start << "," << end << "] -> "<< out.size() << " results\n";
+            HDB_LOG(Trace, Index, "rangeClosedClosed[" << start << "," << end << "] -> " << out.size() << " results");
         }
         return out;
     }
 
     // 2) Closed‐open: [start, end)
-    std::vector<int> rangeClosedOpen(Key start, Key end) {
+    RowIdList rangeClosedOpen(Key start, Key end) {
         auto all = searchRange(start, end);
-        std::vector<int> out;
-        out.reserve(all.size());
+        RowIdRuns runs;
+        runs.reserve(all.size());
         for (auto &pr : all) {
             if (pr.first < end)
-                out.push_back(pr.second);
+                runs.add(pr.second);
         }
-        std::cout << "rangeClosedOpen[" << start << "," << end << ") -> " << out.size() << " results\n";
+        auto out = runs.finish();
+        HDB_LOG(Trace, Index, "rangeClosedOpen[" << start << "," << end << ") -> " << out.size() << " results");
         return out;
     }
 
     // 3) Open‐closed: (start, end]
-    std::vector<int> rangeOpenClosed(Key start, Key end, bool gotEnd = true) {
+    RowIdList rangeOpenClosed(Key start, Key end, bool gotEnd = true) {
         auto all = searchRange(start, end, gotEnd);
-        std::vector<int> out;
-        out.reserve(all.size());
+        RowIdRuns runs;
+        runs.reserve(all.size());
         for (auto &pr : all) {
             if (pr.first > start)
-                out.push_back(pr.second);
+                runs.add(pr.second);
         }
+        auto out = runs.finish();
         if (gotEnd)
         {
-            std::cout << "rangeOpenClosed(" << start << "," << end << "] -> " << out.size() << " results\n";
+            HDB_LOG(Trace, Index, "rangeOpenClosed(" << start << "," << end << "] -> " << out.size() << " results");
         }
         return out;
     }
 
     // 4) Open‐open: (start, end)
-    std::vector<int> rangeOpenOpen(Key start, Key end) {
+    RowIdList rangeOpenOpen(Key start, Key end) {
         auto all = searchRange(start, end);
-        std::vector<int> out;
-        out.reserve(all.size());
+        RowIdRuns runs;
+        runs.reserve(all.size());
         for (auto &pr : all) {
             if (pr.first > start && pr.first < end)
-                out.push_back(pr.second);
+                runs.add(pr.second);
         }
-        std::cout << "rangeOpenOpen(" << start << "," << end << ") -> " << out.size() << " results\n";
+        auto out = runs.finish();
+        HDB_LOG(Trace, Index, "rangeOpenOpen(" << start << "," << end << ") -> " << out.size() << " results");
         return out;
     }
 
     // [start, ) — closed at start, unbounded end
-    std::vector<int> rangeUnboundedStartClosed(Key start) {
+    RowIdList rangeUnboundedStartClosed(Key start) {
         auto out = rangeClosedClosed(start, start, false);
-        std::cout << "rangeUnboundedStartClosed[" << start << ",) -> " << out.size() << " results\n";
-         return out;
+        HDB_LOG(Trace, Index, "rangeUnboundedStartClosed[" << start << ",) -> " << out.size() << " results");
+        return out;
     }
 
     // (start, ) — open at start, unbounded end
-    std::vector<int> rangeUnboundedStartOpen(Key start) {
+    RowIdList rangeUnboundedStartOpen(Key start) {
         auto out = rangeOpenClosed(start, start, false);
-        std::cout << "rangeUnboundedStartOpen(" << start << ",) -> " << out.size() << " results\n";
-         return out;
+        HDB_LOG(Trace, Index, "rangeUnboundedStartOpen(" << start << ",) -> " << out.size() << " results");
+        return out;
     }
 
     // [ , end]: unbounded start, closed end
-    std::vector<int> rangeUnboundedEndClosed(Key end) {
-        // build full set of record IDs [0..rowCount-1]
-        std::vector<int> full(rowCount);
-        std::iota(full.begin(), full.end(), 0);
-
-        // find all IDs with key > end ⇒ (end, ∞)
-        auto gt = rangeUnboundedStartOpen(end);
-        std::sort(gt.begin(), gt.end());
-        gt.erase(std::unique(gt.begin(), gt.end()), gt.end());
-
-        // full \ gt ⇒ all keys ≤ end
-        std::vector<int> out;
-        std::set_difference(
-            full.begin(), full.end(),
-            gt.begin(),   gt.end(),
-            std::back_inserter(out)
-        );
-        std::cout << "rangeUnboundedEndClosed(, " << end << "] -> " << out.size() << " results\n";
+    RowIdList rangeUnboundedEndClosed(Key end) {
+        auto out = scanUpTo(end, true);
+        HDB_LOG(Trace, Index, "rangeUnboundedEndClosed(, " << end << "] -> " << out.size() << " results");
         return out;
     }
-    
+
     // [ , end): unbounded start, open end
-    std::vector<int> rangeUnboundedEndOpen(Key end) {
-        // build full set of record IDs [0..rowCount-1]
-        std::vector<int> full(rowCount);
-        std::iota(full.begin(), full.end(), 0);
-
-        // find all IDs with key ≥ end ⇒ [end, ∞)
-        auto ge = rangeUnboundedStartClosed(end);
-        std::sort(ge.begin(), ge.end());
-        ge.erase(std::unique(ge.begin(), ge.end()), ge.end());
-
-        // full \ ge ⇒ all keys < end
-        std::vector<int> out;
-        std::set_difference(
-            full.begin(), full.end(),
-            ge.begin(),   ge.end(),
-            std::back_inserter(out)
-        );
-        std::cout << "rangeUnboundedEndOpen(, " << end << ") -> " << out.size() << " results\n";
+    RowIdList rangeUnboundedEndOpen(Key end) {
+        auto out = scanUpTo(end, false);
+        HDB_LOG(Trace, Index, "rangeUnboundedEndOpen(, " << end << ") -> " << out.size() << " results");
         return out;
     }
 
     // 3) The multi‑interval search
-    std::vector<int> searchIntervals(const std::vector<Interval<Key>>& intervals = {}) {
+    RowIdList searchIntervals(const std::vector<Interval<Key>>& intervals = {}) {
         // 1) No intervals ⇒ return all record IDs [0..rowCount-1]
         if (intervals.empty()) {
-            std::vector<int> out(rowCount);
+            RowIdList out(rowCount, QueryArena::current());
             std::iota(out.begin(), out.end(), 0);
             return out;
         }
 
         // 2) Otherwise, collect all matching record IDs…
-        std::vector<int> ids;
+        RowIdList ids(QueryArena::current());
         for (auto const& iv : intervals) {
-            std::vector<int> part;
+            RowIdList part(QueryArena::current());
             switch (iv.type) {
                 case IntervalType::ClosedClosed:
                     part = rangeClosedClosed(iv.start, iv.end);   break;
@@ -241,21 +250,307 @@ public:
                 case IntervalType::FromOpen:
                     part = rangeUnboundedStartOpen(iv.start);     break;
             }
-            ids.insert(ids.end(), part.begin(), part.end());
+            if (ids.empty()) {
+                ids.swap(part);
+                continue;
+            }
+            // 3) Every part is already ascending: union instead of sorting
+            RowIdList merged(QueryArena::current());
+            merged.reserve(ids.size() + part.size());
+            std::set_union(ids.begin(), ids.end(), part.begin(), part.end(), std::back_inserter(merged));
+            ids.swap(merged);
         }
-
-        // 3) Sort and unique the IDs
-        std::sort(ids.begin(), ids.end());
-        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
         return ids;
     }
 
 
 private:
+    // Visit leaves in key order, starting from the leaf `start` falls in, or
+    // from the leftmost leaf when start is null. visit(leaf) returns false to
+    // stop. Leaves are read a parent at a time as one batch, and the walk
+    // moves between parents through the descent path, not the leaf chain.
+    //
+    // Once the tree has taken a concurrent insert, the path snapshot could
+    // miss a split that happens mid-walk, so the walk follows the leaf chain
+    // instead; that keeps searchIntervals() and the covering scan safe next
+    // to insertConcurrent().
+    template<typename Visit>
+    void walkLeaves(const Key *start, Visit &&visit) {
+        if (_concurrent.load(std::memory_order_acquire)) {
+            walkChain(start, visit);
+            return;
+        }
+        if (_rootOffset < 0) return;
+
+        auto firstChild = [&](const Node &node) { return start ? childFor(node, *start) : 0; };
+        Counter &visits = EngineMetrics::get().nodeVisits;
+        Node root = _disk.readNode(_rootOffset);
+        visits.inc();
+        if (root.isLeaf) {
+            visit(root);
+            return;
+        }
+
+        // 1) descend to the parent of the leaves, remembering the path
+        struct Frame { Node node; int child; };
+        std::pmr::vector<Frame> path(QueryArena::current());
+        path.push_back({ root, firstChild(root) });
+        while (int(path.size()) < _height - 1) {
+            Node next = _disk.readNode(path.back().node.info[path.back().child]);
+            visits.inc();
+            path.push_back({ next, firstChild(next) });
+        }
+
+        // 2) read each parent's remaining leaves as one batch, then move to the
+        //    next parent through the path instead of the leaf chain
+        while (true) {
+            Frame &parent = path.back();
+            std::pmr::vector<int> offsets(parent.node.info + parent.child,
+                                          parent.node.info + parent.node.numKeys + 1, QueryArena::current());
+            for (const Node &leaf : _disk.readNodes(offsets)) {
+                visits.inc();
+                if (!visit(leaf)) return;
+            }
+
+            path.pop_back();
+            while (!path.empty() && path.back().child >= path.back().node.numKeys) {
+                path.pop_back();
+            }
+            if (path.empty()) return;
+            path.back().child++;
+            while (int(path.size()) < _height - 1) {
+                Node next = _disk.readNode(path.back().node.info[path.back().child]);
+                visits.inc();
+                path.push_back({ next, 0 });
+            }
+        }
+    }
+
+    // walkLeaves() for concurrent mode: descend with validated copies, then
+    // follow the leaf chain one stable leaf at a time
+    template<typename Visit>
+    void walkChain(const Key *start, Visit &&visit) {
+        int offset;
+        while (true) {
+            uint64_t v = _rootLatch.readLock();
+            offset = _rootOffset;
+            if (_rootLatch.validate(v)) break;
+        }
+        if (offset < 0) return;
+
+        Node node = readStable(offset);
+        while (!node.isLeaf) {
+            offset = node.info[start ? childFor(node, *start) : 0];
+            node = readStable(offset);
+        }
+        while (visit(node) && node.info[n] >= 0) {
+            node = readStable(node.info[n]);
+        }
+    }
+
+    // Record IDs of every key below `end` (or equal to it when `inclusive`):
+    // scan forward from the leftmost leaf and stop at the first key past the
+    // bound, so the cost follows the number of matches. Sorted by row ID.
+    RowIdList scanUpTo(const Key &end, bool inclusive) {
+        RowIdRuns runs;
+        walkLeaves(nullptr, [&](const Node &leaf) {
+            for (int i = 0; i < leaf.numKeys; i++) {
+                auto k = leaf.getKey(i);
+                bool past = inclusive ? Compare{}(end, k)       // k > end ?
+                                      : !Compare{}(k, end);     // k >= end ?
+                if (past) return false;
+                runs.add(leaf.info[i]);
+            }
+            return true;
+        });
+        return runs.finish();
+    }
+
+    // Copy of the node at `offset` that no writer touched while it was read
+    Node readStable(int offset) {
+        OptimisticLatch &latch = _disk.latch(offset);
+        while (true) {
+            uint64_t v = latch.readLock();
+            Node node = _disk.readNode(offset);
+            if (latch.validate(v)) {
+                EngineMetrics::get().nodeVisits.inc();
+                return node;
+            }
+        }
+    }
+
+    // Read `offset` into node and report the version the copy belongs to
+    bool readOptimistic(int offset, Node &node, uint64_t &version) {
+        OptimisticLatch &latch = _disk.latch(offset);
+        version = latch.readLock();
+        node = _disk.readNode(offset);
+        EngineMetrics::get().nodeVisits.inc();
+        return latch.validate(version);
+    }
+
+    // One optimistic descent; false means a conflict, retry from the root
+    bool tryInsertConcurrent(const Key &key, int recordIndex) {
+        // 1) Root pointer, created on first use under the root latch
+        uint64_t vRoot = _rootLatch.readLock();
+        int offset = _rootOffset;
+        if (offset < 0) {
+            if (!_rootLatch.upgrade(vRoot)) return false;
+            Node leaf;
+            leaf.isLeaf = true;
+            leaf.info[n] = -1;
+            _rootOffset = _disk.writeNode(leaf);
+            _height = 1;
+            _rootLatch.unlock();
+            return false;
+        }
+
+        Node node, parentNode;
+        uint64_t v, vParent = 0;
+        int parent = -1, parentChild = 0;
+        if (!readOptimistic(offset, node, v) || !_rootLatch.validate(vRoot)) return false;
+
+        while (true) {
+            // 2) Full node: split it before going further. Latch the parent
+            //    (or the root pointer), then the node; the parent has room,
+            //    since it would have been split on an earlier descent.
+            if (node.numKeys == n) {
+                OptimisticLatch &up = parent < 0 ? _rootLatch : _disk.latch(parent);
+                if (!up.upgrade(parent < 0 ? vRoot : vParent)) return false;
+                if (!_disk.latch(offset).upgrade(v)) {
+                    up.unlock();
+                    return false;
+                }
+                Key separator;
+                int right = splitFull(offset, node, separator);
+                if (parent < 0) {
+                    Node root;
+                    root.isLeaf  = false;
+                    root.numKeys = 1;
+                    root.setKey(0, separator);
+                    root.info[0] = offset;
+                    root.info[1] = right;
+                    _rootOffset = _disk.writeNode(root);
+                    _height++;
+                } else {
+                    for (int j = parentNode.numKeys; j > parentChild; j--) {
+                        parentNode.setKey(j, parentNode.getKey(j - 1));
+                        parentNode.info[j + 1] = parentNode.info[j];
+                    }
+                    parentNode.setKey(parentChild, separator);
+                    parentNode.info[parentChild + 1] = right;
+                    parentNode.numKeys++;
+                    _disk.updateNode(parent, parentNode);
+                }
+                _disk.latch(offset).unlock();
+                up.unlock();
+                return false;   // descend again through the updated parent
+            }
+
+            // 3) Leaf with room: latch it iff it is still the copy we hold
+            if (node.isLeaf) {
+                if (!_disk.latch(offset).upgrade(v)) return false;
+                int pos = upperBound(node, key);
+                for (int j = node.numKeys; j > pos; j--) {
+                    node.setKey(j, node.getKey(j - 1));
+                    node.info[j] = node.info[j - 1];
+                }
+                node.setKey(pos, key);
+                node.info[pos] = recordIndex;
+                node.numKeys++;
+                _disk.updateNode(offset, node);
+                _disk.latch(offset).unlock();
+                return true;
+            }
+
+            // 4) Internal: read the child, then check the node still routes there
+            int child = upperBound(node, key);
+            Node next;
+            uint64_t vNext;
+            if (!readOptimistic(node.info[child], next, vNext) || !_disk.latch(offset).validate(v)) return false;
+            parent = offset;
+            parentNode = node;
+            parentChild = child;
+            vParent = v;
+            offset = node.info[child];
+            node = next;
+            v = vNext;
+        }
+    }
+
+    // Split a full node (whose latch the caller holds) into itself and a new
+    // right sibling. The sibling is written before the node is shrunk, so
+    // readers following the leaf chain never miss the keys that moved.
+    int splitFull(int offset, Node &node, Key &separator) {
+        Node right;
+        right.isLeaf = node.isLeaf;
+        if (node.isLeaf) {
+            EngineMetrics::get().leafSplits.inc();
+            int L = (n + 1) / 2;
+            right.numKeys = n - L;
+            for (int j = 0; j < right.numKeys; j++) {
+                right.setKey(j, node.getKey(L + j));
+                right.info[j] = node.info[L + j];
+            }
+            right.info[n] = node.info[n];
+            separator = right.getKey(0);
+            int rightOffset = _disk.writeNode(right);
+            node.numKeys = L;
+            node.info[n] = rightOffset;
+            _disk.updateNode(offset, node);
+            return rightOffset;
+        }
+
+        EngineMetrics::get().internalSplits.inc();
+        int mid = n / 2;
+        separator = node.getKey(mid);
+        right.numKeys = n - mid - 1;
+        for (int j = 0; j < right.numKeys; j++) right.setKey(j, node.getKey(mid + 1 + j));
+        for (int j = 0; j <= right.numKeys; j++) right.info[j] = node.info[mid + 1 + j];
+        int rightOffset = _disk.writeNode(right);
+        node.numKeys = mid;
+        _disk.updateNode(offset, node);
+        return rightOffset;
+    }
+
+    // Index of the first key > key (the child an insert follows)
+    int upperBound(const Node &node, const Key &key) const {
+        int lo = 0, hi = node.numKeys;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (Compare{}(key, node.getKey(mid))) hi = mid;
+            else lo = mid + 1;
+        }
+        return lo;
+    }
+
+    // Child to follow for `start`: the first key >= start
+    int childFor(const Node &node, const Key &start) const {
+        // lower_bound over the node's keys in place, without copying them out
+        int lo = 0, hi = node.numKeys;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (Compare{}(node.getKey(mid), start)) lo = mid + 1; else hi = mid;
+        }
+        return lo;
+    }
+
+    // Append the leaf's matches; returns false once a key past `end` is seen
+    bool scanLeaf(const Node &leaf, const Key &start, const Key &end, bool gotEnd, Result &results) const {
+        for (int i = 0; i < leaf.numKeys; i++) {
+            auto k = leaf.getKey(i);
+            if (gotEnd && Compare{}(end, k))      // k > end ?
+                return false;
+            if (!Compare{}(k, start))   // k >= start ?
+                results.emplace_back(k, leaf.info[i]);
+        }
+        return true;
+    }
+
     // recursive insert: returns a heap‐allocated SplitResult if this node splits
     SplitResult<Key>* insertRecursive(int offset, const Key key, int recordIndex)
     {
         Node node = _disk.readNode(offset);
+        EngineMetrics::get().nodeVisits.inc();
 
         if (node.isLeaf) {
             // --- leaf insertion ---
@@ -266,7 +561,8 @@ private:
             }
             std::vector<int>   recIdx(node.info, node.info + node.numKeys);
 
-            auto pos = std::lower_bound(keysVec.begin(), keysVec.end(), key, Compare{});
+            // after any equal keys, so each key's row IDs stay in insertion order
+            auto pos = std::upper_bound(keysVec.begin(), keysVec.end(), key, Compare{});
             int idx = int(pos - keysVec.begin());
             keysVec.insert(pos, key);
             recIdx.insert(recIdx.begin() + idx, recordIndex);
@@ -284,6 +580,7 @@ private:
             }
 
             // leaf overflow → split into L / R
+            EngineMetrics::get().leafSplits.inc();
             int total = int(keysVec.size());       // n+1
             int L     = (total + 1) / 2;           // ceil((n+1)/2)
             int R     = total - L;
@@ -346,6 +643,7 @@ private:
             }
 
             // internal overflow → split
+            EngineMetrics::get().internalSplits.inc();
             int total = int(keysVec.size());   // n+1
             int L     = (n + 1) / 2;           // ceil(n/2) 
             Key sep  = keysVec[L];
@@ -377,7 +675,10 @@ private:
         }
     }
 
-    int _rootOffset;
+    std::atomic<int> _rootOffset;
+    std::atomic<int> _height;          // levels including the leaves; 0 while empty
+    OptimisticLatch  _rootLatch;       // guards _rootOffset/_height in concurrent mode
+    std::atomic<bool> _concurrent{false};   // an insertConcurrent() has run
     DiskManager<Node> _disk;
-    size_t rowCount; 
+    std::atomic<size_t> rowCount; 
 };
@@ -0,0 +1,236 @@
+// Benchmark.hpp
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <thread>
+#include <algorithm>
+
+// Minimal Google Benchmark-style harness: register functions with BENCHMARK(),
+// loop with `while (state.keepRunning())`, and get JSON in the same schema as
+// --benchmark_format=json so existing compare scripts can diff two runs.
+
+namespace bench {
+
+class State {
+public:
+    State(int64_t maxIterations, const std::vector<int64_t> &args)
+        : _maxIterations(maxIterations), _args(args) {}
+
+    // True until the requested number of iterations has run
+    bool keepRunning() {
+        if (_done == 0 && !_started) start();
+        if (_done < _maxIterations) { _done++; return true; }
+        stop();
+        return false;
+    }
+
+    // Exclude setup work inside the loop from the measurement
+    void pauseTiming()  { accumulate(); _paused = true; }
+    void resumeTiming() { _paused = false; mark(); }
+
+    int64_t range(size_t i = 0) const { return i < _args.size() ? _args[i] : 0; }
+    int64_t iterations() const { return _done; }
+
+    void setItemsProcessed(int64_t items) { _items = items; }
+    void setBytesProcessed(int64_t bytes) { _bytes = bytes; }
+    void setLabel(const std::string &label) { _label = label; }
+
+    std::map<std::string, double> counters;
+
+    double realSeconds() const { return _real; }
+    double cpuSeconds() const { return _cpu; }
+    int64_t items() const { return _items; }
+    int64_t bytes() const { return _bytes; }
+    const std::string& label() const { return _label; }
+
+private:
+    static double cpuNow() {
+        timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+    }
+    void start() { _started = true; mark(); }
+    void mark() {
+        _realMark = std::chrono::steady_clock::now();
+        _cpuMark  = cpuNow();
+    }
+    void accumulate() {
+        if (_paused || !_started) return;
+        _real += std::chrono::duration<double>(std::chrono::steady_clock::now() - _realMark).count();
+        _cpu  += cpuNow() - _cpuMark;
+    }
+    void stop() { accumulate(); _paused = true; }
+
+    int64_t _maxIterations;
+    int64_t _done = 0;
+    std::vector<int64_t> _args;
+    bool _started = false;
+    bool _paused = false;
+    std::chrono::steady_clock::time_point _realMark;
+    double _cpuMark = 0, _real = 0, _cpu = 0;
+    int64_t _items = 0, _bytes = 0;
+    std::string _label;
+};
+
+using Function = std::function<void(State&)>;
+
+struct Benchmark {
+    std::string name;
+    Function fn;
+    std::vector<std::vector<int64_t>> argSets;
+    int64_t fixedIterations = 0;    // 0 = grow until minTime
+
+    Benchmark* Arg(int64_t a) { argSets.push_back({a}); return this; }
+    Benchmark* Args(const std::vector<int64_t> &a) { argSets.push_back(a); return this; }
+    Benchmark* Iterations(int64_t n) { fixedIterations = n; return this; }
+};
+
+inline std::vector<Benchmark*>& registry() {
+    static std::vector<Benchmark*> benchmarks;
+    return benchmarks;
+}
+
+inline Benchmark* registerBenchmark(const std::string &name, Function fn) {
+    auto *b = new Benchmark{name, std::move(fn), {}, 0};
+    registry().push_back(b);
+    return b;
+}
+
+struct Options {
+    std::string filter;       // substring match on the full run name
+    std::string jsonPath;     // empty: no JSON file
+    double minTime = 0.5;     // seconds per benchmark
+    std::ostream *report = &std::cout;
+};
+
+struct Run {
+    std::string name;
+    int64_t iterations;
+    double realNs, cpuNs;     // per iteration
+    double itemsPerSecond, bytesPerSecond;
+    std::string label;
+    std::map<std::string, double> counters;
+};
+
+inline std::string jsonEscape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+inline void writeJson(const std::string &path, const std::vector<Run> &runs,
+                      const std::map<std::string, std::string> &context)
+{
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return;
+    }
+    std::time_t now = std::time(nullptr);
+    char date[64];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+    for (auto const &kv : context) {
+        out << "    \"" << jsonEscape(kv.first) << "\": \"" << jsonEscape(kv.second) << "\",\n";
+    }
+    out << "    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [\n";
+    out << std::setprecision(10);
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Run &r = runs[i];
+        out << "    {\n"
+            << "      \"name\": \"" << jsonEscape(r.name) << "\",\n"
+            << "      \"run_name\": \"" << jsonEscape(r.name) << "\",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.realNs << ",\n"
+            << "      \"cpu_time\": " << r.cpuNs << ",\n"
+            << "      \"time_unit\": \"ns\"";
+        if (r.itemsPerSecond > 0) out << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+        if (r.bytesPerSecond > 0) out << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+        for (auto const &c : r.counters) out << ",\n      \"" << jsonEscape(c.first) << "\": " << c.second;
+        if (!r.label.empty()) out << ",\n      \"label\": \"" << jsonEscape(r.label) << "\"";
+        out << "\n    }" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+// Run every registered benchmark matching the filter; prints a table and
+// optionally writes JSON
+inline std::vector<Run> runAll(const Options &opt, const std::map<std::string, std::string> &context = {}) {
+    std::vector<Run> runs;
+    std::ostream &out = *opt.report;
+    out << std::left << std::setw(48) << "Benchmark"
+        << std::right << std::setw(14) << "Time(ns)"
+        << std::setw(14) << "CPU(ns)"
+        << std::setw(12) << "Iterations" << "  Extra\n"
+        << std::string(100, '-') << "\n";
+
+    for (Benchmark *b : registry()) {
+        std::vector<std::vector<int64_t>> argSets = b->argSets;
+        if (argSets.empty()) argSets.push_back({});
+
+        for (auto const &args : argSets) {
+            std::string name = b->name;
+            for (int64_t a : args) name += "/" + std::to_string(a);
+            if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos) continue;
+
+            // Grow the iteration count until one batch takes at least minTime
+            int64_t iters = b->fixedIterations > 0 ? b->fixedIterations : 1;
+            State state(iters, args);
+            while (true) {
+                state = State(iters, args);
+                b->fn(state);
+                if (b->fixedIterations > 0 || state.realSeconds() >= opt.minTime || iters >= 1000000000) break;
+                double scale = state.realSeconds() > 0 ? opt.minTime * 1.4 / state.realSeconds() : 10.0;
+                iters = std::max<int64_t>(iters + 1, int64_t(double(iters) * std::min(scale, 10.0)));
+            }
+
+            Run r;
+            r.name = name;
+            r.iterations = state.iterations();
+            r.realNs = state.realSeconds() * 1e9 / double(std::max<int64_t>(1, r.iterations));
+            r.cpuNs  = state.cpuSeconds()  * 1e9 / double(std::max<int64_t>(1, r.iterations));
+            r.itemsPerSecond = state.items() > 0 && state.realSeconds() > 0 ? double(state.items()) / state.realSeconds() : 0;
+            r.bytesPerSecond = state.bytes() > 0 && state.realSeconds() > 0 ? double(state.bytes()) / state.realSeconds() : 0;
+            r.label = state.label();
+            r.counters = state.counters;
+            runs.push_back(r);
+
+            std::ostringstream extra;
+            if (r.itemsPerSecond > 0) extra << std::setprecision(4) << r.itemsPerSecond / 1e6 << "M items/s ";
+            for (auto const &c : r.counters) extra << c.first << "=" << c.second << " ";
+            extra << r.label;
+            out << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(0)
+                << std::setw(14) << r.realNs << std::setw(14) << r.cpuNs
+                << std::setw(12) << r.iterations << "  " << extra.str() << std::endl;
+            out.unsetf(std::ios::fixed);
+        }
+    }
+
+    if (!opt.jsonPath.empty()) writeJson(opt.jsonPath, runs, context);
+    return runs;
+}
+
+} // namespace bench
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK(fn) \
+    static bench::Benchmark* BENCH_CONCAT(_bench_reg_, __LINE__) = bench::registerBenchmark(#fn, fn)
@@ -0,0 +1,314 @@
+// BlockFile.hpp
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <iostream>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Constants.h"
+#include "AsyncIO.hpp"
+#include "QueryProfile.hpp"
+#include "Metrics.hpp"
+#include "QueryArena.hpp"
+#include "WriteAheadLog.hpp"   // crc32c
+
+// Read-only handle on a column file:
+//   [size_t count][BLOCK_SIZE blocks...][u32 CRC-32C per block][u32 CRC-32C of those]
+// The descriptor is opened on first use and kept for the lifetime of the
+// column, and every read is a positional pread, so concurrent fetches can
+// share it without seeking.
+//
+// A block's checksum is checked the first time the block is read, so opening
+// a column costs one small read of the trailer. The rows of a block that
+// fails its checksum are not returned, and a file whose trailer is damaged
+// does not open. The header count of a file with a trailer carries the
+// CHECKSUMMED bit; files written before the trailer existed have it clear
+// and are read unchecked.
+class BlockFile {
+public:
+    static constexpr size_t CHECKSUMMED = size_t(1) << 63;
+
+    // Header word for a file of `count` values with a trailer, and back
+    static size_t header(size_t count) { return count | CHECKSUMMED; }
+    static size_t rowsIn(size_t header) { return header & ~CHECKSUMMED; }
+
+    explicit BlockFile(const std::string &path) : _path(path) {}
+    ~BlockFile() { reset(); }
+
+    BlockFile(const BlockFile&) = delete;
+    BlockFile& operator=(const BlockFile&) = delete;
+
+    // Close the descriptor; the next read reopens the (possibly rewritten) file
+    void reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_fd >= 0) ::close(_fd);
+        _fd = -1;
+        _count = 0;
+        _refused = false;
+        _crcs.clear();
+        _verified.reset();
+    }
+
+    // Opens lazily; returns false if the file is missing, has no header or
+    // its checksum trailer is damaged (reported once, until the next reset)
+    bool open() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_fd >= 0) return true;
+        if (_refused) return false;
+        int fd = ::open(_path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        size_t header = 0;
+        if (::pread(fd, &header, sizeof(size_t), 0) != ssize_t(sizeof(size_t))) {
+            ::close(fd);
+            return false;
+        }
+        if (!readChecksums(fd, _path, header, _crcs)) {
+            ::close(fd);
+            _refused = true;
+            return false;
+        }
+#ifdef POSIX_FADV_RANDOM
+        // we do our own coalescing; don't let the kernel read ahead on point lookups
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+#endif
+        _verified.reset(new std::atomic<uint8_t>[_crcs.size()]());
+        _fd = fd;
+        _count = rowsIn(header);
+        return true;
+    }
+
+    // Trailer for a file whose blocks had checksums `crcs` (see above)
+    static void writeChecksums(std::ostream &out, const std::vector<uint32_t> &crcs) {
+        uint32_t crc = WriteAheadLog::crc32c(0, crcs.data(), crcs.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(crcs.data()), std::streamsize(crcs.size() * sizeof(uint32_t)));
+        out.write(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    }
+
+    // True if block `block` (BLOCK_SIZE bytes at `data`) matches its checksum
+    // or has none. Checked once per block for the life of this handle; a
+    // block that failed is reported once and refused from then on.
+    bool verifyBlock(size_t block, const char *data) const {
+        if (block >= _crcs.size()) return true;
+        uint8_t state = _verified[block].load(std::memory_order_relaxed);
+        if (state != BLOCK_UNCHECKED) return state == BLOCK_GOOD;
+        if (WriteAheadLog::crc32c(0, data, BLOCK_SIZE) == _crcs[block]) {
+            _verified[block].store(BLOCK_GOOD, std::memory_order_relaxed);
+            return true;
+        }
+        if (_verified[block].exchange(BLOCK_BAD, std::memory_order_relaxed) != BLOCK_BAD) {
+            std::cerr << "BlockFile: block " << block << " of " << _path << " fails its checksum" << std::endl;
+            EngineMetrics::get().checksumFailures.inc();
+        }
+        return false;
+    }
+
+    // Read every block of the file at `path` through its own descriptor and
+    // check it, whether or not a reader already has; returns the blocks that
+    // fail. Safe next to readers and saves: a save renames a new file into
+    // place and the scrub keeps reading the one it opened.
+    static size_t scrub(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return 0;
+        size_t header = 0;
+        std::vector<uint32_t> crcs;
+        size_t bad = 0;
+        if (::pread(fd, &header, sizeof(size_t), 0) == ssize_t(sizeof(size_t))) {
+            bad = readChecksums(fd, path, header, crcs) ? 0 : 1;
+        }
+        std::vector<char> buffer(READ_COALESCE_BLOCKS * BLOCK_SIZE);
+        for (size_t block = 0; block < crcs.size(); block += READ_COALESCE_BLOCKS) {
+            size_t n = std::min(READ_COALESCE_BLOCKS, crcs.size() - block);
+            ssize_t got = ::pread(fd, buffer.data(), n * BLOCK_SIZE, off_t(sizeof(size_t) + block * BLOCK_SIZE));
+            for (size_t i = 0; i < n; i++) {
+                bool ok = got >= ssize_t((i + 1) * BLOCK_SIZE)
+                       && WriteAheadLog::crc32c(0, buffer.data() + i * BLOCK_SIZE, BLOCK_SIZE) == crcs[block + i];
+                if (!ok) {
+                    std::cerr << "Scrub: block " << block + i << " of " << path << " fails its checksum" << std::endl;
+                    EngineMetrics::get().checksumFailures.inc();
+                    bad++;
+                }
+            }
+            EngineMetrics::get().scrubbedBlocks.inc(n);
+        }
+        ::close(fd);
+        return bad;
+    }
+
+    // Number of values recorded in the file header
+    size_t count() const { return _count; }
+    int fd() const { return _fd; }
+
+    // Read `numBlocks` consecutive blocks starting at `firstBlock`; returns bytes read
+    size_t readBlocks(size_t firstBlock, size_t numBlocks, char *buffer) const {
+        size_t want = numBlocks * BLOCK_SIZE;
+        off_t  pos  = off_t(sizeof(size_t) + firstBlock * BLOCK_SIZE);
+        size_t got  = 0;
+        while (got < want) {
+            ssize_t r = ::pread(_fd, buffer + got, want - got, pos + off_t(got));
+            if (r <= 0) break;
+            got += size_t(r);
+        }
+        countRead(numBlocks, got);
+        return got;
+    }
+
+    // Visit every requested slot. Adjacent requested blocks are coalesced into
+    // one read of up to READ_COALESCE_BLOCKS and all reads go to the async
+    // backend as one batch, so slots arrive in completion order, not record
+    // order. If most blocks are wanted anyway the whole file is read
+    // sequentially in large chunks instead.
+    // fn(position, const char *slot) is called once per position in
+    // recordIndices (duplicates included); out-of-range indices are skipped.
+    template<typename Fn>
+    void forEachSlot(const RowIdList &recordIndices, size_t slotSize, Fn &&fn) {
+        if (!open()) return;
+        const size_t count = _count;
+        const size_t perBlock = BLOCK_SIZE / slotSize;
+        const size_t totalBlocks = (count + perBlock - 1) / perBlock;
+
+        // (record index, position in the request), in record order
+        std::pmr::memory_resource *arena = QueryArena::current();
+        std::pmr::vector<std::pair<size_t, size_t>> wanted(arena);
+        wanted.reserve(recordIndices.size());
+        for (size_t pos = 0; pos < recordIndices.size(); pos++) {
+            int idx = recordIndices[pos];
+            if (idx >= 0 && static_cast<size_t>(idx) < count) wanted.emplace_back(size_t(idx), pos);
+        }
+        if (wanted.empty()) return;
+        if (!std::is_sorted(wanted.begin(), wanted.end())) {
+            std::sort(wanted.begin(), wanted.end());
+        }
+
+        size_t distinctBlocks = 0;
+        for (size_t i = 0, prev = SIZE_MAX; i < wanted.size(); i++) {
+            size_t b = wanted[i].first / perBlock;
+            if (b != prev) { distinctBlocks++; prev = b; }
+        }
+
+        if (double(distinctBlocks) >= SEQ_SCAN_BLOCK_FRACTION * double(totalBlocks)) {
+            // 1) Dense request: sequential scan, walking the sorted request alongside
+            std::pmr::vector<char> buffer(READ_COALESCE_BLOCKS * BLOCK_SIZE, arena);
+            size_t k = 0;
+            for (size_t block = 0; block < totalBlocks && k < wanted.size(); block += READ_COALESCE_BLOCKS) {
+                size_t n = std::min(READ_COALESCE_BLOCKS, totalBlocks - block);
+                size_t last = (block + n) * perBlock;   // first record past this chunk
+                if (wanted[k].first >= last) continue;
+                size_t bytesRead = readBlocks(block, n, buffer.data());
+                for (; k < wanted.size() && wanted[k].first < last; k++) {
+                    size_t idx = wanted[k].first;
+                    size_t byteOff = (idx / perBlock - block) * BLOCK_SIZE + (idx % perBlock) * slotSize;
+                    if (byteOff + slotSize <= bytesRead && verifyBlock(idx / perBlock, buffer.data() + byteOff - byteOff % BLOCK_SIZE)) {
+                        fn(wanted[k].second, buffer.data() + byteOff);
+                    }
+                }
+            }
+            return;
+        }
+
+        // 2) Sparse request: runs of adjacent blocks, one read per run, all
+        //    submitted as a single batch and decoded as each one completes
+        struct Run { size_t firstBlock, numBlocks, from, to; };   // to: exclusive
+        std::pmr::vector<Run> runs(arena);
+        size_t totalRunBlocks = 0;
+        size_t i = 0;
+        while (i < wanted.size()) {
+            size_t runStart = wanted[i].first / perBlock;
+            size_t runEnd   = runStart;          // inclusive
+            size_t j = i;
+            while (j < wanted.size()) {
+                size_t b = wanted[j].first / perBlock;
+                if (b > runEnd + 1 || b - runStart >= READ_COALESCE_BLOCKS) break;
+                runEnd = b;
+                j++;
+            }
+            runs.push_back({ runStart, runEnd - runStart + 1, i, j });
+            totalRunBlocks += runEnd - runStart + 1;
+            i = j;
+        }
+
+        std::pmr::vector<char> runBuffer(totalRunBlocks * BLOCK_SIZE, arena);
+        ReadRequests requests(arena);
+        requests.reserve(runs.size());
+        for (size_t r = 0, pos = 0; r < runs.size(); r++) {
+            requests.push_back({ _fd,
+                                 off_t(sizeof(size_t) + runs[r].firstBlock * BLOCK_SIZE),
+                                 runs[r].numBlocks * BLOCK_SIZE,
+                                 runBuffer.data() + pos });
+            pos += runs[r].numBlocks * BLOCK_SIZE;
+        }
+        countRead(totalRunBlocks, totalRunBlocks * BLOCK_SIZE);
+
+        auto onRead = [&](size_t r, ssize_t bytesRead) {
+            if (bytesRead <= 0) return;
+            const Run &run = runs[r];
+            for (size_t k = run.from; k < run.to; k++) {
+                size_t idx = wanted[k].first;
+                size_t byteOff = (idx / perBlock - run.firstBlock) * BLOCK_SIZE + (idx % perBlock) * slotSize;
+                if (byteOff + slotSize <= size_t(bytesRead)
+                    && verifyBlock(idx / perBlock, requests[r].buffer + byteOff - byteOff % BLOCK_SIZE)) {
+                    fn(wanted[k].second, requests[r].buffer + byteOff);
+                }
+            }
+        };
+        ioBackend().readBatch(requests, std::ref(onRead));
+    }
+
+private:
+    enum : uint8_t { BLOCK_UNCHECKED = 0, BLOCK_GOOD = 1, BLOCK_BAD = 2 };
+
+    // Load the trailer of an open file with header word `header` into
+    // `crcs`. A file without the CHECKSUMMED bit has no trailer and leaves
+    // `crcs` empty; false if the bit is set and the trailer is missing or
+    // damaged.
+    static bool readChecksums(int fd, const std::string &path, size_t header, std::vector<uint32_t> &crcs) {
+        crcs.clear();
+        if (!(header & CHECKSUMMED)) return true;
+        struct stat st;
+        const size_t fixed = sizeof(size_t) + sizeof(uint32_t);
+        bool ok = ::fstat(fd, &st) == 0 && size_t(st.st_size) >= fixed
+               && (size_t(st.st_size) - fixed) % (BLOCK_SIZE + sizeof(uint32_t)) == 0;
+        const size_t blocks = ok ? (size_t(st.st_size) - fixed) / (BLOCK_SIZE + sizeof(uint32_t)) : 0;
+
+        std::vector<uint32_t> trailer(blocks + 1);
+        const off_t at = off_t(sizeof(size_t) + blocks * BLOCK_SIZE);
+        const size_t bytes = trailer.size() * sizeof(uint32_t);
+        ok = ok && ::pread(fd, trailer.data(), bytes, at) == ssize_t(bytes)
+                && WriteAheadLog::crc32c(0, trailer.data(), blocks * sizeof(uint32_t)) == trailer[blocks];
+        if (!ok) {
+            std::cerr << "BlockFile: the block checksums of " << path << " are damaged or missing" << std::endl;
+            EngineMetrics::get().checksumFailures.inc();
+            return false;
+        }
+        trailer.pop_back();
+        crcs = std::move(trailer);
+        return true;
+    }
+
+    static void countRead(size_t blocks, size_t bytes) {
+        EngineMetrics &m = EngineMetrics::get();
+        m.blockReads.inc(blocks);
+        m.blockBytesRead.inc(bytes);
+        if (IoStats *io = currentIoStats()) {
+            io->blockReads += blocks;
+            io->bytesRead  += bytes;
+        }
+    }
+
+    std::string _path;
+    std::mutex  _mutex;
+    int         _fd = -1;
+    size_t      _count = 0;
+    bool        _refused = false;                     // trailer damaged; open() fails until reset()
+    std::vector<uint32_t> _crcs;                      // per block; empty if the file has none
+    std::unique_ptr<std::atomic<uint8_t>[]> _verified;   // per block: BLOCK_UNCHECKED/GOOD/BAD
+};
@@ -0,0 +1,110 @@
+// BloomFilter.hpp
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include "Constants.h"
+
+// Set-membership filter over the keys of one index. mightContain() is false
+// only for a key that was never added, so an equality probe for an absent
+// key is answered from memory without reading a tree node.
+//
+// Cache-line blocked: a key's BLOOM_HASHES bits all fall in one 64-byte
+// block, so a probe touches one cache line. Bits are set with atomic ORs,
+// so keys can be added while queries probe. A filter that was never sized
+// holds no keys and answers "maybe" to everything.
+class BloomFilter {
+public:
+    BloomFilter() = default;
+
+    // Room for `keys` distinct keys at BLOOM_BITS_PER_KEY bits each
+    explicit BloomFilter(size_t keys) {
+        size_t blocks = (keys * BLOOM_BITS_PER_KEY + BLOCK_BITS - 1) / BLOCK_BITS;
+        allocate(blocks > 0 ? blocks : 1);
+    }
+
+    BloomFilter(BloomFilter&&) = default;
+    BloomFilter& operator=(BloomFilter&&) = default;
+
+    bool empty() const { return _blocks == 0; }
+    size_t bytes() const { return _blocks * BLOCK_BITS / 8; }
+
+    void add(std::string_view key) {
+        if (empty()) return;
+        uint64_t h = hash(key);
+        std::atomic<uint64_t> *block = &_words[blockOf(h) * WORDS_PER_BLOCK];
+        for (unsigned i = 0; i < BLOOM_HASHES; i++) {
+            unsigned bit = unsigned(h >> (9 * i + 1)) & (BLOCK_BITS - 1);   // rotate through the upper hash bits
+            block[bit / 64].fetch_or(uint64_t(1) << (bit % 64), std::memory_order_relaxed);
+        }
+    }
+
+    bool mightContain(std::string_view key) const {
+        if (empty()) return true;
+        uint64_t h = hash(key);
+        const std::atomic<uint64_t> *block = &_words[blockOf(h) * WORDS_PER_BLOCK];
+        for (unsigned i = 0; i < BLOOM_HASHES; i++) {
+            unsigned bit = unsigned(h >> (9 * i + 1)) & (BLOCK_BITS - 1);
+            if (!(block[bit / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (bit % 64)))) return false;
+        }
+        return true;
+    }
+
+    // Raw bits for a snapshot section; load() takes them back (false if the
+    // size is not a whole number of blocks)
+    void copyTo(void *out) const {
+        uint64_t *words = static_cast<uint64_t*>(out);
+        for (size_t i = 0; i < _blocks * WORDS_PER_BLOCK; i++) words[i] = _words[i].load(std::memory_order_relaxed);
+    }
+    bool load(const void *data, size_t bytes) {
+        if (bytes == 0 || bytes % (BLOCK_BITS / 8) != 0) return false;
+        allocate(bytes / (BLOCK_BITS / 8));
+        const uint64_t *words = static_cast<const uint64_t*>(data);
+        for (size_t i = 0; i < _blocks * WORDS_PER_BLOCK; i++) _words[i].store(words[i], std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static constexpr unsigned BLOCK_BITS      = 512;
+    static constexpr unsigned WORDS_PER_BLOCK = BLOCK_BITS / 64;
+    static_assert(9 * BLOOM_HASHES + 1 <= 64, "not enough hash bits for BLOOM_HASHES probes");
+
+    void allocate(size_t blocks) {
+        _blocks = blocks;
+        _words.reset(new std::atomic<uint64_t>[blocks * WORDS_PER_BLOCK]());
+    }
+
+    // The block comes from a remix of the hash, independent of the bit positions
+    size_t blockOf(uint64_t h) const {
+        return size_t(((h * 0x9e3779b97f4a7c15ull) >> 32) % _blocks);
+    }
+
+    // Eight bytes per multiply, then a 64-bit finalizer so every output bit
+    // depends on every byte. Fixed here (not std::hash) because the bits are
+    // stored in snapshots.
+    static uint64_t hash(std::string_view key) {
+        const char *p = key.data();
+        size_t n = key.size();
+        uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+        for (; n >= 8; p += 8, n -= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, 8);
+            h = (h ^ word) * 0xbf58476d1ce4e5b9ull;
+            h ^= h >> 31;
+        }
+        uint64_t rest = 0;
+        for (size_t i = 0; i < n; i++) rest |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+        h = (h ^ rest) * 0x94d049bb133111ebull;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> _words;
+    size_t _blocks = 0;
+};
@@ -0,0 +1,65 @@
+// ChunkedArray.hpp
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+// Append-only array for one writer and any number of readers. Elements live
+// in fixed-size chunks that never move, so a reader may keep reading element
+// i (for any i below a size it observed) while the writer appends. The
+// chunk directory is allocated on the first append; until then the array
+// costs one pointer.
+template<typename T, size_t ChunkBits = 16>
+class ChunkedArray {
+public:
+    static constexpr size_t CHUNK      = size_t(1) << ChunkBits;
+    static constexpr size_t MAX_CHUNKS = ((size_t(1) << 31) + CHUNK - 1) / CHUNK;   // int row IDs
+
+    ChunkedArray() = default;
+    ~ChunkedArray() { clear(); }
+
+    // Moves are for the exclusive phases (load, checkpoint), never concurrent
+    ChunkedArray(ChunkedArray &&other) noexcept { *this = std::move(other); }
+    ChunkedArray& operator=(ChunkedArray &&other) noexcept {
+        if (this != &other) {
+            clear();
+            _chunks = other._chunks;
+            _size.store(other._size.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other._chunks = nullptr;
+            other._size.store(0, std::memory_order_relaxed);
+        }
+        return *this;
+    }
+    ChunkedArray(const ChunkedArray&) = delete;
+    ChunkedArray& operator=(const ChunkedArray&) = delete;
+
+    // Writer only. The element is visible to readers that load size() after this returns.
+    void push_back(T value) {
+        size_t i = _size.load(std::memory_order_relaxed);
+        if (!_chunks) _chunks = new Chunk[MAX_CHUNKS]();
+        std::unique_ptr<T[]> &chunk = _chunks[i >> ChunkBits].values;
+        if (!chunk) chunk.reset(new T[CHUNK]());
+        chunk[i & (CHUNK - 1)] = std::move(value);
+        _size.store(i + 1, std::memory_order_release);
+    }
+
+    size_t size() const { return _size.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    const T& operator[](size_t i) const { return _chunks[i >> ChunkBits].values[i & (CHUNK - 1)]; }
+
+    // Exclusive phases only
+    void clear() {
+        delete[] _chunks;
+        _chunks = nullptr;
+        _size.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    struct Chunk { std::unique_ptr<T[]> values; };
+
+    Chunk              *_chunks = nullptr;
+    std::atomic<size_t> _size{0};
+};
@@ -0,0 +1,129 @@
+// ColumnCache.hpp
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <cstddef>
+#include "Metrics.hpp"
+
+// In-memory columns of one store, under a byte budget. A column is admitted
+// when its rows are brought into memory and touched whenever a reader pins
+// it; once the resident bytes pass the budget, the least recently used
+// columns that can be rebuilt are dropped. A reader that still holds a pin
+// keeps its copy until it lets go, so eviction never waits for queries.
+//
+// One mutex guards the residency of every column in the store, so loads
+// are serialized. They are rare: once per column, and again after an eviction.
+class ColumnCache {
+public:
+    // Something the cache may drop from memory (a column)
+    class Entry {
+    public:
+        virtual ~Entry() = default;
+        // Called with mutex() held: drop the in-memory rows if they can be
+        // rebuilt later, and say whether they were dropped
+        virtual bool evict() const = 0;
+    };
+
+    // budget: resident bytes to stay under; 0 = unlimited
+    explicit ColumnCache(size_t budget = 0)
+        : _budget(budget)
+        , _loads(MetricsRegistry::shared().counter("hdb_column_loads_total", "Columns brought into memory on first use or after an eviction"))
+        , _evictions(MetricsRegistry::shared().counter("hdb_column_evictions_total", "Columns dropped from memory by the LRU budget"))
+    {}
+
+    ColumnCache(const ColumnCache&) = delete;
+    ColumnCache& operator=(const ColumnCache&) = delete;
+
+    // For columns outside any store: never evicts
+    static ColumnCache& unbounded() {
+        static ColumnCache cache;
+        return cache;
+    }
+
+    std::mutex& mutex() { return _mutex; }
+
+    void setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _budget = bytes;
+        trim(nullptr);
+    }
+    size_t budget() const { return _budget; }
+    size_t residentBytes() const { return _bytes; }
+
+    // The rest need mutex() held.
+
+    // `entry` was just loaded: count it, then make room for it
+    void load(const Entry *entry, size_t bytes) {
+        _loads.inc();
+        admit(entry, bytes);
+    }
+
+    // `entry` holds `bytes` in memory now (new, or grown since): make it the
+    // most recently used, then evict colder entries while over budget
+    void admit(const Entry *entry, size_t bytes) {
+        Slot *slot = find(entry);
+        if (slot) {
+            _bytes -= slot->bytes;
+            slot->bytes = bytes;
+            touch(entry);
+        } else {
+            _lru.push_front({ entry, bytes });
+        }
+        _bytes += bytes;
+        trim(entry);
+    }
+
+    void touch(const Entry *entry) {
+        for (auto it = _lru.begin(); it != _lru.end(); ++it) {
+            if (it->entry == entry) {
+                _lru.splice(_lru.begin(), _lru, it);
+                return;
+            }
+        }
+    }
+
+    // `entry` dropped its rows (or is going away) by other means
+    void forget(const Entry *entry) {
+        for (auto it = _lru.begin(); it != _lru.end(); ++it) {
+            if (it->entry == entry) {
+                _bytes -= it->bytes;
+                _lru.erase(it);
+                return;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        const Entry *entry;
+        size_t       bytes;
+    };
+
+    Slot* find(const Entry *entry) {
+        for (auto &slot : _lru) {
+            if (slot.entry == entry) return &slot;
+        }
+        return nullptr;
+    }
+
+    // Coldest first; `keep` (the entry being admitted) always stays
+    void trim(const Entry *keep) {
+        if (_budget == 0) return;
+        auto it = _lru.end();
+        while (_bytes > _budget && it != _lru.begin()) {
+            --it;
+            if (it->entry == keep || !it->entry->evict()) continue;
+            _bytes -= it->bytes;
+            _evictions.inc();
+            it = _lru.erase(it);
+        }
+    }
+
+    std::mutex       _mutex;
+    std::list<Slot>  _lru;       // most recently used first; a dozen entries at most
+    size_t           _budget;
+    size_t           _bytes = 0;
+    Counter         &_loads;
+    Counter         &_evictions;
+};
@@ -5,23 +5,204 @@
 #include <filesystem>
 #include <algorithm>
 #include <vector>
+#include <iterator>
 #include <cstring>
 #include <cmath>
 #include "Constants.h"
+#include "TaskPool.hpp"
+#include "QueryProfile.hpp"
+#include "WriteAheadLog.hpp"
+
+namespace {
+// Queue `task` on the group, timed under its own child of `profile` (if any).
+// Children are created here, on the calling thread, before any task runs.
+template<typename Fn>
+void runProfiled(TaskGroup& group, ProfileNode* profile, const char* name, size_t rows, Fn task) {
+    ProfileNode* node = profile ? profile->child(name) : nullptr;
+    if (node) node->rowsOut = rows;
+    group.run([node, task] { ProfileScope scope(node); task(); });
+}
+
+// Point one string field of every row at its dictionary value. Rows the
+// dictionary doesn't cover keep an empty field.
+void decodeColumn(const Dictionary& dict, ColumnStore::Rows& rows,
+                  std::string_view ColumnStore::DataRow::*field) {
+    const size_t known = dict.rows();
+    for (auto& pr : rows) {
+        if (pr.first >= 0 && size_t(pr.first) < known) pr.second.*field = dict.decode(dict.code(size_t(pr.first)));
+    }
+}
+
+// One parsed CSV record, and a run of them with the warnings they raised
+struct CsvRow {
+    std::string month, town, flatType, block, streetName, storeyRange, flatModel;
+    double      floorArea   = 0;
+    int         leaseDate   = 0;
+    double      resalePrice = 0;
+};
+struct CsvBlock {
+    std::vector<CsvRow> rows;
+    std::string         messages;
+};
+
+// Parse one data line into `out`; a bad line only adds a message
+void parseCsvLine(const std::string& line, CsvBlock& out) {
+    if (line.empty() || line.find_first_not_of(" \t\r\n") == std::string::npos) {
+        return;
+    }
+
+    std::stringstream ss(line);
+    std::string token;
+    std::vector<std::string> tokens;
+
+    while (std::getline(ss, token, ',')) {
+        token.erase(0, token.find_first_not_of(" \t\r\n"));
+        token.erase(token.find_last_not_of(" \t\r\n") + 1);
+        tokens.push_back(token);
+    }
+
+    // Check if we have enough columns
+    if (tokens.size() < 10) {
+        out.messages += "Warning: Skipping row with insufficient columns: " + line + "\n";
+        return;
+    }
+
+    try {
+        // Parse values
+        CsvRow row;
+        row.month       = toUpper(tokens[0]);
+        row.town        = toUpper(tokens[1]);
+        row.flatType    = toUpper(tokens[2]);
+        row.block       = toUpper(tokens[3]);
+        row.streetName  = toUpper(tokens[4]);
+        row.storeyRange = toUpper(tokens[5]);
+        row.floorArea   = std::stod(tokens[6]);
+        row.flatModel   = toUpper(tokens[7]);
+        row.leaseDate   = std::stoi(tokens[8]);
+        row.resalePrice = std::stod(tokens[9]);
+        out.rows.push_back(std::move(row));
+    }
+    catch (const std::exception& e) {
+        out.messages += "Error processing row: " + line + " | Reason: " + e.what() + "\n";
+    }
+}
+
+// Parse data lines in blocks on the shared pool. Each block keeps its rows
+// and messages in file order, so callers add rows and print warnings exactly
+// as a serial pass would.
+std::vector<CsvBlock> parseCsvLines(const std::vector<std::string>& lines) {
+    constexpr size_t LINES_PER_TASK = 4096;
+    std::vector<CsvBlock> parsed((lines.size() + LINES_PER_TASK - 1) / LINES_PER_TASK);
+    parallelFor(0, parsed.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t b = lo; b < hi; b++) {
+            size_t end = std::min(lines.size(), (b + 1) * LINES_PER_TASK);
+            for (size_t l = b * LINES_PER_TASK; l < end; l++) parseCsvLine(lines[l], parsed[b]);
+        }
+    });
+    return parsed;
+}
+
+void putDouble(std::string& out, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    WriteAheadLog::putU64(out, bits);
+}
+bool getDouble(const std::string& in, size_t& pos, double& v) {
+    uint64_t bits;
+    if (!WriteAheadLog::getU64(in, pos, bits)) return false;
+    std::memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+// Dictionary as two snapshot sections: "<name>.values" is [u32 count]
+// [u32 offsets, count + 1][bytes], "<name>.codes" is one u32 per row
+void writeDictionary(SnapshotWriter& out, const std::string& name, const Dictionary& dict, size_t rows) {
+    std::vector<uint32_t> offsets(1, 0);
+    for (auto const& v : dict.values) offsets.push_back(offsets.back() + uint32_t(v.size()));
+    uint32_t count = uint32_t(dict.values.size());
+    out.beginSection(name + ".values");
+    out.append(&count, sizeof(count));
+    out.append(offsets.data(), offsets.size() * sizeof(uint32_t));
+    for (auto const& v : dict.values) out.append(v.data(), v.size());
+    out.endSection();
+    out.beginSection(name + ".codes");
+    out.append(dict.codes.data(), std::min(rows, dict.codes.size()) * sizeof(uint32_t));
+    for (size_t row = dict.codes.size(); row < rows; row++) {
+        uint32_t code = dict.code(row);
+        out.append(&code, sizeof(code));
+    }
+    out.endSection();
+}
+bool readDictionaryValues(const Snapshot::Section& section, std::vector<std::string>& values) {
+    uint32_t count = 0;
+    if (section.size < sizeof(count)) return false;
+    std::memcpy(&count, section.data, sizeof(count));
+    const size_t header = sizeof(count) + (size_t(count) + 1) * sizeof(uint32_t);
+    if (section.size < header) return false;
+    std::vector<uint32_t> offsets(size_t(count) + 1);
+    std::memcpy(offsets.data(), section.data + sizeof(count), offsets.size() * sizeof(uint32_t));
+    values.clear();
+    values.reserve(count);
+    for (uint32_t c = 0; c < count; c++) {
+        if (offsets[c] > offsets[c + 1] || header + offsets[c + 1] > section.size) return false;
+        values.emplace_back(section.data + header + offsets[c], offsets[c + 1] - offsets[c]);
+    }
+    return true;
+}
+
+// A string column's checkpointed rows, rebuilt from its dictionary
+std::vector<std::string> decodeAll(const Dictionary& dict) {
+    std::vector<std::string> rows;
+    rows.reserve(dict.codes.size());
+    for (uint32_t code : dict.codes) rows.push_back(dict.decode(code));
+    return rows;
+}
+
+// Numeric column stored raw in a snapshot section
+template<typename T>
+void writeColumn(SnapshotWriter& out, const std::string& name, const Column<T>& column, size_t rows) {
+    typename Column<T>::Pinned pinned = column.pin();
+    const std::vector<T>& data = pinned.rows();
+    out.beginSection(name);
+    out.append(data.data(), std::min(rows, data.size()) * sizeof(T));
+    for (size_t row = data.size(); row < rows; row++) out.append(&pinned.value(row), sizeof(T));
+    out.endSection();
+}
+template<typename T>
+void assignRaw(Column<T>& column, const Snapshot::Section& section, size_t rows) {
+    std::vector<T> data(rows);
+    std::memcpy(data.data(), section.data, rows * sizeof(T));
+    column.assign(std::move(data));
+}
+
+// Close a freshly written file and push it to stable storage
+bool finishFile(std::ofstream& file, const std::string& path) {
+    file.close();
+    if (!file || !WriteAheadLog::syncPath(path)) {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+}
 
 namespace fs = std::filesystem;
 
 // Template specialization for storing numeric types (int)
 template <>
-void Column<int>::storeToDisk() {
-    std::ofstream file(fullFilePath, std::ios::binary | std::ios::trunc);
+bool Column<int>::storeToDisk(const std::string& path) {
+    Pinned pinned = pin();
+    const std::vector<int>& data = pinned.rows();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
     if (!file) {
-        std::cerr << "Error: Could not open file for writing: " << fullFilePath << std::endl;
-        return;
+        std::cerr << "Error: Could not open file for writing: " << path << std::endl;
+        return false;
     }
 
     size_t count = data.size();
-    file.write(reinterpret_cast<const char*>(&count), sizeof(size_t)); // Write total count
+    size_t header = BlockFile::header(count);   // count, flagged as checksummed
+    file.write(reinterpret_cast<const char*>(&header), sizeof(size_t)); // Write total count
+    std::vector<uint32_t> crcs;
 
     if (count > 0) {
         const size_t valuesPerBlock = BLOCK_SIZE / sizeof(int);
@@ -38,21 +219,28 @@ void Column<int>::storeToDisk() {
             }
             
             file.write(buffer, BLOCK_SIZE);
+            crcs.push_back(WriteAheadLog::crc32c(0, buffer, BLOCK_SIZE));
         }
     }
+    BlockFile::writeChecksums(file, crcs);
+    return finishFile(file, path);
 }
 
 // Template specialization for storing numeric types (double)
 template <>
-void Column<double>::storeToDisk() {
-    std::ofstream file(fullFilePath, std::ios::binary | std::ios::trunc);
+bool Column<double>::storeToDisk(const std::string& path) {
+    Pinned pinned = pin();
+    const std::vector<double>& data = pinned.rows();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
     if (!file) {
-        std::cerr << "Error: Could not open file for writing: " << fullFilePath << std::endl;
-        return;
+        std::cerr << "Error: Could not open file for writing: " << path << std::endl;
+        return false;
     }
 
     size_t count = data.size();
-    file.write(reinterpret_cast<const char*>(&count), sizeof(size_t));
+    size_t header = BlockFile::header(count);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(size_t));
+    std::vector<uint32_t> crcs;
 
     if (count > 0) {
         const size_t valuesPerBlock = BLOCK_SIZE / sizeof(double);
@@ -69,21 +257,28 @@ void Column<double>::storeToDisk() {
             }
             
             file.write(buffer, BLOCK_SIZE);
+            crcs.push_back(WriteAheadLog::crc32c(0, buffer, BLOCK_SIZE));
         }
     }
+    BlockFile::writeChecksums(file, crcs);
+    return finishFile(file, path);
 }
 
 // Template specialization for storing string columns
 template <>
-void Column<std::string>::storeToDisk() {
-    std::ofstream file(fullFilePath, std::ios::binary | std::ios::trunc);
+bool Column<std::string>::storeToDisk(const std::string& path) {
+    Pinned pinned = pin();
+    const std::vector<std::string>& data = pinned.rows();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
     if (!file) {
-        std::cerr << "Error: Could not open file for writing: " << fullFilePath << std::endl;
-        return;
+        std::cerr << "Error: Could not open file for writing: " << path << std::endl;
+        return false;
     }
 
     size_t count = data.size();
-    file.write(reinterpret_cast<const char*>(&count), sizeof(size_t)); // Write total count
+    size_t header = BlockFile::header(count);   // count, flagged as checksummed
+    file.write(reinterpret_cast<const char*>(&header), sizeof(size_t)); // Write total count
+    std::vector<uint32_t> crcs;
 
     if (count > 0) {
         // Write the data in blocks
@@ -103,24 +298,31 @@ void Column<std::string>::storeToDisk() {
             }
             
             file.write(buffer, BLOCK_SIZE);
+            crcs.push_back(WriteAheadLog::crc32c(0, buffer, BLOCK_SIZE));
         }
     }
+    BlockFile::writeChecksums(file, crcs);
+    return finishFile(file, path);
 }
 
 // Template specialization for loading numeric types (int)
 template <>
-void Column<int>::loadFromDisk() {
-    data.clear();
+std::vector<int> Column<int>::readFile() const {
+    std::vector<int> data;
     std::ifstream file(fullFilePath, std::ios::binary);
     if (!file) {
-        return; 
+        return data;
     }
 
-    size_t count = 0;
-    file.read(reinterpret_cast<char*>(&count), sizeof(size_t));
+    size_t header = 0;
+    file.read(reinterpret_cast<char*>(&header), sizeof(size_t));
     if (!file || file.gcount() != sizeof(size_t)) {
-        return;
+        return data;
     }
+    if (!blockFile.open()) {   // for the block checksums; reported if damaged
+        return data;
+    }
+    const size_t count = BlockFile::rowsIn(header);
 
     if (count > 0) {
         data.resize(count);
@@ -133,13 +335,17 @@ void Column<int>::loadFromDisk() {
             
             if (!file && !file.eof()) {
                 data.clear();
-                return;
+                return data;
             }
             
             size_t bytesRead = file.gcount();
             if (bytesRead == 0) {
                 break;
             }
+            if (bytesRead == BLOCK_SIZE && !blockFile.verifyBlock(i, buffer)) {
+                data.clear();   // reported; a column with a hole in it is not loaded at all
+                return data;
+            }
             
             size_t startIdx = i * valuesPerBlock;
             size_t numValues = std::min(valuesPerBlock, count - startIdx);
@@ -150,22 +356,27 @@ void Column<int>::loadFromDisk() {
             }
         }
     }
+    return data;
 }
 
 // Template specialization for loading numeric types (double)
 template <>
-void Column<double>::loadFromDisk() {
-    data.clear();
+std::vector<double> Column<double>::readFile() const {
+    std::vector<double> data;
     std::ifstream file(fullFilePath, std::ios::binary);
     if (!file) {
-        return;
+        return data;
     }
 
-    size_t count = 0;
-    file.read(reinterpret_cast<char*>(&count), sizeof(size_t));
+    size_t header = 0;
+    file.read(reinterpret_cast<char*>(&header), sizeof(size_t));
     if (!file || file.gcount() != sizeof(size_t)) {
-        return;
+        return data;
+    }
+    if (!blockFile.open()) {   // for the block checksums; reported if damaged
+        return data;
     }
+    const size_t count = BlockFile::rowsIn(header);
 
     if (count > 0) {
         data.resize(count);
@@ -178,13 +389,17 @@ void Column<double>::loadFromDisk() {
             
             if (!file && !file.eof()) {
                 data.clear();
-                return;
+                return data;
             }
             
             size_t bytesRead = file.gcount();
             if (bytesRead == 0) {
                 break; // End of file
             }
+            if (bytesRead == BLOCK_SIZE && !blockFile.verifyBlock(i, buffer)) {
+                data.clear();   // reported; a column with a hole in it is not loaded at all
+                return data;
+            }
             
             size_t startIdx = i * valuesPerBlock;
             size_t numValues = std::min(valuesPerBlock, count - startIdx);
@@ -195,22 +410,27 @@ void Column<double>::loadFromDisk() {
             }
         }
     }
+    return data;
 }
 
 // Template specialization for loading string columns
 template <>
-void Column<std::string>::loadFromDisk() {
-    data.clear();
+std::vector<std::string> Column<std::string>::readFile() const {
+    std::vector<std::string> data;
     std::ifstream file(fullFilePath, std::ios::binary);
     if (!file) {
-        return;
+        return data;
     }
 
-    size_t count = 0;
-    file.read(reinterpret_cast<char*>(&count), sizeof(size_t));
+    size_t header = 0;
+    file.read(reinterpret_cast<char*>(&header), sizeof(size_t));
     if (!file || file.gcount() != sizeof(size_t)) {
-        return;
+        return data;
+    }
+    if (!blockFile.open()) {   // for the block checksums; reported if damaged
+        return data;
     }
+    const size_t count = BlockFile::rowsIn(header);
 
     if (count > 0) {
         data.resize(count);
@@ -223,13 +443,17 @@ void Column<std::string>::loadFromDisk() {
             
             if (!file && !file.eof()) {
                 data.clear();
-                return;
+                return data;
             }
             
             size_t bytesRead = file.gcount();
             if (bytesRead == 0) {
                 break; // End of file
             }
+            if (bytesRead == BLOCK_SIZE && !blockFile.verifyBlock(i, buffer)) {
+                data.clear();   // reported; a column with a hole in it is not loaded at all
+                return data;
+            }
             
             size_t startIdx = i * stringsPerBlock;
             size_t numStrings = std::min(stringsPerBlock, count - startIdx);
@@ -242,6 +466,27 @@ void Column<std::string>::loadFromDisk() {
             }
         }
     }
+    return data;
+}
+
+// Build a sorted dictionary and the per-record code vector for one string column
+Dictionary Dictionary::build(const std::vector<std::string>& column) {
+    Dictionary dict;
+    dict.values = column;
+    std::sort(dict.values.begin(), dict.values.end());
+    dict.values.erase(std::unique(dict.values.begin(), dict.values.end()), dict.values.end());
+
+    std::unordered_map<std::string, uint32_t> codeOf;
+    codeOf.reserve(dict.values.size());
+    for (size_t c = 0; c < dict.values.size(); c++) {
+        codeOf.emplace(dict.values[c], static_cast<uint32_t>(c));
+    }
+
+    dict.codes.resize(column.size());
+    for (size_t i = 0; i < column.size(); i++) {
+        dict.codes[i] = codeOf[column[i]];
+    }
+    return dict;
 }
 
 // build full path using <filesystem>
@@ -253,18 +498,179 @@ std::string ColumnStore::buildFullPath(const std::string& filename) const {
 
 // Constructor implementation
 ColumnStore::ColumnStore(const std::string& folderPath)
-    : dataFolderPath(folderPath), rowCount(0)
+    : dataFolderPath(folderPath), columnCache(COLUMN_MEMORY_BUDGET), rowCount(0)
 {
-    months = std::make_unique<Column<std::string>>("months", buildFullPath("col_months.dat"));
-    towns = std::make_unique<Column<std::string>>("towns", buildFullPath("col_towns.dat"));
-    flatTypes = std::make_unique<Column<std::string>>("flatTypes", buildFullPath("col_flatTypes.dat"));
-    blocks = std::make_unique<Column<std::string>>("blocks", buildFullPath("col_blocks.dat"));
-    streetNames = std::make_unique<Column<std::string>>("streetNames", buildFullPath("col_streetNames.dat"));
-    storeyRanges = std::make_unique<Column<std::string>>("storeyRanges", buildFullPath("col_storeyRanges.dat"));
-    floorAreas = std::make_unique<Column<double>>("floorAreas", buildFullPath("col_floorAreas.dat"));
-    flatModels = std::make_unique<Column<std::string>>("flatModels", buildFullPath("col_flatModels.dat"));
-    leaseCommenceDates = std::make_unique<Column<int>>("leaseCommenceDates", buildFullPath("col_leaseCommenceDates.dat"));
-    resalePrices = std::make_unique<Column<double>>("resalePrices", buildFullPath("col_resalePrices.dat"));
+    months = std::make_unique<Column<std::string>>("months", buildFullPath("col_months.dat"), columnCache);
+    towns = std::make_unique<Column<std::string>>("towns", buildFullPath("col_towns.dat"), columnCache);
+    flatTypes = std::make_unique<Column<std::string>>("flatTypes", buildFullPath("col_flatTypes.dat"), columnCache);
+    blocks = std::make_unique<Column<std::string>>("blocks", buildFullPath("col_blocks.dat"), columnCache);
+    streetNames = std::make_unique<Column<std::string>>("streetNames", buildFullPath("col_streetNames.dat"), columnCache);
+    storeyRanges = std::make_unique<Column<std::string>>("storeyRanges", buildFullPath("col_storeyRanges.dat"), columnCache);
+    floorAreas = std::make_unique<Column<double>>("floorAreas", buildFullPath("col_floorAreas.dat"), columnCache);
+    flatModels = std::make_unique<Column<std::string>>("flatModels", buildFullPath("col_flatModels.dat"), columnCache);
+    leaseCommenceDates = std::make_unique<Column<int>>("leaseCommenceDates", buildFullPath("col_leaseCommenceDates.dat"), columnCache);
+    resalePrices = std::make_unique<Column<double>>("resalePrices", buildFullPath("col_resalePrices.dat"), columnCache);
+}
+
+std::vector<ColumnBase*> ColumnStore::columns() const {
+    return { months.get(), towns.get(), flatTypes.get(), blocks.get(), streetNames.get(),
+             storeyRanges.get(), floorAreas.get(), flatModels.get(), leaseCommenceDates.get(),
+             resalePrices.get() };
+}
+
+WriteAheadLog& ColumnStore::log() {
+    if (!checkpointLog) checkpointLog = std::make_unique<WriteAheadLog>(buildFullPath("hdb.wal"));
+    return *checkpointLog;
+}
+
+std::vector<std::string> ColumnStore::replayLog(bool quiet, bool rollForward) {
+    // 1) Collect the last checkpoint's files, whether it committed (and how
+    //    many rows it holds), and the appended batches
+    std::vector<std::pair<std::string, std::string>> renames;   // (tmp, final)
+    std::vector<std::string> removals;
+    std::vector<std::string> appends;
+    bool committed = false;
+    uint64_t committedRows = 0;
+    WriteAheadLog& wal = log();
+    wal.replay([&](uint64_t, WriteAheadLog::RecordType type, const std::string& payload) {
+        size_t pos = 0;
+        std::string tmp, path;
+        switch (type) {
+            case WriteAheadLog::FileReady:
+                if (WriteAheadLog::getString(payload, pos, tmp) && WriteAheadLog::getString(payload, pos, path)) {
+                    renames.emplace_back(tmp, path);
+                }
+                break;
+            case WriteAheadLog::FileRemoved:
+                if (WriteAheadLog::getString(payload, pos, path)) removals.push_back(path);
+                break;
+            case WriteAheadLog::CheckpointCommit:
+                committed = WriteAheadLog::getU64(payload, pos, committedRows) && rollForward;
+                break;
+            case WriteAheadLog::AppendRows:
+                appends.push_back(payload);
+                break;
+        }
+    });
+
+    // 2) Committed: finish the renames. A tmp file that is already gone was
+    //    renamed before the crash, so applying the list again is harmless.
+    std::error_code ec;
+    if (committed) {
+        size_t applied = 0;
+        for (auto const& [tmp, path] : renames) {
+            if (!fs::exists(tmp, ec)) continue;
+            fs::rename(tmp, path, ec);
+            if (ec) std::cerr << "Error: Could not rename " << tmp << " to " << path << ": " << ec.message() << std::endl;
+            else applied++;
+        }
+        for (auto const& path : removals) fs::remove(path, ec);
+        WriteAheadLog::syncPath(dataFolderPath);
+        if (!quiet && applied > 0) {
+            std::cout << "Recovery: completed an interrupted save (" << applied << " files)." << std::endl;
+        }
+    } else if (!quiet && !renames.empty()) {
+        std::cout << "Recovery: discarded an uncommitted save; keeping the previous data files." << std::endl;
+    }
+
+    // 3) Whatever .tmp files remain belong to a save that never committed
+    for (auto const& entry : fs::directory_iterator(dataFolderPath, ec)) {
+        if (entry.path().extension() == ".tmp") fs::remove(entry.path(), ec);
+    }
+
+    // 4) Keep only the appends the checkpoint files don't hold: the log is
+    //    rewritten with just those, so no stale checkpoint record survives
+    std::vector<std::string> pending;
+    for (auto const& payload : appends) {
+        size_t pos = 0;
+        uint64_t first = 0, count = 0;
+        if (!WriteAheadLog::getU64(payload, pos, first) || !WriteAheadLog::getU64(payload, pos, count)) continue;
+        if (!committed || first + count > committedRows) pending.push_back(payload);
+    }
+    wal.truncate();
+    uint64_t lsn = 0;
+    for (auto const& payload : pending) lsn = wal.append(WriteAheadLog::AppendRows, payload);
+    if (lsn) wal.commit(lsn);
+    return pending;
+}
+
+size_t ColumnStore::stageRows(const std::string& payload) {
+    size_t pos = 0;
+    uint64_t first = 0, count = 0;
+    if (!WriteAheadLog::getU64(payload, pos, first) || !WriteAheadLog::getU64(payload, pos, count)) return 0;
+    if (first != months->size()) {
+        std::cerr << "Error: Appended rows start at " << first << " but the store holds "
+                  << months->size() << " rows; skipping them." << std::endl;
+        return 0;
+    }
+
+    size_t staged = 0;
+    std::string month, town, flatType, block, streetName, storeyRange, flatModel;
+    double floorArea = 0, resalePrice = 0;
+    uint64_t lease = 0;
+    for (; staged < count; staged++) {
+        bool ok = WriteAheadLog::getString(payload, pos, month)
+               && WriteAheadLog::getString(payload, pos, town)
+               && WriteAheadLog::getString(payload, pos, flatType)
+               && WriteAheadLog::getString(payload, pos, block)
+               && WriteAheadLog::getString(payload, pos, streetName)
+               && WriteAheadLog::getString(payload, pos, storeyRange)
+               && getDouble(payload, pos, floorArea)
+               && WriteAheadLog::getString(payload, pos, flatModel)
+               && WriteAheadLog::getU64(payload, pos, lease)
+               && getDouble(payload, pos, resalePrice);
+        if (!ok) break;
+
+        months->append(month);                  monthDict.append(month);
+        towns->append(town);                    townDict.append(town);
+        flatTypes->append(flatType);            flatTypeDict.append(flatType);
+        blocks->append(block);                  blockDict.append(block);
+        streetNames->append(streetName);        streetNameDict.append(streetName);
+        storeyRanges->append(storeyRange);      storeyRangeDict.append(storeyRange);
+        floorAreas->append(floorArea);
+        flatModels->append(flatModel);          flatModelDict.append(flatModel);
+        leaseCommenceDates->append(int(int64_t(lease)));
+        resalePrices->append(resalePrice);
+    }
+    return staged;
+}
+
+size_t ColumnStore::appendRows(const std::vector<DataRow>& rows,
+                               const std::function<void(size_t, size_t)>& indexRows) {
+    std::lock_guard<std::mutex> lock(appendMutex);
+    const size_t first = rowCount.load(std::memory_order_relaxed);
+    if (rows.empty()) return first;
+
+    // 1) Log the batch; once the commit returns it survives a crash
+    std::string payload;
+    WriteAheadLog::putU64(payload, first);
+    WriteAheadLog::putU64(payload, rows.size());
+    for (auto const& r : rows) {
+        WriteAheadLog::putString(payload, r.month);
+        WriteAheadLog::putString(payload, r.town);
+        WriteAheadLog::putString(payload, r.flatType);
+        WriteAheadLog::putString(payload, r.block);
+        WriteAheadLog::putString(payload, r.streetName);
+        WriteAheadLog::putString(payload, r.storeyRange);
+        putDouble(payload, r.floorArea);
+        WriteAheadLog::putString(payload, r.flatModel);
+        WriteAheadLog::putU64(payload, uint64_t(int64_t(r.leaseDate)));
+        putDouble(payload, r.resalePrice);
+    }
+    WriteAheadLog& wal = log();
+    if (!wal.commit(wal.append(WriteAheadLog::AppendRows, payload))) {
+        std::cerr << "Error: Could not log the appended rows; nothing was added." << std::endl;
+        return first;
+    }
+
+    // 2) Stage them past the watermark, where no reader looks
+    size_t staged = stageRows(payload);
+
+    // 3) Index them, then 4) publish: a reader that pins the new watermark
+    //    finds every column, dictionary and index entry already in place
+    if (indexRows) indexRows(first, first + staged);
+    rowCount.store(first + staged, std::memory_order_release);
+    return first;
 }
 
 // Load data from CSV file
@@ -286,7 +692,9 @@ void ColumnStore::loadFromCSV(const std::string& csvFilename) {
     flatModels->clear();
     leaseCommenceDates->clear();
     resalePrices->clear();
+    primaryIndex.clear();
     rowCount = 0;
+    checkpointRowCount = 0;
 
     std::string line;
     
@@ -295,64 +703,172 @@ void ColumnStore::loadFromCSV(const std::string& csvFilename) {
         return;
     }
 
-    while (std::getline(file, line)) {
-        if (line.empty() || line.find_first_not_of(" \t\r\n") == std::string::npos) {
-            continue; 
-        }
+    // 1) Read the lines; parsing them is the expensive part
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) lines.push_back(std::move(line));
+
+    // 2) Parse blocks of lines in parallel on the shared pool
+    std::vector<CsvBlock> parsed = parseCsvLines(lines);
 
-        std::stringstream ss(line);
-        std::string token;
-        std::vector<std::string> tokens;
+    // 3) Add to columns, in file order
+    for (CsvBlock& block : parsed) {
+        std::cerr << block.messages;
+        for (CsvRow& row : block.rows) {
+            months->addValue(row.month);
+            towns->addValue(row.town);
+            flatTypes->addValue(row.flatType);
+            blocks->addValue(row.block);
+            streetNames->addValue(row.streetName);
+            storeyRanges->addValue(row.storeyRange);
+            floorAreas->addValue(row.floorArea);
+            flatModels->addValue(row.flatModel);
+            leaseCommenceDates->addValue(row.leaseDate);
+            resalePrices->addValue(row.resalePrice);
 
-        while (std::getline(ss, token, ',')) {
-            token.erase(0, token.find_first_not_of(" \t\r\n"));
-            token.erase(token.find_last_not_of(" \t\r\n") + 1);
-            tokens.push_back(token);
+            rowCount++;
         }
+        block = CsvBlock();   // free it as we go
+    }
 
-        // Check if we have enough columns
-        if (tokens.size() < 10) {
-            std::cerr << "Warning: Skipping row with insufficient columns: " << line << std::endl;
-            continue;
+    buildDictionaries();
+    std::cout << "Successfully loaded " << rowCount << " records from CSV." << std::endl;
+}
+
+size_t ColumnStore::appendFromCSV(const std::string& csvFilename,
+                                  const std::function<void(size_t, size_t)>& indexRows) {
+    std::ifstream file(csvFilename);
+    if (!file) {
+        std::cerr << "Error: Could not open CSV file: " << csvFilename << std::endl;
+        return 0;
+    }
+    std::string line;
+    if (!std::getline(file, line)) {
+        std::cerr << "Error: Could not read header line or file is empty: " << csvFilename << std::endl;
+        return 0;
+    }
+
+    // 1) Read and parse exactly as loadFromCSV does
+    std::vector<std::string> lines;
+    while (std::getline(file, line)) lines.push_back(std::move(line));
+    std::vector<CsvBlock> parsed = parseCsvLines(lines);
+
+    // 2) Each parsed block is one appendRows batch: logged, indexed and
+    //    published as a unit, its views pointing into the block's strings
+    size_t appended = 0;
+    std::vector<DataRow> batch;
+    for (CsvBlock& block : parsed) {
+        std::cerr << block.messages;
+        batch.clear();
+        for (const CsvRow& r : block.rows) {
+            batch.push_back({ r.month, r.town, r.flatType, r.block, r.streetName, r.storeyRange,
+                              r.floorArea, r.flatModel, r.leaseDate, r.resalePrice });
         }
+        if (batch.empty()) continue;
+        const size_t first = appendRows(batch, indexRows);
+        if (getRowCount() == first) break;   // not logged; reported by appendRows
+        appended += getRowCount() - first;
+        block = CsvBlock();
+    }
+    std::cout << "Appended " << appended << " records from " << csvFilename << "." << std::endl;
+    return appended;
+}
+
+// Re-encode the string columns. Each dictionary holds its column in full,
+// so from here on the column's vector can be dropped and decoded again.
+void ColumnStore::buildDictionaries() {
+    const std::pair<Column<std::string>*, Dictionary*> strings[] = {
+        { months.get(), &monthDict }, { towns.get(), &townDict }, { flatTypes.get(), &flatTypeDict },
+        { blocks.get(), &blockDict }, { streetNames.get(), &streetNameDict },
+        { storeyRanges.get(), &storeyRangeDict }, { flatModels.get(), &flatModelDict } };
+    TaskGroup group;   // one column per task
+    for (auto const& [column, dict] : strings) {
+        group.run([column = column, dict = dict] {
+            *dict = Dictionary::build(column->pin().rows());
+            column->setReload([dict] { return decodeAll(*dict); });
+        });
+    }
+    group.wait();
+}
 
-        try {
-            // Parse values
-            std::string month = tokens[0];
-            std::string town = tokens[1];
-            std::string flatType = tokens[2];
-            std::string block = tokens[3];
-            std::string streetName = tokens[4];
-            std::string storeyRange = tokens[5];
-            double floorArea = std::stod(tokens[6]);
-            std::string flatModel = tokens[7];
-            int leaseDate = std::stoi(tokens[8]);
-            double resalePrice = std::stod(tokens[9]);
-
-            // Add to columns
-            months->addValue(toUpper(month));
-            towns->addValue(toUpper(town));
-            flatTypes->addValue(toUpper(flatType));
-            blocks->addValue(toUpper(block));
-            streetNames->addValue(toUpper(streetName));
-            storeyRanges->addValue(toUpper(storeyRange));
-            floorAreas->addValue(floorArea);
-            flatModels->addValue(toUpper(flatModel));
-            leaseCommenceDates->addValue(leaseDate);
-            resalePrices->addValue(resalePrice);
+// Map a column name to its string column (nullptr for unknown or numeric columns)
+const Column<std::string>* ColumnStore::stringColumn(const std::string& name) const {
+    if (name == "months")       return months.get();
+    if (name == "towns")        return towns.get();
+    if (name == "flatTypes")    return flatTypes.get();
+    if (name == "blocks")       return blocks.get();
+    if (name == "streetNames")  return streetNames.get();
+    if (name == "storeyRanges") return storeyRanges.get();
+    if (name == "flatModels")   return flatModels.get();
+    return nullptr;
+}
 
-            rowCount++;
+const Dictionary* ColumnStore::dictionaryFor(const std::string& name) const {
+    if (name == "months")       return &monthDict;
+    if (name == "towns")        return &townDict;
+    if (name == "flatTypes")    return &flatTypeDict;
+    if (name == "blocks")       return &blockDict;
+    if (name == "streetNames")  return &streetNameDict;
+    if (name == "storeyRanges") return &storeyRangeDict;
+    if (name == "flatModels")   return &flatModelDict;
+    return nullptr;
+}
+
+// Physically sort every column by the given string key columns and build the
+// sparse primary index over the result
+std::vector<size_t> ColumnStore::clusterBy(const std::vector<std::string>& sortKey) {
+    std::vector<Column<std::string>::Pinned> pinned;
+    std::vector<const std::vector<std::string>*> keyData;
+    for (auto const& name : sortKey) {
+        const Column<std::string>* col = stringColumn(name);
+        if (!col) {
+            throw std::invalid_argument("clusterBy: not a string column: " + name);
         }
-        catch (const std::exception& e) {
-            std::cerr << "Error processing row: " << line << " | Reason: " << e.what() << std::endl;
+        pinned.push_back(col->pin());
+        keyData.push_back(&pinned.back().rows());
+    }
+
+    // 1) Stable sort of row positions by the key tuple
+    std::vector<size_t> order(rowCount);
+    for (size_t i = 0; i < rowCount; i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        for (auto* col : keyData) {
+            int c = (*col)[a].compare((*col)[b]);
+            if (c != 0) return c < 0;
         }
+        return false;
+    });
+
+    // 2) Apply the same permutation to every column
+    permuteRows(order);
+
+    // 3) One index entry per granule of the sorted rows (pinned again: the
+    //    copies held above were taken before the sort)
+    pinned.clear();
+    keyData.clear();
+    for (auto const& name : sortKey) {
+        pinned.push_back(stringColumn(name)->pin());
+        keyData.push_back(&pinned.back().rows());
     }
+    primaryIndex = PrimaryIndex::build(sortKey, keyData, rowCount);
+    return order;
+}
 
-    std::cout << "Successfully loaded " << rowCount << " records from CSV." << std::endl;
+void ColumnStore::permuteRows(const std::vector<size_t>& order) {
+    months->permute(order);
+    towns->permute(order);
+    flatTypes->permute(order);
+    blocks->permute(order);
+    streetNames->permute(order);
+    storeyRanges->permute(order);
+    floorAreas->permute(order);
+    flatModels->permute(order);
+    leaseCommenceDates->permute(order);
+    resalePrices->permute(order);
+    buildDictionaries();
 }
 
 // Save all columns to disk
-void ColumnStore::saveToDisk() {
+void ColumnStore::saveToDisk(const std::vector<std::string>& sortKey) {
     std::cout << "Saving columns to disk in folder: " << dataFolderPath << " ..." << std::endl;
 
     try {
@@ -368,100 +884,363 @@ void ColumnStore::saveToDisk() {
         return;
     }
 
-    months->storeToDisk();
-    towns->storeToDisk();
-    flatTypes->storeToDisk();
-    blocks->storeToDisk();
-    streetNames->storeToDisk();
-    storeyRanges->storeToDisk();
-    floorAreas->storeToDisk();
-    flatModels->storeToDisk();
-    leaseCommenceDates->storeToDisk();
-    resalePrices->storeToDisk();
+    // Appends wait for the checkpoint, which folds the rows they added so far
+    // into the column vectors (and so into the files written below)
+    std::lock_guard<std::mutex> appendLock(appendMutex);
+
+    // The snapshot describes the files about to be replaced: it must be gone
+    // for good before any of them changes
+    std::error_code ec;
+    if (fs::remove(snapshotPath(), ec)) WriteAheadLog::syncPath(dataFolderPath);
+    if (!monthDict.tailCodes.empty()) {
+        for (ColumnBase* col : columns()) col->foldTail();
+        buildDictionaries();
+    }
+
+    std::string primaryIndexPath = buildFullPath("primary.idx");
+    PrimaryIndex previousPrimary = primaryIndex;
+    std::vector<size_t> clusterOrder;
+    if (!sortKey.empty()) {
+        std::cout << "Clustering rows by sort key before writing..." << std::endl;
+        clusterOrder = clusterBy(sortKey);
+    } else {
+        // Arrival order: any previous primary index no longer applies
+        primaryIndex.clear();
+    }
+
+    // A checkpoint that fails at any step leaves the previous files in place:
+    // the new .tmp files go (recovery removes every uncommitted one), and the
+    // rows go back to the order of those files, or fetches would mix the two
+    auto rollBack = [&] {
+        std::cerr << "Error: Checkpoint failed; keeping the previous data files." << std::endl;
+        replayLog(true, /*rollForward=*/false);
+        if (!clusterOrder.empty()) {
+            std::vector<size_t> inverse(clusterOrder.size());
+            for (size_t i = 0; i < clusterOrder.size(); i++) inverse[clusterOrder[i]] = i;
+            permuteRows(inverse);
+        }
+        primaryIndex = std::move(previousPrimary);
+    };
+
+    // Checkpoint: nothing the previous save left behind is touched until
+    // every new file is complete, synced and logged.
+    WriteAheadLog& wal = log();
+    auto fileReady = [&wal](const std::string& tmp, const std::string& path) {
+        std::string payload;
+        WriteAheadLog::putString(payload, tmp);
+        WriteAheadLog::putString(payload, path);
+        return wal.append(WriteAheadLog::FileReady, payload);
+    };
 
+    // 1) Columns go to <file>.tmp in parallel; each task logs its file and
+    //    commits, and the commits coalesce into a few fdatasyncs
+    std::vector<ColumnBase*> cols = columns();
+    std::vector<char> written(cols.size(), 0);
+    {
+        TaskGroup group;
+        for (size_t c = 0; c < cols.size(); c++) {
+            group.run([&, c] {
+                const std::string& path = cols[c]->getFileName();
+                if (!cols[c]->storeToDisk(path + ".tmp")) return;
+                written[c] = wal.commit(fileReady(path + ".tmp", path));
+            });
+        }
+    }
+
+    // 2) Row count and primary index the same way; a file is only logged
+    //    once it is written in full and synced, so a commit never names a
+    //    short or missing one
+    bool ok = std::all_of(written.begin(), written.end(), [](char w) { return w != 0; });
     std::string countFilePath = buildFullPath("rowCount.dat");
-    std::ofstream countFile(countFilePath, std::ios::binary | std::ios::trunc);
-    if (countFile) {
-        countFile.write(reinterpret_cast<const char*>(&rowCount), sizeof(size_t));
+    {
+        size_t rows = rowCount;
+        std::ofstream countFile(countFilePath + ".tmp", std::ios::binary | std::ios::trunc);
+        countFile.write(reinterpret_cast<const char*>(&rows), sizeof(size_t));
+        if (finishFile(countFile, countFilePath + ".tmp")) fileReady(countFilePath + ".tmp", countFilePath);
+        else ok = false;
+    }
+    if (!primaryIndex.empty()) {
+        const std::string tmp = primaryIndexPath + ".tmp";
+        if (primaryIndex.storeToDisk(tmp) && WriteAheadLog::syncPath(tmp)) {
+            fileReady(tmp, primaryIndexPath);
+        } else {
+            std::cerr << "Error: Could not write " << tmp << std::endl;
+            ok = false;
+        }
+    } else {
+        std::string payload;
+        WriteAheadLog::putString(payload, primaryIndexPath);
+        wal.append(WriteAheadLog::FileRemoved, payload);
+    }
+    if (!ok) {
+        rollBack();   // nothing was committed
+        return;
     }
 
+    // 3) The commit record decides the checkpoint; from here on recovery
+    //    rolls it forward, before it recovery throws the .tmp files away
+    std::string payload;
+    WriteAheadLog::putU64(payload, rowCount);
+    if (!wal.commit(wal.append(WriteAheadLog::CheckpointCommit, payload))) {
+        rollBack();   // the record may be in the log, but not durably
+        return;
+    }
+
+    // 4) Apply the renames (recovery does exactly the same from the log)
+    replayLog(true);
+    for (ColumnBase* col : cols) {
+        col->reopen();
+        col->markSaved();
+    }
+    checkpointRowCount = rowCount;
+
     std::cout << "Data saving process complete." << std::endl;
 }
 
 // Load all columns from disk
-void ColumnStore::loadFromDisk() {
+bool ColumnStore::loadFromDisk() {
     std::cout << "Loading columns from disk in folder: " << dataFolderPath << " ..." << std::endl;
 
-    size_t storedRowCount = 0;
-    std::string countFilePath = buildFullPath("rowCount.dat");
-    std::ifstream countFile(countFilePath, std::ios::binary);
-    if (countFile) {
-        countFile.read(reinterpret_cast<char*>(&storedRowCount), sizeof(size_t));
-        if (countFile.gcount() == sizeof(size_t)) {
-            std::cout << "Loaded row count from file: " << storedRowCount << std::endl;
-        }
-    }
+    // Finish or undo a save that was interrupted, so the files below are
+    // always one complete checkpoint; rows appended after it come back from the log
+    std::vector<std::string> appends = replayLog(false);
 
-    months->clear();
-    towns->clear();
-    flatTypes->clear();
-    blocks->clear();
-    streetNames->clear();
-    storeyRanges->clear();
-    floorAreas->clear();
-    flatModels->clear();
-    leaseCommenceDates->clear();
-    resalePrices->clear();
+    size_t storedRowCount = readStoredRowCount();
+    if (storedRowCount > 0) std::cout << "Loaded row count from file: " << storedRowCount << std::endl;
+
+    // Recovery may have renamed new files into place: drop the old handles
+    for (ColumnBase* col : columns()) {
+        col->clear();
+        col->reopen();
+    }
+    primaryIndex.clear();
     rowCount = 0;
+    checkpointRowCount = 0;
 
+    // String columns are read now to build their dictionaries; numeric
+    // columns only note their size and are read on first use
     months->loadFromDisk();
     towns->loadFromDisk();
     flatTypes->loadFromDisk();
     blocks->loadFromDisk();
     streetNames->loadFromDisk();
     storeyRanges->loadFromDisk();
-    floorAreas->loadFromDisk();
+    floorAreas->loadLazily();
     flatModels->loadFromDisk();
-    leaseCommenceDates->loadFromDisk();
-    resalePrices->loadFromDisk();
-
-    size_t monthsSize = months->size();
-    if (monthsSize > 0 &&
-        monthsSize == towns->size() &&
-        monthsSize == flatTypes->size() &&
-        monthsSize == blocks->size() &&
-        monthsSize == streetNames->size() &&
-        monthsSize == storeyRanges->size() &&
-        monthsSize == floorAreas->size() &&
-        monthsSize == flatModels->size() &&
-        monthsSize == leaseCommenceDates->size() &&
-        monthsSize == resalePrices->size()) {
-        
-        rowCount = monthsSize;
+    leaseCommenceDates->loadLazily();
+    resalePrices->loadLazily();
+
+    // A string column with a failing block reads back empty. A numeric one
+    // is checked block by block as it is first read, and reports damage then.
+    bool consistent = storedRowCount > 0;
+    for (ColumnBase* col : columns()) consistent = consistent && col->size() == storedRowCount;
+
+    if (consistent) {
+        // Replayed rows stay in the tails, as live appends would, so the
+        // checkpointed rows can still be dropped and read back
+        buildDictionaries();
+        size_t replayed = 0;
+        for (auto const& payload : appends) replayed += stageRows(payload);
+        rowCount = months->size();
+        checkpointRowCount = storedRowCount;
         std::cout << "Data loaded successfully. Row count: " << rowCount << std::endl;
+        if (replayed > 0) {
+            std::cout << "Recovery: replayed " << replayed << " appended rows from the log." << std::endl;
+        }
+
+        // Clustered layout: pick up the sparse primary index if it matches the data
+        if (primaryIndex.loadFromDisk(buildFullPath("primary.idx"))) {
+            if (primaryIndex.rowCount() != storedRowCount) {
+                std::cerr << "Primary index does not match the column files; ignoring it." << std::endl;
+                primaryIndex.clear();
+            } else {
+                std::cout << "Rows are clustered; loaded sparse primary index." << std::endl;
+            }
+        }
     }
-    else if (monthsSize > 0) {
-        std::cerr << "Data loaded from disk is inconsistent. Using the largest consistent subset." << std::endl;
-        
-        // Find the largest consistent subset
-        std::vector<size_t> sizes = {
-            months->size(), towns->size(), flatTypes->size(), blocks->size(),
-            streetNames->size(), storeyRanges->size(), floorAreas->size(),
-            flatModels->size(), leaseCommenceDates->size(), resalePrices->size()
-        };
-        
-        // Find the most common size
-        std::sort(sizes.begin(), sizes.end());
-        size_t mostCommonSize = sizes[sizes.size() / 2]; // Median size
-        
-        if (mostCommonSize > 0) {
-            rowCount = mostCommonSize;
-            std::cout << "Using row count: " << rowCount << std::endl;
+    else {
+        // Saves are atomic, so this is damage from outside the engine, not a crash
+        std::cerr << "Column files do not match rowCount.dat (" << storedRowCount
+                  << " rows) or fail their checksums; the store in " << dataFolderPath
+                  << " is damaged and was not loaded." << std::endl;
+        for (ColumnBase* col : columns()) col->clear();
+    }
+    return consistent;
+}
+
+
+size_t ColumnStore::readStoredRowCount() const {
+    size_t storedRowCount = 0;
+    std::ifstream countFile(buildFullPath("rowCount.dat"), std::ios::binary);
+    if (countFile) countFile.read(reinterpret_cast<char*>(&storedRowCount), sizeof(size_t));
+    return countFile.gcount() == sizeof(size_t) ? storedRowCount : 0;
+}
+
+// Snapshot sections: "store.meta" {checkpoint rows, rows}, the numeric
+// columns raw, each string column as its dictionary, and the primary index
+bool ColumnStore::writeSnapshot(SnapshotWriter& out) {
+    std::lock_guard<std::mutex> lock(appendMutex);
+    const Dictionary* dicts[] = { &monthDict, &townDict, &flatTypeDict, &blockDict,
+                                  &streetNameDict, &storeyRangeDict, &flatModelDict };
+    if (checkpointRowCount == 0 || !std::all_of(std::begin(dicts), std::end(dicts),
+                                                [](const Dictionary* d) { return d->sorted(); })) {
+        std::cerr << "Snapshot skipped: the store has values that were appended since its last load or save." << std::endl;
+        return false;
+    }
+    const size_t rows = rowCount;
+    const uint64_t meta[2] = { checkpointRowCount, rows };
+    out.section("store.meta", meta, sizeof(meta));
+
+    writeColumn(out, "col.floorAreas", *floorAreas, rows);
+    writeColumn(out, "col.leaseCommenceDates", *leaseCommenceDates, rows);
+    writeColumn(out, "col.resalePrices", *resalePrices, rows);
+
+    writeDictionary(out, "dict.months",       monthDict, rows);
+    writeDictionary(out, "dict.towns",        townDict, rows);
+    writeDictionary(out, "dict.flatTypes",    flatTypeDict, rows);
+    writeDictionary(out, "dict.blocks",       blockDict, rows);
+    writeDictionary(out, "dict.streetNames",  streetNameDict, rows);
+    writeDictionary(out, "dict.storeyRanges", storeyRangeDict, rows);
+    writeDictionary(out, "dict.flatModels",   flatModelDict, rows);
+
+    if (!primaryIndex.empty()) {
+        std::ostringstream bytes;
+        primaryIndex.write(bytes);
+        const std::string image = bytes.str();
+        out.section("store.primary", image.data(), image.size());
+    }
+    return out.ok();
+}
+
+size_t ColumnStore::loadFromSnapshot(const Snapshot& snapshot) {
+    std::cout << "Loading snapshot " << snapshot.path() << " ..." << std::endl;
+
+    // 1) Recover exactly as loadFromDisk would
+    std::vector<std::string> appends = replayLog(false);
+    const size_t storedRowCount = readStoredRowCount();
+
+    // 2) The snapshot must describe the checkpoint on disk, and the log must
+    //    still hold every row it has past that checkpoint
+    uint64_t meta[2] = { 0, 0 };
+    Snapshot::Section metaSection = snapshot.find("store.meta");
+    if (metaSection.size != sizeof(meta) || !snapshot.verify("store.meta")) return 0;
+    std::memcpy(meta, metaSection.data, sizeof(meta));
+    const size_t rows = size_t(meta[1]);
+    if (storedRowCount == 0 || meta[0] != storedRowCount || rows < storedRowCount) {
+        std::cerr << "Snapshot does not match the column files; ignoring it." << std::endl;
+        return 0;
+    }
+    size_t logged = storedRowCount;
+    for (auto const& payload : appends) {
+        size_t pos = 0;
+        uint64_t first = 0, count = 0;
+        if (WriteAheadLog::getU64(payload, pos, first) && WriteAheadLog::getU64(payload, pos, count) && first <= logged) {
+            logged = std::max(logged, size_t(first + count));
         }
-        else {
-            std::cerr << "Unable to determine consistent row count. No data loaded." << std::endl;
+    }
+    if (logged < rows) {
+        std::cerr << "Snapshot holds rows the log no longer has; ignoring it." << std::endl;
+        return 0;
+    }
+
+    // 3) Check every section before changing anything. Numeric columns are
+    //    read from their files when the snapshot adds no rows to them.
+    const bool atCheckpoint = rows == storedRowCount;
+    struct StringColumn { Column<std::string>* column; Dictionary* dict; };
+    const StringColumn strings[] = {
+        { months.get(), &monthDict }, { towns.get(), &townDict }, { flatTypes.get(), &flatTypeDict },
+        { blocks.get(), &blockDict }, { streetNames.get(), &streetNameDict },
+        { storeyRanges.get(), &storeyRangeDict }, { flatModels.get(), &flatModelDict } };
+    auto usable = [&](const std::string& name, size_t bytes) {
+        return snapshot.find(name).size == bytes && snapshot.verify(name);
+    };
+    bool ok = atCheckpoint
+           || (usable("col.floorAreas", rows * sizeof(double))
+               && usable("col.leaseCommenceDates", rows * sizeof(int))
+               && usable("col.resalePrices", rows * sizeof(double)));
+    std::vector<std::vector<std::string>> values(std::size(strings));
+    for (size_t c = 0; ok && c < std::size(strings); c++) {
+        const std::string name = "dict." + strings[c].column->getName();
+        ok = usable(name + ".codes", rows * sizeof(uint32_t))
+          && snapshot.verify(name + ".values")
+          && readDictionaryValues(snapshot.find(name + ".values"), values[c]);
+    }
+    PrimaryIndex primary;
+    if (ok && snapshot.find("store.primary").data) {
+        Snapshot::Section section = snapshot.find("store.primary");
+        std::istringstream bytes(std::string(section.data, section.size));
+        ok = snapshot.verify("store.primary") && primary.read(bytes) && primary.rowCount() == storedRowCount;
+    }
+    if (!ok) {
+        std::cerr << "Snapshot is damaged; ignoring it." << std::endl;
+        return 0;
+    }
+
+    // 4) Restore the dictionaries, one task each. The string columns are
+    //    decoded from them on first use, so the sorted dictionaries need no
+    //    rebuild and no string is copied here.
+    for (ColumnBase* col : columns()) {
+        col->clear();
+        col->reopen();
+    }
+    std::vector<char> decoded(std::size(strings), 0);
+    {
+        TaskGroup group;
+        if (!atCheckpoint) {
+            group.run([&] { assignRaw(*floorAreas, snapshot.find("col.floorAreas"), rows); });
+            group.run([&] { assignRaw(*leaseCommenceDates, snapshot.find("col.leaseCommenceDates"), rows); });
+            group.run([&] { assignRaw(*resalePrices, snapshot.find("col.resalePrices"), rows); });
+        }
+        for (size_t c = 0; c < std::size(strings); c++) {
+            group.run([&, c] {
+                Dictionary& dict = *strings[c].dict;
+                dict = Dictionary();
+                dict.values = std::move(values[c]);
+                dict.codes.resize(rows);
+                std::memcpy(dict.codes.data(), snapshot.find("dict." + strings[c].column->getName() + ".codes").data,
+                            rows * sizeof(uint32_t));
+                for (uint32_t code : dict.codes) {
+                    if (code >= dict.values.size()) return;
+                }
+                decoded[c] = 1;
+            });
         }
     }
+    if (atCheckpoint) {
+        floorAreas->loadLazily();
+        leaseCommenceDates->loadLazily();
+        resalePrices->loadLazily();
+    }
+    bool complete = std::all_of(decoded.begin(), decoded.end(), [](char d) { return d != 0; });
+    if (!complete) std::cerr << "Snapshot has codes outside its dictionaries; ignoring it." << std::endl;
+    if (complete && (floorAreas->size() != rows || leaseCommenceDates->size() != rows || resalePrices->size() != rows)) {
+        std::cerr << "Snapshot does not match the column files; ignoring it." << std::endl;
+        complete = false;
+    }
+    if (!complete) {
+        for (ColumnBase* col : columns()) col->clear();
+        return 0;
+    }
+    for (auto const& string : strings) {
+        string.column->attach(rows, [dict = string.dict] { return decodeAll(*dict); });
+    }
+    primaryIndex = std::move(primary);
+    rowCount = rows;
+    checkpointRowCount = storedRowCount;
+
+    // 5) Rows logged after the snapshot are staged like live appends
+    size_t replayed = 0;
+    for (auto const& payload : appends) {
+        size_t pos = 0;
+        uint64_t first = 0;
+        if (WriteAheadLog::getU64(payload, pos, first) && first >= rows) replayed += stageRows(payload);
+    }
+    rowCount = months->size();
+    std::cout << "Snapshot loaded. Row count: " << rowCount << std::endl;
+    if (replayed > 0) {
+        std::cout << "Recovery: replayed " << replayed << " appended rows from the log." << std::endl;
+    }
+    return rows;
 }
 
 // Get number of rows
@@ -469,52 +1248,142 @@ size_t ColumnStore::getRowCount() const {
     return rowCount;
 }
 
-std::vector<std::pair<int, ColumnStore::DataRow>>
-ColumnStore::fetchRows(const std::vector<int>& recordIndices) const {
-    // 1) Fetch each column’s (idx, value) pairs
-    auto mPairs  = months->fetchRecords(recordIndices);
-    auto tPairs  = towns->fetchRecords(recordIndices);
-    auto ftPairs = flatTypes->fetchRecords(recordIndices);
-    auto bPairs  = blocks->fetchRecords(recordIndices);
-    auto snPairs = streetNames->fetchRecords(recordIndices);
-    auto srPairs = storeyRanges->fetchRecords(recordIndices);
-    auto faPairs = floorAreas->fetchRecords(recordIndices);
-    auto fmPairs = flatModels->fetchRecords(recordIndices);
-    auto ldPairs = leaseCommenceDates->fetchRecords(recordIndices);
-    auto rpPairs = resalePrices->fetchRecords(recordIndices);
-
-    // 2) Build lookup maps
-    std::unordered_map<int, std::string>  mMap,  tMap,  ftMap,  bMap,  snMap,  srMap,  fmMap;
-    std::unordered_map<int, double>       faMap, rpMap;
-    std::unordered_map<int, int>          ldMap;
-
-    for (auto &p : mPairs)  mMap [p.first] = p.second;
-    for (auto &p : tPairs)  tMap [p.first] = p.second;
-    for (auto &p : ftPairs) ftMap[p.first] = p.second;
-    for (auto &p : bPairs)  bMap [p.first] = p.second;
-    for (auto &p : snPairs) snMap[p.first] = p.second;
-    for (auto &p : srPairs) srMap[p.first] = p.second;
-    for (auto &p : faPairs) faMap[p.first] = p.second;
-    for (auto &p : fmPairs) fmMap[p.first] = p.second;
-    for (auto &p : ldPairs) ldMap[p.first] = p.second;
-    for (auto &p : rpPairs) rpMap[p.first] = p.second;
-
-    // 3) Assemble rows in original order
-    std::vector<std::pair<int, DataRow>> rows;
-    rows.reserve(recordIndices.size());
-    for (int idx : recordIndices) {
-        DataRow row;
-        row.month       = mMap[idx];
-        row.town        = tMap[idx];
-        row.flatType    = ftMap[idx];
-        row.block       = bMap[idx];
-        row.streetName  = snMap[idx];
-        row.storeyRange = srMap[idx];
-        row.floorArea   = faMap[idx];
-        row.flatModel   = fmMap[idx];
-        row.leaseDate   = ldMap[idx];
-        row.resalePrice = rpMap[idx];
-        rows.emplace_back(idx, std::move(row));
+size_t ColumnStore::scrub() const {
+    size_t bad = 0;
+    for (ColumnBase* col : columns()) bad += BlockFile::scrub(col->getFileName());
+    return bad;
+}
+
+ColumnStore::Rows
+ColumnStore::fetchRows(const RowIdList& recordIndices, ProfileNode* profile, size_t* unreadable) const {
+    // 1) One output slot per requested position, in the caller's order
+    Rows rows(recordIndices.size(), QueryArena::current());
+    for (size_t i = 0; i < recordIndices.size(); i++) {
+        rows[i].first = recordIndices[i];
     }
+    const size_t n = recordIndices.size();
+
+    // 2) Every column fills its own field of each row in parallel on the
+    //    shared pool (distinct fields, so no locking): numeric columns read
+    //    their files, string columns point into their dictionaries. A numeric
+    //    column skips the rows of a block that fails its checksum, so each
+    //    one marks the positions it filled.
+    std::pmr::vector<char> hasFa(n, 0, rows.get_allocator()), hasLd(n, 0, rows.get_allocator()), hasRp(n, 0, rows.get_allocator());
+    TaskGroup group;
+    runProfiled(group, profile, "DictionaryDecode month",          n, [&] { decodeColumn(monthDict,       rows, &DataRow::month); });
+    runProfiled(group, profile, "DictionaryDecode town",           n, [&] { decodeColumn(townDict,        rows, &DataRow::town); });
+    runProfiled(group, profile, "DictionaryDecode flat_type",      n, [&] { decodeColumn(flatTypeDict,    rows, &DataRow::flatType); });
+    runProfiled(group, profile, "DictionaryDecode block",          n, [&] { decodeColumn(blockDict,       rows, &DataRow::block); });
+    runProfiled(group, profile, "DictionaryDecode street_name",    n, [&] { decodeColumn(streetNameDict,  rows, &DataRow::streetName); });
+    runProfiled(group, profile, "DictionaryDecode storey_range",   n, [&] { decodeColumn(storeyRangeDict, rows, &DataRow::storeyRange); });
+    runProfiled(group, profile, "ColumnFetch floor_area_sqm",      n, [&] { floorAreas->fetchInto(recordIndices,         [&](size_t p, double&& v)      { rows[p].second.floorArea   = v; hasFa[p] = 1; }); });
+    runProfiled(group, profile, "DictionaryDecode flat_model",     n, [&] { decodeColumn(flatModelDict,   rows, &DataRow::flatModel); });
+    runProfiled(group, profile, "ColumnFetch lease_commence_date", n, [&] { leaseCommenceDates->fetchInto(recordIndices, [&](size_t p, int&& v)         { rows[p].second.leaseDate   = v; hasLd[p] = 1; }); });
+    runProfiled(group, profile, "ColumnFetch resale_price",        n, [&] { resalePrices->fetchInto(recordIndices,       [&](size_t p, double&& v)      { rows[p].second.resalePrice = v; hasRp[p] = 1; }); });
+    group.wait();
+
+    // 3) Drop the rows some column could not read, keeping the caller's order,
+    //    and count those that are rows of the store (not IDs past its end)
+    const size_t published = getRowCount();
+    size_t kept = 0, lost = 0;
+    for (size_t p = 0; p < n; p++) {
+        if (!hasFa[p] || !hasLd[p] || !hasRp[p]) {
+            lost += recordIndices[p] >= 0 && size_t(recordIndices[p]) < published;
+            continue;
+        }
+        if (kept != p) rows[kept] = rows[p];
+        kept++;
+    }
+    rows.resize(kept);
+    if (unreadable) *unreadable = lost;
+    return rows;
+}
+
+std::pair<size_t, size_t>
+ColumnStore::clusteredRowRange(const PrimaryIndex::Key& lo, const PrimaryIndex::Key& hi) const {
+    if (!isClustered() || lo.size() != hi.size() || lo.size() > primaryIndex.keyColumns().size()) {
+        return {0, 0};
+    }
+
+    // 1) Granule-aligned candidate range from the sparse index
+    auto candidate = primaryIndex.lookup(lo, hi);
+    if (candidate.first >= candidate.second) return {0, 0};
+
+    // 2) Trim the edge granules: rows are sorted, so binary search the key
+    //    columns (through their dictionaries, which are always in memory)
+    std::vector<const Dictionary*> keyDicts;
+    for (size_t k = 0; k < lo.size(); k++) {
+        keyDicts.push_back(dictionaryFor(primaryIndex.keyColumns()[k]));
+    }
+    auto rowVsKey = [&](size_t row, const PrimaryIndex::Key& key) {
+        for (size_t k = 0; k < keyDicts.size(); k++) {
+            int c = keyDicts[k]->decode(keyDicts[k]->code(row)).compare(key[k]);
+            if (c != 0) return c;
+        }
+        return 0;
+    };
+
+    size_t left = candidate.first, right = candidate.second;
+    while (left < right) {                    // first row >= lo
+        size_t mid = left + (right - left) / 2;
+        if (rowVsKey(mid, lo) < 0) left = mid + 1; else right = mid;
+    }
+    size_t begin = left;
+    right = candidate.second;
+    while (left < right) {                    // first row > hi
+        size_t mid = left + (right - left) / 2;
+        if (rowVsKey(mid, hi) <= 0) left = mid + 1; else right = mid;
+    }
+    size_t end = left;
+
+    if (begin >= end) return {0, 0};
+    return {begin, end};
+}
+
+ColumnStore::Rows
+ColumnStore::fetchRowRange(size_t begin, size_t end, ProfileNode* profile, size_t* unreadable) const {
+    std::pmr::memory_resource* arena = QueryArena::current();
+    Rows rows(arena);
+    if (unreadable) *unreadable = 0;
+    if (begin >= end) return rows;
+
+    // 1) One sequential read per numeric column, columns in parallel
+    std::pmr::vector<double> fa(arena), rp(arena);
+    std::pmr::vector<int> ld(arena);
+    std::pmr::vector<char> faGood(arena), ldGood(arena), rpGood(arena);
+    const size_t n = end - begin;
+    TaskGroup group;
+    runProfiled(group, profile, "ColumnScan floor_area_sqm",      n, [&] { fa = floorAreas->fetchRange(begin, end, faGood); });
+    runProfiled(group, profile, "ColumnScan lease_commence_date", n, [&] { ld = leaseCommenceDates->fetchRange(begin, end, ldGood); });
+    runProfiled(group, profile, "ColumnScan resale_price",        n, [&] { rp = resalePrices->fetchRange(begin, end, rpGood); });
+    group.wait();
+
+    // 2) Stitch rows by position, leaving out the rows of a damaged block in
+    //    any column; a column that ends early (a short file) ends the range
+    const size_t reach = std::min({ fa.size(), ld.size(), rp.size() });
+    rows.reserve(reach);
+    for (size_t i = 0; i < reach; i++) {
+        if (!faGood[i] || !ldGood[i] || !rpGood[i]) continue;
+        DataRow row{};
+        row.floorArea   = fa[i];
+        row.leaseDate   = ld[i];
+        row.resalePrice = rp[i];
+        rows.emplace_back(static_cast<int>(begin + i), row);
+    }
+    const size_t got = rows.size();
+    if (unreadable) {
+        const size_t expected = std::min(end, getRowCount());
+        *unreadable = expected > begin + got ? expected - begin - got : 0;
+    }
+
+    // 3) String fields point into the dictionaries, again a column per task
+    runProfiled(group, profile, "DictionaryDecode month",          got, [&] { decodeColumn(monthDict,       rows, &DataRow::month); });
+    runProfiled(group, profile, "DictionaryDecode town",           got, [&] { decodeColumn(townDict,        rows, &DataRow::town); });
+    runProfiled(group, profile, "DictionaryDecode flat_type",      got, [&] { decodeColumn(flatTypeDict,    rows, &DataRow::flatType); });
+    runProfiled(group, profile, "DictionaryDecode block",          got, [&] { decodeColumn(blockDict,       rows, &DataRow::block); });
+    runProfiled(group, profile, "DictionaryDecode street_name",    got, [&] { decodeColumn(streetNameDict,  rows, &DataRow::streetName); });
+    runProfiled(group, profile, "DictionaryDecode storey_range",   got, [&] { decodeColumn(storeyRangeDict, rows, &DataRow::storeyRange); });
+    runProfiled(group, profile, "DictionaryDecode flat_model",     got, [&] { decodeColumn(flatModelDict,   rows, &DataRow::flatModel); });
+    group.wait();
     return rows;
 }
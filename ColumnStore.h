@@ -2,6 +2,7 @@
 #define COLUMN_STORE_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <stdexcept>
@@ -13,7 +14,20 @@
 #include <unordered_map>
 #include <utility>
 #include <cctype>
+#include <cstdint>
+#include <type_traits>
 #include "Constants.h"
+#include "PrimaryIndex.hpp"
+#include "BlockFile.hpp"
+#include "QueryProfile.hpp"
+#include "WriteAheadLog.hpp"
+#include "ChunkedArray.hpp"
+#include "QueryArena.hpp"
+#include "Snapshot.hpp"
+#include "ColumnCache.hpp"
+#include <atomic>
+#include <mutex>
+#include <functional>
 #include <algorithm>
 #include <cctype>
 
@@ -24,37 +38,170 @@ inline std::string toUpper(std::string s) {
 
 class ColumnStore;
 
+// Dictionary encoding of a string column (every string column has one).
+// values are sorted, so comparing codes is the same as comparing the strings.
+// Rows appended after the build get their codes in tailCodes; a value first
+// seen by an append is given the next free code (kept in extraValues), which
+// breaks the code order until the next checkpoint rebuilds the dictionary.
+struct Dictionary {
+    std::vector<std::string> values;   // code -> string
+    std::vector<uint32_t>    codes;    // record index -> code
+    ChunkedArray<uint32_t>    tailCodes;
+    ChunkedArray<std::string> extraValues;
+    std::unordered_map<std::string, uint32_t> extraCodes;   // writer only: extraValues -> code
+
+    size_t cardinality() const { return values.size() + extraValues.size(); }
+    // Codes still compare like their strings (no value arrived by append)
+    bool sorted() const { return extraValues.empty(); }
+    const std::string& decode(uint32_t code) const {
+        return code < values.size() ? values[code] : extraValues[code - values.size()];
+    }
+    uint32_t code(size_t row) const {
+        return row < codes.size() ? codes[row] : tailCodes[row - codes.size()];
+    }
+    // Rows encoded so far, appended ones included
+    size_t rows() const { return codes.size() + tailCodes.size(); }
+
+    // Returns the code of `value`, or -1 if it never occurs in the column.
+    // Safe next to the writer, so it scans extraValues rather than using
+    // extraCodes; a query looks up a handful of values.
+    int lookup(std::string_view value) const {
+        auto it = std::lower_bound(values.begin(), values.end(), value);
+        if (it != values.end() && *it == value) return int(it - values.begin());
+        for (size_t i = 0, n = extraValues.size(); i < n; i++) {
+            if (extraValues[i] == value) return int(values.size() + i);
+        }
+        return -1;
+    }
+
+    // Writer only: encode one appended row
+    void append(std::string_view value) {
+        auto it = std::lower_bound(values.begin(), values.end(), value);
+        if (it != values.end() && *it == value) {
+            tailCodes.push_back(uint32_t(it - values.begin()));
+            return;
+        }
+        auto extra = extraCodes.try_emplace(std::string(value), uint32_t(cardinality()));
+        if (extra.second) extraValues.push_back(extra.first->first);
+        tailCodes.push_back(extra.first->second);
+    }
+
+    static Dictionary build(const std::vector<std::string>& column);
+};
+
 // Column base class for polymorphism
-class ColumnBase {
+class ColumnBase : public ColumnCache::Entry {
 public:
     virtual ~ColumnBase() = default;
-    virtual void storeToDisk() = 0;
+    // Write the column to `path` and fsync it; false on any I/O error
+    virtual bool storeToDisk(const std::string& path) = 0;
     virtual void loadFromDisk() = 0;
+    // Only note how many rows the column file holds; the first pin reads them
+    virtual void loadLazily() = 0;
+    // The column file now holds exactly the rows in memory, so they may be
+    // dropped and read back (unless the column already has a cheaper source)
+    virtual void markSaved() = 0;
+    // The file was replaced underneath us: drop the open read handle
+    virtual void reopen() = 0;
+    // Move rows appended since the last checkpoint into the main vector
+    virtual void foldTail() = 0;
     virtual size_t size() const = 0;
     virtual const std::string& getFileName() const = 0;
     virtual void clear() = 0;
+    // Reorder in place so that new[i] = old[order[i]]
+    virtual void permute(const std::vector<size_t>& order) = 0;
 };
 
-// Template class for different types of columns
+// Template class for different types of columns.
+//
+// Rows up to the last load or checkpoint live in one vector that is brought
+// into memory on first use and may be dropped again by the store's
+// ColumnCache, as long as `reload` can rebuild it (from the column file, or
+// from a dictionary). Readers pin() the column for as long as they read it.
 template <typename T>
 class Column : public ColumnBase {
+public:
+    // The column's rows held in memory for one reader; rows appended since
+    // the pin was taken are readable too (under the store's watermark)
+    class Pinned {
+    public:
+        Pinned() = default;
+        const T& value(size_t i) const { return i < _dataRows ? (*_rows)[i] : (*_tail)[i - _dataRows]; }
+        // Rows up to the last load or checkpoint
+        const std::vector<T>& rows() const { return *_rows; }
+
+    private:
+        friend class Column;
+        Pinned(std::shared_ptr<const std::vector<T>> rows, size_t dataRows, const ChunkedArray<T>* tail)
+            : _rows(std::move(rows)), _dataRows(dataRows), _tail(tail) {}
+
+        std::shared_ptr<const std::vector<T>> _rows;
+        size_t                                _dataRows = 0;
+        const ChunkedArray<T>*                _tail = nullptr;
+    };
+
 private:
-    std::vector<T> data;
+    mutable std::shared_ptr<std::vector<T>> data;   // null while not resident
+    size_t dataRows = 0;           // rows `data` holds (or would hold once loaded)
+    ChunkedArray<T> tail;          // appended since the last checkpoint; only in memory and the WAL
     std::string name;
     std::string fullFilePath;
+    mutable BlockFile blockFile;   // kept open across fetches
+    ColumnCache& cache;
+    // Rebuilds `data` after an eviction; empty while memory holds the only copy
+    std::function<std::vector<T>()> reload;
+
+    // Exclusive phases: the rows in memory, about to change
+    std::vector<T>& modify();
+    std::vector<T> readFile() const;
+    // reload(), refusing a source that no longer yields every row: this is
+    // where a damaged numeric column file is found and reported, since those
+    // are first read here rather than at load
+    std::vector<T> reloadAll() const;
+    static size_t bytesOf(const std::vector<T>& rows);
 
 public:
-    Column(const std::string& colName, const std::string& path);
+    Column(const std::string& colName, const std::string& path, ColumnCache& cache = ColumnCache::unbounded());
+    ~Column() override;
     void addValue(const T& value);
     size_t size() const override;
-    void clear() override { data.clear(); }
-    void storeToDisk() override;
-    void loadFromDisk() override; 
-    std::vector<std::pair<int, T>> fetchRecords(const std::vector<int>& recordIndices) const;
-
-    const std::vector<T>& getData() const { return data; }
+    void clear() override;
+    // Replace every row (snapshot load); no concurrent readers
+    void assign(std::vector<T> values);
+    // `rows` rows that `source` produces when first pinned (snapshot load)
+    void attach(size_t rows, std::function<std::vector<T>()> source);
+    // The rows in memory can be rebuilt by `source`, so the cache may drop them
+    void setReload(std::function<std::vector<T>()> source);
+    // Append one row while readers run; it becomes visible through the store's watermark
+    void append(const T& value) { tail.push_back(value); }
+    // Checkpoint only; no concurrent readers
+    void foldTail() override;
+    // Bring the rows into memory if needed and hold them there for the caller
+    Pinned pin() const;
+    // Rows from `row` on: pins the rows in memory only if `row` falls among them
+    Pinned pinFrom(size_t row) const;
+    bool evict() const override;
+    void permute(const std::vector<size_t>& order) override;
+    bool storeToDisk(const std::string& path) override;
+    void loadFromDisk() override;
+    void loadLazily() override;
+    void markSaved() override;
+    void reopen() override { blockFile.reset(); }
+    std::pmr::vector<std::pair<int, T>> fetchRecords(const RowIdList& recordIndices) const;
+    // fn(position, T&&) for each position in recordIndices, in I/O completion order
+    template <typename Fn>
+    void fetchInto(const RowIdList& recordIndices, Fn&& fn) const;
+    // Contiguous rows [begin, end) read block by block in file order, one
+    // value per row from `begin`; good[i] is 0 where row begin + i lies in a
+    // block that fails its checksum (its value is left default)
+    std::pmr::vector<T> fetchRange(size_t begin, size_t end, std::pmr::vector<char>& good) const;
+
+    // Width of one value in the column file, and how to decode it
+    static constexpr size_t slotSize = std::is_same<T, std::string>::value ? FIXED_STRING_LEN : sizeof(T);
+    static T decodeSlot(const char* slot);
 
     const std::string& getFileName() const override { return fullFilePath; }
+    const std::string& getName() const { return name; }
 };
 
 
@@ -62,6 +209,9 @@ public:
 class ColumnStore {
 private:
     std::string dataFolderPath;
+    // Which column rows stay in memory (COLUMN_MEMORY_BUDGET); declared
+    // before the columns, which unregister from it as they go
+    ColumnCache columnCache;
     std::unique_ptr<Column<std::string>> months;
     std::unique_ptr<Column<std::string>> towns;
     std::unique_ptr<Column<std::string>> flatTypes;
@@ -73,33 +223,147 @@ private:
     std::unique_ptr<Column<int>> leaseCommenceDates;
     std::unique_ptr<Column<double>> resalePrices;
 
-    size_t rowCount; 
+    // Rows visible to readers. Appends stage rows past it and publish them
+    // with one release store once every column and index holds them.
+    std::atomic<size_t> rowCount;
+    std::mutex appendMutex;        // one appender (or checkpoint) at a time
+
+    // Rows in the column files (rowCount.dat) as of the last load or save; 0
+    // while the store has never been checkpointed
+    size_t checkpointRowCount = 0;
+
+    // Dictionaries for the string columns, rebuilt after every load
+    Dictionary monthDict;
+    Dictionary townDict;
+    Dictionary flatTypeDict;
+    Dictionary blockDict;
+    Dictionary streetNameDict;
+    Dictionary storeyRangeDict;
+    Dictionary flatModelDict;
+
+    // Sparse index over the sort key when rows are stored clustered (empty otherwise)
+    PrimaryIndex primaryIndex;
+
+    // Checkpoint log (hdb.wal), opened on first save or load
+    std::unique_ptr<WriteAheadLog> checkpointLog;
 
     std::string buildFullPath(const std::string& filename) const;
+    std::vector<ColumnBase*> columns() const;
+    WriteAheadLog& log();
+    // Roll a committed checkpoint forward (or an uncommitted one back);
+    // returns the logged appends the checkpoint files don't contain yet.
+    // `quiet` when called from saveToDisk itself. Without `rollForward` the
+    // last checkpoint is rolled back even if its commit record reached the
+    // log (a save whose commit failed has already given it up).
+    std::vector<std::string> replayLog(bool quiet, bool rollForward = true);
+    // Rows the last checkpoint wrote (rowCount.dat), 0 if there is none
+    size_t readStoredRowCount() const;
+    // Put one AppendRows payload into the columns and dictionaries (not yet visible)
+    size_t stageRows(const std::string& payload);
+    void buildDictionaries();
+    // Returns the permutation applied: new row i is old row order[i]
+    std::vector<size_t> clusterBy(const std::vector<std::string>& sortKey);
+    // Apply `order` to every column and re-encode the dictionaries
+    void permuteRows(const std::vector<size_t>& order);
+    const Column<std::string>* stringColumn(const std::string& name) const;
+    const Dictionary* dictionaryFor(const std::string& name) const;
 
 public:
     explicit ColumnStore(const std::string& folderPath = "data_store");
     void loadFromCSV(const std::string& csvFilename);
-    void saveToDisk();
-    void loadFromDisk();
+    // sortKey: string column names (e.g. {"months", "towns"}) to physically
+    // sort the rows by before writing; empty keeps the CSV arrival order
+    void saveToDisk(const std::vector<std::string>& sortKey = {});
+    // False if the files are damaged (a checksum fails, or a column does not
+    // hold rowCount.dat rows); the store is left empty then
+    bool loadFromDisk();
     size_t getRowCount() const;
+    // Reread every column file and check each block against its checksum,
+    // whether or not a query has read it; returns the blocks that fail.
+    // Runs next to queries, appends and saves (see BlockFile::scrub).
+    size_t scrub() const;
+    size_t getCheckpointRowCount() const { return checkpointRowCount; }
+
+    // Column rows are read into memory on first use and the least recently
+    // used columns are dropped once they need more than `bytes` (0 = never)
+    void setColumnMemoryBudget(size_t bytes) { columnCache.setBudget(bytes); }
+    size_t getResidentColumnBytes() { std::lock_guard<std::mutex> lock(columnCache.mutex()); return columnCache.residentBytes(); }
+
+    // Snapshot of the loaded store (see Snapshot.hpp). A snapshot describes
+    // one checkpoint, so saveToDisk deletes it before touching any file.
+    std::string snapshotPath() const { return buildFullPath("hdb.snapshot"); }
+    // Add the columns, dictionaries and primary index to `out`. Only right
+    // after a load or save: false if rows were appended since.
+    bool writeSnapshot(SnapshotWriter& out);
+    // Instead of loadFromDisk: restore the store from `snapshot` if it
+    // matches the checkpoint on disk, then stage the rows logged after it.
+    // Returns the rows the snapshot held (its indexes cover those), or 0 if
+    // it was not usable and nothing was loaded.
+    size_t loadFromSnapshot(const Snapshot& snapshot);
     std::string getDataFolderPath() const { return dataFolderPath; } 
 
+    // One row. A fetched row's strings view the column dictionaries, so
+    // fetching copies no string bytes; they stay valid until the next load or
+    // save. Rows passed to appendRows may view any caller-owned strings.
     struct DataRow {
-        std::string month;
-        std::string town;
-        std::string flatType;
-        std::string block;
-        std::string streetName;
-        std::string storeyRange;
-        double      floorArea;
-        std::string flatModel;
-        int         leaseDate;
-        double      resalePrice;
+        std::string_view month;
+        std::string_view town;
+        std::string_view flatType;
+        std::string_view block;
+        std::string_view streetName;
+        std::string_view storeyRange;
+        double           floorArea;
+        std::string_view flatModel;
+        int              leaseDate;
+        double           resalePrice;
     };
-
-    // fetchRows: given a list of record IDs, return (id, DataRow) for each
-    std::vector<std::pair<int, DataRow>> fetchRows(const std::vector<int>& recordIndices) const;
+    // Fetched rows, (row ID, row), built on the query arena
+    using Rows = std::pmr::vector<std::pair<int, DataRow>>;
+
+    // Rows one query may see: everything published before it pinned the
+    // view. Rows appended while it runs have larger IDs and are clipped away.
+    struct ReadView {
+        size_t rows = 0;
+        // Drop invisible IDs from an ascending ID list
+        void clip(RowIdList& ids) const {
+            ids.erase(std::lower_bound(ids.begin(), ids.end(), int(rows)), ids.end());
+        }
+        bool sees(int id) const { return id >= 0 && size_t(id) < rows; }
+    };
+    ReadView pin() const { return { rowCount.load(std::memory_order_acquire) }; }
+
+    // Append rows while queries run. The rows are logged (one group commit),
+    // added to every column and dictionary, handed to indexRows(begin, end)
+    // to index, and only then published. Returns the first new row ID.
+    // They reach the column files at the next saveToDisk().
+    size_t appendRows(const std::vector<DataRow>& rows,
+                      const std::function<void(size_t, size_t)>& indexRows = {});
+    // Append every row of a CSV file in the loadFromCSV format (header line
+    // first) through appendRows, one batch per parse block. Returns the rows
+    // appended; they follow the store's existing rows in file order.
+    size_t appendFromCSV(const std::string& csvFilename,
+                         const std::function<void(size_t, size_t)>& indexRows = {});
+
+    // fetchRows: given a list of record IDs, return (id, DataRow) for each.
+    // With a profile node, each column's fetch is recorded as a child of it.
+    // Rows in a block that fails its checksum are left out; `unreadable`
+    // (if given) is set to how many of the store's rows that cost, and a
+    // caller that needs every row must check it.
+    Rows fetchRows(const RowIdList& recordIndices, ProfileNode* profile = nullptr,
+                   size_t* unreadable = nullptr) const;
+
+    // fetchRowRange: contiguous rows [begin, end), read sequentially from every column;
+    // `unreadable` as for fetchRows
+    Rows fetchRowRange(size_t begin, size_t end, ProfileNode* profile = nullptr,
+                       size_t* unreadable = nullptr) const;
+
+    // Clustered layout: true when rows are sorted by the primary index key
+    bool isClustered() const { return !primaryIndex.empty(); }
+    const PrimaryIndex& getPrimaryIndex() const { return primaryIndex; }
+
+    // Exact rows [begin, end) whose sort-key prefix lies in [lo, hi]; {0,0} if none
+    std::pair<size_t, size_t> clusteredRowRange(const PrimaryIndex::Key& lo,
+                                                const PrimaryIndex::Key& hi) const;
 
     // Public Accessor methods for columns
     const Column<std::string>* getMonths() const { return months.get(); }
@@ -112,119 +376,266 @@ public:
     const Column<std::string>* getFlatModels() const { return flatModels.get(); }
     const Column<int>* getLeaseCommenceDates() const { return leaseCommenceDates.get(); }
     const Column<double>* getResalePrices() const { return resalePrices.get(); }
+
+    // Dictionary-encoded views of the string columns
+    const Dictionary& getMonthDict() const { return monthDict; }
+    const Dictionary& getTownDict() const { return townDict; }
+    const Dictionary& getFlatTypeDict() const { return flatTypeDict; }
+    const Dictionary& getBlockDict() const { return blockDict; }
+    const Dictionary& getStreetNameDict() const { return streetNameDict; }
+    const Dictionary& getStoreyRangeDict() const { return storeyRangeDict; }
+    const Dictionary& getFlatModelDict() const { return flatModelDict; }
 };
 
 
 template <typename T>
-Column<T>::Column(const std::string& colName, const std::string& path)
-    : name(colName), fullFilePath(path) {}
+Column<T>::Column(const std::string& colName, const std::string& path, ColumnCache& cache)
+    : data(std::make_shared<std::vector<T>>()), name(colName), fullFilePath(path), blockFile(path), cache(cache) {}
+
+template <typename T>
+Column<T>::~Column() {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    cache.forget(this);
+}
+
+template <typename T>
+std::vector<T>& Column<T>::modify() {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    if (!data) {
+        data = std::make_shared<std::vector<T>>(reloadAll());
+        cache.load(this, bytesOf(*data));
+    }
+    reload = nullptr;   // memory now has the only copy
+    return *data;
+}
+
+template <typename T>
+std::vector<T> Column<T>::reloadAll() const {
+    std::vector<T> values = reload();
+    if (values.size() < dataRows) {
+        throw std::runtime_error("Column " + name + ": " + fullFilePath + " is damaged (a block fails its checksum"
+                                 " or rows are missing); delete the data folder to rebuild it from the CSV");
+    }
+    return values;
+}
 
 template <typename T>
 void Column<T>::addValue(const T& value) {
-    data.push_back(value);
+    if (reload || !data) modify();
+    data->push_back(value);
+    dataRows++;
 }
 
 template <typename T>
 size_t Column<T>::size() const {
-    return data.size();
+    return dataRows + tail.size();
+}
+
+template <typename T>
+void Column<T>::clear() {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    cache.forget(this);
+    data = std::make_shared<std::vector<T>>();
+    dataRows = 0;
+    tail.clear();
+    reload = nullptr;
 }
 
+template <typename T>
+void Column<T>::assign(std::vector<T> values) {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    dataRows = values.size();
+    data = std::make_shared<std::vector<T>>(std::move(values));
+    tail.clear();
+    reload = nullptr;
+    cache.admit(this, bytesOf(*data));
+}
 
-template <> void Column<int>::storeToDisk();
-template <> void Column<int>::loadFromDisk();
-template <> void Column<double>::storeToDisk();
-template <> void Column<double>::loadFromDisk();
-template <> void Column<std::string>::storeToDisk();
-template <> void Column<std::string>::loadFromDisk();
+template <typename T>
+void Column<T>::attach(size_t rows, std::function<std::vector<T>()> source) {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    cache.forget(this);
+    data.reset();
+    dataRows = rows;
+    tail.clear();
+    reload = std::move(source);
+}
 
-// Generic implementation for trivially-copyable types (int, double, etc.)
-template<typename T>
-inline std::vector<std::pair<int, T>> Column<T>::fetchRecords(const std::vector<int>& recordIndices) const {
-    std::vector<std::pair<int, T>> out;
-    std::ifstream file(fullFilePath, std::ios::binary);
-    if (!file) return out;
-
-    size_t count = 0;
-    file.read(reinterpret_cast<char*>(&count), sizeof(size_t));
-    if (!file) return out;
-
-    const size_t valueSize = sizeof(T);
-    const size_t valuesPerBlock = BLOCK_SIZE / valueSize;
-    std::unordered_map<size_t, std::vector<int>> blockToIndices;
-
-    // Group indices by block
-    for (int idx : recordIndices) {
-        if (idx < 0 || static_cast<size_t>(idx) >= count) continue;
-        size_t block = idx / valuesPerBlock;
-        int  local = idx % valuesPerBlock;
-        blockToIndices[block].push_back(local);
+template <typename T>
+void Column<T>::setReload(std::function<std::vector<T>()> source) {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    reload = std::move(source);
+    if (data) cache.admit(this, bytesOf(*data));
+}
+
+template <typename T>
+void Column<T>::loadFromDisk() {
+    assign(readFile());
+    setReload([this] { return readFile(); });
+}
+
+template <typename T>
+void Column<T>::loadLazily() {
+    attach(blockFile.open() ? blockFile.count() : 0, [this] { return readFile(); });
+}
+
+template <typename T>
+void Column<T>::markSaved() {
+    if (!reload) setReload([this] { return readFile(); });
+}
+
+template <typename T>
+typename Column<T>::Pinned Column<T>::pin() const {
+    std::lock_guard<std::mutex> lock(cache.mutex());
+    if (!data) {
+        data = std::make_shared<std::vector<T>>(reloadAll());
+        cache.load(this, bytesOf(*data));
+    } else {
+        cache.touch(this);
     }
+    return Pinned(data, dataRows, &tail);
+}
 
-    std::vector<char> buffer(BLOCK_SIZE);
-    for (auto& kv : blockToIndices) {
-        size_t blockNum = kv.first;
-        auto const& offs = kv.second;
-
-        // Seek to this block
-        file.seekg(sizeof(size_t) + std::streamoff(blockNum) * BLOCK_SIZE, std::ios::beg);
-        file.read(buffer.data(), BLOCK_SIZE);
-        size_t bytesRead = file.gcount();
-
-        // Extract each requested value
-        for (int local : offs) {
-            size_t byteOff = local * valueSize;
-            if (byteOff + valueSize <= bytesRead) {
-                T val;
-                std::memcpy(&val, buffer.data() + byteOff, valueSize);
-                int recordIdx = static_cast<int>(blockNum * valuesPerBlock + local);
-                out.emplace_back(recordIdx, val);
-            }
-        }
+template <typename T>
+typename Column<T>::Pinned Column<T>::pinFrom(size_t row) const {
+    if (row < dataRows) return pin();
+    return Pinned(nullptr, dataRows, &tail);
+}
+
+template <typename T>
+bool Column<T>::evict() const {
+    if (!data || !reload) return false;
+    data.reset();   // readers that pinned it keep their copy
+    return true;
+}
+
+template <typename T>
+void Column<T>::foldTail() {
+    std::vector<T>& rows = modify();
+    rows.reserve(rows.size() + tail.size());
+    for (size_t i = 0; i < tail.size(); i++) rows.push_back(tail[i]);
+    dataRows = rows.size();
+    tail.clear();
+}
+
+template <typename T>
+void Column<T>::permute(const std::vector<size_t>& order) {
+    std::vector<T>& rows = modify();
+    std::vector<T> sorted;
+    sorted.reserve(order.size());
+    for (size_t i : order) {
+        sorted.push_back(std::move(rows[i]));
     }
-    return out;
+    rows = std::move(sorted);
 }
 
-// Specialization for std::string columns
+template <typename T>
+inline size_t Column<T>::bytesOf(const std::vector<T>& rows) {
+    return rows.capacity() * sizeof(T);
+}
+
+// Strings also count their heap buffers (short ones live inside the object)
+template <>
+inline size_t Column<std::string>::bytesOf(const std::vector<std::string>& rows) {
+    size_t bytes = rows.capacity() * sizeof(std::string);
+    for (auto const& s : rows) {
+        const char* inside = reinterpret_cast<const char*>(&s);
+        if (s.data() < inside || s.data() >= inside + sizeof(std::string)) bytes += s.capacity() + 1;
+    }
+    return bytes;
+}
+
+
+template <> bool Column<int>::storeToDisk(const std::string& path);
+template <> std::vector<int> Column<int>::readFile() const;
+template <> bool Column<double>::storeToDisk(const std::string& path);
+template <> std::vector<double> Column<double>::readFile() const;
+template <> bool Column<std::string>::storeToDisk(const std::string& path);
+template <> std::vector<std::string> Column<std::string>::readFile() const;
+
+// Trivially-copyable values are stored raw
+template<typename T>
+inline T Column<T>::decodeSlot(const char* slot) {
+    T val;
+    std::memcpy(&val, slot, sizeof(T));
+    return val;
+}
+
+// Strings are NUL-padded to FIXED_STRING_LEN
 template<>
-inline std::vector<std::pair<int, std::string>> Column<std::string>::fetchRecords(const std::vector<int>& recordIndices) const {
-    std::vector<std::pair<int, std::string>> out;
-    std::ifstream file(fullFilePath, std::ios::binary);
-    if (!file) return out;
-
-    size_t count = 0;
-    file.read(reinterpret_cast<char*>(&count), sizeof(size_t));
-    if (!file) return out;
-
-    const size_t strPerBlock = BLOCK_SIZE / FIXED_STRING_LEN;
-    std::unordered_map<size_t, std::vector<int>> blockToIndices;
-
-    for (int idx : recordIndices) {
-        if (idx < 0 || static_cast<size_t>(idx) >= count) continue;
-        size_t block = idx / strPerBlock;
-        int local = idx % strPerBlock;
-        blockToIndices[block].push_back(local);
+inline std::string Column<std::string>::decodeSlot(const char* slot) {
+    return std::string(slot, strnlen(slot, FIXED_STRING_LEN));
+}
+
+template<typename T>
+template<typename Fn>
+inline void Column<T>::fetchInto(const RowIdList& recordIndices, Fn&& fn) const {
+    blockFile.forEachSlot(recordIndices, slotSize, [&](size_t pos, const char* slot) {
+        fn(pos, decodeSlot(slot));
+    });
+    // rows appended since the last checkpoint are not in the file yet
+    const size_t fileRows = blockFile.open() ? blockFile.count() : 0;
+    const size_t rows = size();
+    if (rows <= fileRows) return;
+    Pinned unsaved = pinFrom(fileRows);
+    for (size_t pos = 0; pos < recordIndices.size(); pos++) {
+        int idx = recordIndices[pos];
+        if (idx >= 0 && size_t(idx) >= fileRows && size_t(idx) < rows) fn(pos, T(unsaved.value(size_t(idx))));
     }
+}
 
-    std::vector<char> buffer(BLOCK_SIZE);
-    for (auto& kv : blockToIndices) {
-        size_t blockNum = kv.first;
-        auto const& offs = kv.second;
-
-        file.seekg(sizeof(size_t) + std::streamoff(blockNum) * BLOCK_SIZE, std::ios::beg);
-        file.read(buffer.data(), BLOCK_SIZE);
-        size_t bytesRead = file.gcount();
-
-        for (int local : offs) {
-            size_t byteOff = local * FIXED_STRING_LEN;
-            if (byteOff < bytesRead) {
-                char* ptr = buffer.data() + byteOff;
-                size_t len = strnlen(ptr, FIXED_STRING_LEN);
-                std::string val(ptr, len);
-                int recordIdx = static_cast<int>(blockNum * strPerBlock + local);
-                out.emplace_back(recordIdx, val);
+// Results come back in I/O completion order, not request order.
+template<typename T>
+inline std::pmr::vector<std::pair<int, T>> Column<T>::fetchRecords(const RowIdList& recordIndices) const {
+    std::pmr::vector<std::pair<int, T>> out(QueryArena::current());
+    out.reserve(recordIndices.size());
+    fetchInto(recordIndices, [&](size_t pos, T&& val) {
+        out.emplace_back(recordIndices[pos], std::move(val));
+    });
+    return out;
+}
+
+// Contiguous rows [begin, end): one read for the whole run of blocks
+template<typename T>
+inline std::pmr::vector<T> Column<T>::fetchRange(size_t begin, size_t end, std::pmr::vector<char>& good) const {
+    std::pmr::vector<T> out(QueryArena::current());
+    good.clear();
+    if (begin >= end) return out;
+    const size_t fileEnd = blockFile.open() ? std::min(end, blockFile.count()) : 0;
+
+    if (begin < fileEnd) {
+        const size_t perBlock   = BLOCK_SIZE / slotSize;
+        const size_t firstBlock = begin / perBlock;
+        const size_t lastBlock  = (fileEnd - 1) / perBlock;
+
+        std::pmr::vector<char> buffer((lastBlock - firstBlock + 1) * BLOCK_SIZE, out.get_allocator());
+        const size_t bytesRead = blockFile.readBlocks(firstBlock, lastBlock - firstBlock + 1, buffer.data());
+
+        // a damaged block costs its own rows; the scan goes on past it
+        out.reserve(end - begin);
+        good.reserve(end - begin);
+        bool ok = true;
+        for (size_t idx = begin; idx < fileEnd; idx++) {
+            size_t blockOff = (idx / perBlock - firstBlock) * BLOCK_SIZE;
+            size_t byteOff  = blockOff + (idx % perBlock) * slotSize;
+            if (byteOff + slotSize > bytesRead) return out;
+            if (idx == begin || idx % perBlock == 0) {
+                ok = blockOff + BLOCK_SIZE > bytesRead
+                  || blockFile.verifyBlock(idx / perBlock, buffer.data() + blockOff);
             }
+            out.push_back(ok ? decodeSlot(buffer.data() + byteOff) : T());
+            good.push_back(ok);
         }
     }
+
+    // continue into the rows appended since the last checkpoint
+    const size_t rows = std::min(end, size());
+    if (std::max(begin, fileEnd) >= rows) return out;
+    Pinned unsaved = pinFrom(std::max(begin, fileEnd));
+    for (size_t idx = std::max(begin, fileEnd); idx < rows; idx++) {
+        out.push_back(unsaved.value(idx));
+        good.push_back(1);
+    }
     return out;
 }
 
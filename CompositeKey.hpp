@@ -0,0 +1,61 @@
+// CompositeKey.hpp
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <ostream>
+#include <type_traits>
+
+// Fixed-width, zero-padded string usable inside a B+ tree key. Comparing the
+// whole buffer with memcmp orders it like the std::string it came from.
+template<size_t W>
+struct FixedString {
+    // Longest string kept whole; longer ones are cut to this many bytes
+    static constexpr size_t maxLength = W - 1;
+
+    char chars[W];
+
+    FixedString() { std::memset(chars, 0, W); }
+    FixedString(const std::string &s) {
+        std::memset(chars, 0, W);
+        std::memcpy(chars, s.data(), std::min(s.size(), W - 1));
+    }
+    FixedString(const char *s) : FixedString(std::string(s)) {}
+
+    std::string str() const { return std::string(chars, strnlen(chars, W)); }
+
+    friend bool operator<(const FixedString &a, const FixedString &b)  { return std::memcmp(a.chars, b.chars, W) < 0; }
+    friend bool operator>(const FixedString &a, const FixedString &b)  { return b < a; }
+    friend bool operator<=(const FixedString &a, const FixedString &b) { return !(b < a); }
+    friend bool operator>=(const FixedString &a, const FixedString &b) { return !(a < b); }
+    friend bool operator==(const FixedString &a, const FixedString &b) { return std::memcmp(a.chars, b.chars, W) == 0; }
+    friend bool operator!=(const FixedString &a, const FixedString &b) { return !(a == b); }
+    friend std::ostream& operator<<(std::ostream &os, const FixedString &s) { return os << s.str(); }
+};
+
+// Two fields ordered lexicographically; nest for more, e.g.
+// CompositeKey<A, CompositeKey<B, C>>. Trivially copyable whenever the
+// fields are, so it can be stored in a DiskBPlusTreeNode as-is.
+template<typename First, typename Second>
+struct CompositeKey {
+    First  first{};
+    Second second{};
+
+    CompositeKey() = default;
+    CompositeKey(const First &f, const Second &s) : first(f), second(s) {}
+
+    friend bool operator<(const CompositeKey &a, const CompositeKey &b) {
+        if (a.first < b.first) return true;
+        if (b.first < a.first) return false;
+        return a.second < b.second;
+    }
+    friend bool operator>(const CompositeKey &a, const CompositeKey &b)  { return b < a; }
+    friend bool operator<=(const CompositeKey &a, const CompositeKey &b) { return !(b < a); }
+    friend bool operator>=(const CompositeKey &a, const CompositeKey &b) { return !(a < b); }
+    friend bool operator==(const CompositeKey &a, const CompositeKey &b) { return !(a < b) && !(b < a); }
+    friend bool operator!=(const CompositeKey &a, const CompositeKey &b) { return !(a == b); }
+    friend std::ostream& operator<<(std::ostream &os, const CompositeKey &k) {
+        return os << "(" << k.first << ", " << k.second << ")";
+    }
+};
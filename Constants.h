@@ -4,4 +4,45 @@ constexpr size_t BLOCK_SIZE = 512;
 constexpr size_t FIXED_STRING_LEN = 64;
 constexpr int    n_int          = 62;
 constexpr int    n_double       = 41;
-constexpr int    n_string       = 7;
\ No newline at end of file
+constexpr int    n_string       = 7;
+constexpr int    n_town_month   = 9;    // (town, month) key + (price, area) payload: 48-byte keys
+
+// rows per sparse primary-index entry: a whole number of blocks for
+// int (128/block), double (64/block) and string (8/block) columns
+constexpr size_t PRIMARY_INDEX_GRANULE = 128;
+
+// column fetches: max blocks merged into one pread, and the share of a file's
+// blocks above which a fetch switches to one sequential scan with a bitmap
+constexpr size_t READ_COALESCE_BLOCKS    = 256;
+constexpr double SEQ_SCAN_BLOCK_FRACTION = 0.25;
+
+// async block I/O: io_uring submission queue depth, and threads in the
+// pread pool used where io_uring is unavailable
+constexpr unsigned IO_URING_ENTRIES = 256;
+constexpr size_t   IO_POOL_THREADS  = 8;
+
+// B+ tree nodes kept in each DiskManager's direct-mapped node cache
+constexpr size_t NODE_CACHE_SLOTS = 256;
+
+// Local port serving the Prometheus metrics dump (0 = don't listen)
+constexpr unsigned short METRICS_PORT = 9464;
+
+// Bytes of column rows each store keeps in memory; colder columns are
+// dropped and read back on their next use (0 = keep everything)
+constexpr size_t COLUMN_MEMORY_BUDGET = size_t(64) << 20;
+
+// Seconds between background scrubs of the column files (0 = no scrub)
+constexpr unsigned SCRUB_INTERVAL_SECONDS = 600;
+
+// Bloom filters on the block and street-name indexes: bits per distinct key
+// and bits set per key (about 1% false positives at 10 and 7)
+constexpr size_t   BLOOM_BITS_PER_KEY = 10;
+constexpr unsigned BLOOM_HASHES       = 7;
+
+// Largest distance between a learned index's predicted and true position of
+// a key; the last-mile search reads 2 * this + 2 keys
+constexpr size_t LEARNED_INDEX_EPSILON = 32;
+
+// Worker threads in the shared task pool (0 = one per core);
+// TaskPool::configureShared overrides it at startup
+constexpr size_t TASK_POOL_THREADS = 0;
@@ -2,19 +2,23 @@
 #include <cstring>
 #include <algorithm>
 #include <string>
+#include <type_traits>
 #include "Constants.h"
 
 // n = max number of keys per node (from Constants.h)
 // Key must be trivially copyable (so we can memcpy it in/out of blocks)
 template<typename Key, int n>
 struct DiskBPlusTreeNode {
+    static_assert(std::is_trivially_copyable<Key>::value,
+                  "B+ tree keys are memcpy'd to disk; use FixedString/CompositeKey for compound keys");
+
     bool     isLeaf;              // leaf vs internal
     int      numKeys;             // how many keys are valid
     Key      keys[n];             // the keys in this node
     int      info[n+1];           // children offsets or record indices (and next‐leaf ptr)
 
     DiskBPlusTreeNode() : isLeaf(true), numKeys(0) {
-        std::memset(keys, 0, sizeof(keys));
+        std::memset(static_cast<void*>(keys), 0, sizeof(keys));   // trivially copyable, so bytes are enough
         std::fill_n(info, n+1, -1);
     }
 
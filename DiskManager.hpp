@@ -1,66 +1,256 @@
 // DiskManager.hpp
 #pragma once
 
-#include <fstream>
+#include <iostream>
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <memory>
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Constants.h"   // defines BLOCK_SIZE
+#include "AsyncIO.hpp"
+#include "QueryProfile.hpp"
+#include "Metrics.hpp"
+#include "OptimisticLatch.hpp"
+#include "QueryArena.hpp"
+#include "WriteAheadLog.hpp"   // crc32c
 
+// Node file of one B+ tree. Every access is a positional pread/pwrite on one
+// descriptor and new nodes claim their offset atomically, so concurrent
+// inserts and readers can share it; latch(offset) is the node's version
+// latch for optimistic lock coupling.
+//
+// A tree restored from a snapshot starts with the snapshot's node image
+// attached: blocks below the image end are read straight from the mapping
+// until they are first rewritten, and only rewritten or new blocks go to
+// the file (which is sparse meanwhile).
 template<typename Node>
 class DiskManager {
 public:
-    // Opens (or creates) the file in binary read/write mode.
+    // Creates (or empties) the file in binary read/write mode. A tree always
+    // starts from an empty root and is rebuilt from the column files on
+    // startup, so whatever an earlier run or a crash left here is unreachable:
+    // index files are derived data and need no log or fsync of their own.
     DiskManager(const std::string &filename) {
-        file_.open(filename, std::ios::in | std::ios::out | std::ios::binary);
-        if (!file_.is_open()) {
-            // file doesn't exist yet → create it
-            file_.clear();
-            file_.open(filename, std::ios::out | std::ios::binary);
-            file_.close();
-            // re‑open for read/write
-            file_.open(filename, std::ios::in | std::ios::out | std::ios::binary);
-        }
+        fd_ = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        cacheOffset_.assign(NODE_CACHE_SLOTS, -1);
+        cacheNode_.resize(NODE_CACHE_SLOTS);
     }
 
     ~DiskManager() {
-        file_.close();
+        if (fd_ >= 0) ::close(fd_);
     }
 
+    DiskManager(const DiskManager&) = delete;
+    DiskManager& operator=(const DiskManager&) = delete;
+
     // Append `node` as one BLOCK_SIZE chunk; return byte-offset at which it was written
     int writeNode(const Node &node) {
         static_assert(sizeof(Node) <= BLOCK_SIZE,
                       "Node must fit within one BLOCK_SIZE");
-        char buffer[BLOCK_SIZE] = {0};
-        std::memcpy(buffer, &node, sizeof(Node));
-
-        file_.seekp(0, std::ios::end);
-        int offset = static_cast<int>(file_.tellp());
-        file_.write(buffer, BLOCK_SIZE);
-        file_.flush();
+        int offset = end_.fetch_add(int(BLOCK_SIZE), std::memory_order_relaxed);
+        writeBlock(offset, node);
         return offset;
     }
 
     // Read a BLOCK_SIZE chunk from `offset` into a fresh Node
     Node readNode(int offset) {
+        Node node;
+        if (cacheGet(offset, node)) return node;
+
         char buffer[BLOCK_SIZE];
-        file_.seekg(offset, std::ios::beg);
-        file_.read(buffer, BLOCK_SIZE);
+        uint64_t version = latch(offset).readLock();
+        ssize_t got = readImage(offset, buffer);
+        if (got < 0) {
+            got = ::pread(fd_, buffer, BLOCK_SIZE, off_t(offset));
+            countRead();
+        }
+        if (got < ssize_t(sizeof(Node))) return node;
 
-        Node node;
         std::memcpy(&node, buffer, sizeof(Node));
+        cacheFill(offset, node, version);
         return node;
     }
 
+    // Read several nodes as one async batch; result[i] is the node at offsets[i]
+    std::pmr::vector<Node> readNodes(const std::pmr::vector<int> &offsets) {
+        std::pmr::memory_resource *arena = QueryArena::current();
+        std::pmr::vector<Node> nodes(offsets.size(), arena);
+        if (offsets.size() == 1 || fd_ < 0) {
+            for (size_t i = 0; i < offsets.size(); i++) nodes[i] = readNode(offsets[i]);
+            return nodes;
+        }
+
+        // only the cache misses outside the image go to disk
+        std::pmr::vector<size_t> missing(arena);
+        for (size_t i = 0; i < offsets.size(); i++) {
+            if (cacheGet(offsets[i], nodes[i])) continue;
+            char block[BLOCK_SIZE];
+            uint64_t version = latch(offsets[i]).readLock();
+            ssize_t got = readImage(offsets[i], block);
+            if (got < 0) {
+                missing.push_back(i);
+            } else if (got >= ssize_t(sizeof(Node))) {
+                std::memcpy(&nodes[i], block, sizeof(Node));
+                cacheFill(offsets[i], nodes[i], version);
+            }
+        }
+        if (missing.empty()) return nodes;
+
+        std::pmr::vector<char> buffer(missing.size() * BLOCK_SIZE, arena);
+        ReadRequests requests(arena);
+        std::pmr::vector<uint64_t> versions(arena);
+        requests.reserve(missing.size());
+        versions.reserve(missing.size());
+        for (size_t m = 0; m < missing.size(); m++) {
+            versions.push_back(latch(offsets[missing[m]]).readLock());
+            requests.push_back({ fd_, off_t(offsets[missing[m]]), BLOCK_SIZE, buffer.data() + m * BLOCK_SIZE });
+            countRead();
+        }
+        auto onRead = [&](size_t m, ssize_t bytesRead) {
+            if (bytesRead >= ssize_t(sizeof(Node))) {
+                size_t i = missing[m];
+                std::memcpy(&nodes[i], requests[m].buffer, sizeof(Node));
+                cacheFill(offsets[i], nodes[i], versions[m]);
+            }
+        };
+        ioBackend().readBatch(requests, std::ref(onRead));   // by reference: no std::function allocation
+        return nodes;
+    }
+
     // Overwrite the BLOCK_SIZE chunk at `offset` with `node`
     void updateNode(int offset, const Node &node) {
+        writeBlock(offset, node);
+    }
+
+    OptimisticLatch& latch(int offset) { return latches_.at(offset); }
+
+    // Serve the first `size` bytes of the node space from `image` (a
+    // snapshot mapping that outlives this manager), with crcs[i] the CRC-32C
+    // of block i. Only for a manager nothing has been written to yet.
+    void attachImage(const char *image, size_t size, const uint32_t *crcs) {
+        image_       = image;
+        imageBlocks_ = size / BLOCK_SIZE;
+        imageCrcs_   = crcs;
+        imageState_  = std::make_unique<std::atomic<uint8_t>[]>(imageBlocks_);
+        end_.store(int(imageBlocks_ * BLOCK_SIZE), std::memory_order_relaxed);
+    }
+
+    size_t bytes() const { return size_t(end_.load(std::memory_order_relaxed)); }
+
+    // fn(block) for every BLOCK_SIZE block in offset order: the node space
+    // as it is now, image and file merged. Not safe next to writers.
+    template<typename Fn>
+    bool forEachBlock(Fn &&fn) {
+        const size_t blocks = bytes() / BLOCK_SIZE;
+        std::vector<char> buffer(BLOCK_SIZE);
+        for (size_t b = 0; b < blocks; b++) {
+            int offset = int(b * BLOCK_SIZE);
+            ssize_t got = readImage(offset, buffer.data());
+            if (got < 0) got = ::pread(fd_, buffer.data(), BLOCK_SIZE, off_t(offset));
+            if (got != ssize_t(BLOCK_SIZE)) {
+                std::cerr << "DiskManager: short read at offset " << offset << std::endl;
+                return false;
+            }
+            fn(buffer.data());
+        }
+        return true;
+    }
+
+private:
+    void writeBlock(int offset, const Node &node) {
         char buffer[BLOCK_SIZE] = {0};
         std::memcpy(buffer, &node, sizeof(Node));
+        if (::pwrite(fd_, buffer, BLOCK_SIZE, off_t(offset)) != ssize_t(BLOCK_SIZE)) {
+            std::cerr << "DiskManager: short write at offset " << offset << std::endl;
+        }
+        // from now on the file has the newer copy
+        size_t block = size_t(offset) / BLOCK_SIZE;
+        if (block < imageBlocks_) imageState_[block].fetch_or(IMAGE_OVERRIDDEN, std::memory_order_release);
+        EngineMetrics::get().nodeWrites.inc();
+        cachePut(offset, node);
+    }
+
+    // Copy the block at `offset` out of the attached image, checking its CRC
+    // the first time it is read. Returns -1 when the image doesn't hold it
+    // (no image, past its end, or rewritten since), BLOCK_SIZE when served,
+    // and 0 for a block that fails its checksum, which reads as a short read.
+    ssize_t readImage(int offset, char *buffer) {
+        size_t block = size_t(offset) / BLOCK_SIZE;
+        if (block >= imageBlocks_) return -1;
+        uint8_t state = imageState_[block].load(std::memory_order_acquire);
+        if (state & IMAGE_OVERRIDDEN) return -1;
 
-        file_.seekp(offset, std::ios::beg);
-        file_.write(buffer, BLOCK_SIZE);
-        file_.flush();
+        const char *src = image_ + block * BLOCK_SIZE;
+        if (!(state & IMAGE_VERIFIED)) {
+            if (WriteAheadLog::crc32c(0, src, BLOCK_SIZE) != imageCrcs_[block]) {
+                std::cerr << "DiskManager: snapshot block at offset " << offset << " fails its checksum" << std::endl;
+                EngineMetrics::get().checksumFailures.inc();
+                return 0;
+            }
+            imageState_[block].fetch_or(IMAGE_VERIFIED, std::memory_order_relaxed);
+        }
+        std::memcpy(buffer, src, BLOCK_SIZE);
+        return ssize_t(BLOCK_SIZE);
     }
 
-private:
-    std::fstream file_;
+    // Small direct-mapped node cache (write-through), mostly catching the
+    // root and upper internal nodes that every search re-reads. Slots are
+    // guarded by striped mutexes so concurrent readers never copy a half-written node.
+    size_t cacheSlot(int offset) const {
+        return (size_t(offset) / BLOCK_SIZE) % NODE_CACHE_SLOTS;
+    }
+    bool cacheGet(int offset, Node &node) {
+        size_t slot = cacheSlot(offset);
+        {
+            std::lock_guard<std::mutex> lock(cacheLocks_[slot % CACHE_LOCK_STRIPES]);
+            if (cacheOffset_[slot] != offset) return false;
+            node = cacheNode_[slot];
+        }
+        EngineMetrics::get().nodeCacheHits.inc();
+        if (IoStats *io = currentIoStats()) io->bufferHits++;
+        return true;
+    }
+    void cachePut(int offset, const Node &node) {
+        size_t slot = cacheSlot(offset);
+        std::lock_guard<std::mutex> lock(cacheLocks_[slot % CACHE_LOCK_STRIPES]);
+        cacheOffset_[slot] = offset;
+        cacheNode_[slot]   = node;
+    }
+    // Cache a node read from disk, unless a writer latched it since `version`
+    // was taken: the copy may then predate the writer's own cachePut, and
+    // caching it would serve stale data to readers that validate later.
+    void cacheFill(int offset, const Node &node, uint64_t version) {
+        size_t slot = cacheSlot(offset);
+        std::lock_guard<std::mutex> lock(cacheLocks_[slot % CACHE_LOCK_STRIPES]);
+        if (!latch(offset).validate(version)) return;
+        cacheOffset_[slot] = offset;
+        cacheNode_[slot]   = node;
+    }
+    static void countRead() {
+        EngineMetrics::get().nodeReads.inc();
+        if (IoStats *io = currentIoStats()) {
+            io->nodeReads++;
+            io->bytesRead += BLOCK_SIZE;
+        }
+    }
+
+    static constexpr size_t CACHE_LOCK_STRIPES = 64;
+    static constexpr uint8_t IMAGE_VERIFIED   = 1;
+    static constexpr uint8_t IMAGE_OVERRIDDEN = 2;
+
+    int fd_ = -1;
+    std::atomic<int> end_{0};
+    std::vector<int>  cacheOffset_;
+    std::vector<Node> cacheNode_;
+    std::mutex        cacheLocks_[CACHE_LOCK_STRIPES];
+    NodeLatchTable<BLOCK_SIZE> latches_;
+
+    const char     *image_       = nullptr;
+    size_t          imageBlocks_ = 0;
+    const uint32_t *imageCrcs_   = nullptr;
+    std::unique_ptr<std::atomic<uint8_t>[]> imageState_;
 };
@@ -0,0 +1,282 @@
+// GroupBy.hpp
+#pragma once
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "ColumnStore.h"
+#include "QueryProfile.hpp"
+#include "QueryArena.hpp"
+
+// Columns a GROUP BY can key on (all dictionary-encoded in ColumnStore)
+enum class GroupKey {
+    Month,
+    Town,
+    FlatType,
+    StoreyRange,
+    FlatModel
+};
+
+// Aggregate functions supported by the engine
+enum class AggFunc {
+    Count,
+    Sum,
+    Avg,
+    Min,
+    Max,
+    StdDev
+};
+
+// Value an aggregate is computed over
+enum class Measure {
+    Price,          // resale_price
+    FloorArea,      // floor_area_sqm
+    PricePerSqm     // resale_price / floor_area_sqm
+};
+
+struct AggregateSpec {
+    AggFunc func;
+    Measure measure;
+};
+
+struct GroupByResult {
+    struct Group {
+        std::vector<std::string> keyValues;   // one per GroupKey, decoded
+        size_t                   count = 0;   // qualifying rows in the group
+        std::vector<double>      values;      // one per AggregateSpec
+    };
+
+    std::vector<GroupKey>      keys;
+    std::vector<AggregateSpec> aggregates;
+    std::vector<Group>         groups;       // sorted by key
+};
+
+inline std::string aggregateName(const AggregateSpec &agg) {
+    std::string fn;
+    switch (agg.func) {
+        case AggFunc::Count:  fn = "COUNT"; break;
+        case AggFunc::Sum:    fn = "SUM";   break;
+        case AggFunc::Avg:    fn = "AVG";   break;
+        case AggFunc::Min:    fn = "MIN";   break;
+        case AggFunc::Max:    fn = "MAX";   break;
+        case AggFunc::StdDev: fn = "SD";    break;
+    }
+    switch (agg.measure) {
+        case Measure::Price:       return fn + "(Price)";
+        case Measure::FloorArea:   return fn + "(Floor_area)";
+        case Measure::PricePerSqm: return fn + "(Price_per_sqm)";
+    }
+    return fn;
+}
+
+// Single-pass hash/array aggregation over a set of qualifying record IDs.
+// Group keys are packed dictionary codes, so no strings are touched until the
+// final groups are decoded.
+class GroupByEngine {
+public:
+    explicit GroupByEngine(const ColumnStore &cs) : _cs(cs) {}
+
+    // recordIndices: qualifying rows (e.g. from IndexManager::searchAll).
+    // With a profile node, the aggregation is recorded as a child of it.
+    GroupByResult run(const RowIdList &recordIndices,
+                      const std::vector<GroupKey> &keys,
+                      const std::vector<AggregateSpec> &aggregates,
+                      ProfileNode *profile = nullptr) const
+    {
+        ProfileNode *node = profile ? profile->child("GroupAggregate") : nullptr;
+        ProfileScope scope(node);
+        GroupByResult res;
+        res.keys = keys;
+        res.aggregates = aggregates;
+
+        // Rows published so far; read before the dictionaries, so every code
+        // a visible row carries is already counted in their cardinality
+        const size_t rowCount = _cs.getRowCount();
+
+        // Scratch lives on the query arena; only the result is on the heap
+        std::pmr::memory_resource *arena = QueryArena::current();
+
+        // 1) Work out how many bits each key needs in the packed group code.
+        //    The first key goes in the most significant bits, so ordering the
+        //    packed codes orders groups by key (dictionaries are sorted).
+        std::pmr::vector<const Dictionary*> dicts(arena);
+        std::pmr::vector<int> widths(arena);
+        int totalBits = 0;
+        for (GroupKey k : keys) {
+            const Dictionary &d = dictionaryFor(k);
+            dicts.push_back(&d);
+            widths.push_back(bitsFor(d.cardinality()));
+            totalBits += widths.back();
+        }
+        if (totalBits > 63) {
+            throw std::runtime_error("GroupByEngine: too many group keys to pack");
+        }
+        std::pmr::vector<int> shifts(keys.size(), arena);
+        for (int k = int(keys.size()) - 1, shift = 0; k >= 0; k--) {
+            shifts[k] = shift;
+            shift += widths[k];
+        }
+
+        // Pin only the measures some aggregate reads
+        const size_t numAggs = aggregates.size();
+        bool needPrices = false, needAreas = false;
+        for (auto const& agg : aggregates) {
+            needPrices = needPrices || agg.measure != Measure::FloorArea;
+            needAreas  = needAreas  || agg.measure != Measure::Price;
+        }
+        const Column<double>::Pinned prices = needPrices ? _cs.getResalePrices()->pin() : Column<double>::Pinned();
+        const Column<double>::Pinned areas  = needAreas  ? _cs.getFloorAreas()->pin()   : Column<double>::Pinned();
+
+        // 2) Aggregate. Small key spaces use a dense array, larger ones a hash map.
+        std::pmr::vector<uint64_t>    groupCodes(arena);   // slot -> packed key
+        std::pmr::vector<Accumulator> accs(arena);         // slot * numAggs + a
+        std::pmr::vector<size_t>      counts(arena);       // slot -> rows
+
+        const bool dense = totalBits <= DENSE_BITS;
+        std::pmr::vector<int32_t> denseSlot(arena);
+        std::pmr::unordered_map<uint64_t, size_t> hashSlot(arena);
+        if (dense) denseSlot.assign(size_t(1) << totalBits, -1);
+        if (node) node->name += dense ? " [array]" : " [hash]";
+
+        for (int idx : recordIndices) {
+            if (idx < 0 || static_cast<size_t>(idx) >= rowCount) continue;
+
+            uint64_t code = 0;
+            for (size_t k = 0; k < dicts.size(); k++) {
+                code |= uint64_t(dicts[k]->code(size_t(idx))) << shifts[k];
+            }
+
+            size_t slot;
+            if (dense) {
+                if (denseSlot[code] < 0) {
+                    denseSlot[code] = int32_t(groupCodes.size());
+                    newGroup(code, numAggs, groupCodes, accs, counts);
+                }
+                slot = size_t(denseSlot[code]);
+            } else {
+                auto it = hashSlot.find(code);
+                if (it == hashSlot.end()) {
+                    it = hashSlot.emplace(code, groupCodes.size()).first;
+                    newGroup(code, numAggs, groupCodes, accs, counts);
+                }
+                slot = it->second;
+            }
+
+            counts[slot]++;
+            for (size_t a = 0; a < numAggs; a++) {
+                double v = 0.0;
+                switch (aggregates[a].measure) {
+                    case Measure::Price:       v = prices.value(idx);                    break;
+                    case Measure::FloorArea:   v = areas.value(idx);                     break;
+                    case Measure::PricePerSqm: v = prices.value(idx) / areas.value(idx); break;
+                }
+                accs[slot * numAggs + a].add(v);
+            }
+        }
+
+        // 3) Order groups by packed code, i.e. by key; a value that arrived by
+        //    append since the last checkpoint has an out-of-order code, so
+        //    then compare the decoded keys instead
+        std::pmr::vector<size_t> order(groupCodes.size(), arena);
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        bool codesSorted = std::all_of(dicts.begin(), dicts.end(), [](const Dictionary *d) { return d->sorted(); });
+        auto keyOf = [&](size_t slot, size_t k) -> const std::string& {
+            uint64_t mask = (uint64_t(1) << widths[k]) - 1;
+            return dicts[k]->decode(uint32_t((groupCodes[slot] >> shifts[k]) & mask));
+        };
+        std::sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+            if (codesSorted) return groupCodes[x] < groupCodes[y];
+            for (size_t k = 0; k < dicts.size(); k++) {
+                int c = keyOf(x, k).compare(keyOf(y, k));
+                if (c != 0) return c < 0;
+            }
+            return false;
+        });
+
+        // 4) Decode keys and finalize aggregates
+        res.groups.reserve(order.size());
+        for (size_t slot : order) {
+            GroupByResult::Group g;
+            for (size_t k = 0; k < dicts.size(); k++) g.keyValues.push_back(keyOf(slot, k));
+            g.count = counts[slot];
+            for (size_t a = 0; a < numAggs; a++) {
+                g.values.push_back(accs[slot * numAggs + a].finalize(aggregates[a].func));
+            }
+            res.groups.push_back(std::move(g));
+        }
+        if (node) {
+            node->rowsIn  = recordIndices.size();
+            node->rowsOut = res.groups.size();
+        }
+        return res;
+    }
+
+private:
+    static constexpr int DENSE_BITS = 20;   // up to 1M dense slots
+
+    struct Accumulator {
+        size_t count = 0;
+        double sum   = 0.0;
+        double sumSq = 0.0;
+        double min   = std::numeric_limits<double>::max();
+        double max   = std::numeric_limits<double>::lowest();
+
+        void add(double v) {
+            count++;
+            sum   += v;
+            sumSq += v * v;
+            if (v < min) min = v;
+            if (v > max) max = v;
+        }
+
+        double finalize(AggFunc f) const {
+            switch (f) {
+                case AggFunc::Count: return double(count);
+                case AggFunc::Sum:   return sum;
+                case AggFunc::Avg:   return sum / count;
+                case AggFunc::Min:   return min;
+                case AggFunc::Max:   return max;
+                case AggFunc::StdDev: {
+                    double mean = sum / count;
+                    return std::sqrt(sumSq / count - mean * mean);
+                }
+            }
+            return 0.0;
+        }
+    };
+
+    static void newGroup(uint64_t code, size_t numAggs,
+                         std::pmr::vector<uint64_t> &groupCodes,
+                         std::pmr::vector<Accumulator> &accs,
+                         std::pmr::vector<size_t> &counts)
+    {
+        groupCodes.push_back(code);
+        accs.resize(accs.size() + numAggs);
+        counts.push_back(0);
+    }
+
+    // Bits needed to hold codes [0, cardinality)
+    static int bitsFor(size_t cardinality) {
+        int bits = 0;
+        while ((size_t(1) << bits) < cardinality) bits++;
+        return bits;
+    }
+
+    const Dictionary& dictionaryFor(GroupKey k) const {
+        switch (k) {
+            case GroupKey::Month:       return _cs.getMonthDict();
+            case GroupKey::Town:        return _cs.getTownDict();
+            case GroupKey::FlatType:    return _cs.getFlatTypeDict();
+            case GroupKey::StoreyRange: return _cs.getStoreyRangeDict();
+            case GroupKey::FlatModel:   return _cs.getFlatModelDict();
+        }
+        throw std::invalid_argument("GroupByEngine: unknown group key");
+    }
+
+    const ColumnStore &_cs;
+};
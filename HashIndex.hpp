@@ -0,0 +1,102 @@
+// HashIndex.hpp
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include "Interval.h"
+#include "ColumnStore.h"
+#include "QueryArena.hpp"
+
+// In-memory equality index over one string column: each distinct value maps
+// to the ascending IDs of the rows that hold it. `col = 'x'` costs one hash of
+// the key and a copy of its list, with no tree descent and no disk read.
+//
+// Nothing is saved: build() fills it in one pass over the column's dictionary
+// codes at every start. Rows appended later come in through insert(), which
+// may run next to lookups.
+class HashIndex {
+public:
+    // Filled by build() and not cleared since
+    bool ready() const { return _ready; }
+
+    // Index rows [0, rows) from the codes of `dict`
+    void build(const Dictionary &dict, size_t rows) {
+        // 1) Row count per code, so each list is allocated once
+        std::vector<std::vector<int>> lists(dict.cardinality());
+        std::vector<size_t> counts(lists.size(), 0);
+        for (size_t i = 0; i < rows; i++) counts[dict.code(i)]++;
+        for (size_t c = 0; c < lists.size(); c++) lists[c].reserve(counts[c]);
+
+        // 2) Rows in order, so every list comes out sorted
+        for (size_t i = 0; i < rows; i++) lists[dict.code(i)].push_back(int(i));
+
+        // 3) Key the lists by value; values no row has are left out
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _rows.clear();
+        _rows.reserve(lists.size());
+        for (uint32_t c = 0; c < lists.size(); c++) {
+            if (!lists[c].empty()) _rows.emplace(dict.decode(c), std::move(lists[c]));
+        }
+        _ready = true;
+    }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _rows.clear();
+        _ready = false;
+    }
+
+    // One appended row. Batches may be indexed out of order, so a late ID is
+    // put in its place rather than at the end.
+    void insert(const std::string &key, int id) {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        std::vector<int> &ids = _rows[key];
+        if (ids.empty() || ids.back() < id) ids.push_back(id);
+        else ids.insert(std::upper_bound(ids.begin(), ids.end(), id), id);
+    }
+
+    // True if every interval is a single key [k, k], the only kind this
+    // index answers
+    static bool pointsOnly(const std::vector<Interval<std::string>> &ivs) {
+        for (auto const &iv : ivs) {
+            if (iv.type != IntervalType::ClosedClosed || iv.start != iv.end) return false;
+        }
+        return true;
+    }
+
+    // Rows whose value is one of the keys of `ivs` (all points), ascending
+    RowIdList lookup(const std::vector<Interval<std::string>> &ivs) const {
+        RowIdList out(QueryArena::current());
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        size_t found = 0;
+        for (auto const &iv : ivs) {
+            auto it = _rows.find(iv.start);
+            if (it == _rows.end()) continue;
+            out.insert(out.end(), it->second.begin(), it->second.end());
+            found++;
+        }
+        lock.unlock();
+        // Lists of distinct keys share no row; a key asked for twice does
+        if (found > 1) {
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+        return out;
+    }
+
+    // Distinct keys indexed
+    size_t keys() const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _rows.size();
+    }
+
+private:
+    mutable std::shared_mutex                         _mutex;
+    std::unordered_map<std::string, std::vector<int>> _rows;
+    std::atomic<bool>                                 _ready{ false };
+};
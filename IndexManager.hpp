@@ -6,10 +6,22 @@
 #include <utility>
 #include <filesystem>
 #include <string>
+#include <limits>
+#include <atomic>
 #include "Interval.h"      
 #include "BPlusTree.hpp"    // your templated BPlusTree
+#include "CompositeKey.hpp"
 #include "ColumnStore.h"
 #include "Constants.h"
+#include "QueryProfile.hpp"
+#include "Metrics.hpp"
+#include "Log.hpp"
+#include "QueryArena.hpp"
+#include "Snapshot.hpp"
+#include "BloomFilter.hpp"
+#include "HashIndex.hpp"
+#include "LearnedIndex.hpp"
+#include "TaskPool.hpp"
 
 // Aliases for each of your per‐column trees:
 using MonthTree       = BPlusTree<std::string, n_string>;
@@ -23,6 +35,30 @@ using ModelTree       = BPlusTree<std::string, n_string>;
 using LeaseDateTree   = BPlusTree<int, n_int>;
 using PriceTree       = BPlusTree<double, n_double>;
 
+// Covering index for the standard report: keyed on (town, month), with
+// (resale_price, floor_area_sqm) carried in the key as payload so a scan
+// answers the query without touching the column files. The fields cut
+// longer strings, so the index is only built (and kept) while every town and
+// month fits; see IndexManager::fitsTownMonth.
+using TownField       = FixedString<24>;
+using MonthField      = FixedString<8>;
+using TownMonth       = CompositeKey<TownField, MonthField>;
+using PriceArea       = CompositeKey<double, double>;
+using TownMonthKey    = CompositeKey<TownMonth, PriceArea>;
+using TownMonthTree   = BPlusTree<TownMonthKey, n_town_month>;
+
+// How equality predicates on a string column are answered
+enum class EqualityIndex {
+    BPlusTree,   // the column's tree, as for ranges
+    Hash         // a HashIndex built in memory at load
+};
+
+// How predicates on a numeric column are answered
+enum class RangeIndex {
+    BPlusTree,   // the column's tree
+    Learned      // a LearnedIndex built in memory at load
+};
+
 class IndexManager {
 public:
     explicit IndexManager(const std::string &dir = "bptree")
@@ -38,7 +74,74 @@ public:
         , modelTree(dir + "/flat_model.idx")
         , leaseDateTree(dir + "/lease_commence_date.idx")
         , priceTree(dir + "/resale_price.idx")
-        {}
+        , townMonthTree(dir + "/town_month.idx")
+        {
+            // The columns our queries almost only compare for equality
+            townHash.chosen     = true;
+            flatTypeHash.chosen = true;
+            blockHash.chosen    = true;
+            streetHash.chosen   = true;
+        }
+
+    // Choose the index for equality predicates on a string column ("town",
+    // "street_name", ...); false if there is no such column. Applies from
+    // the next buildIndexes() or buildMemoryIndexes(), and not while queries
+    // run. The tree is kept either way: it answers ranges, and it is what
+    // the snapshot holds.
+    bool setEqualityIndex(const std::string &column, EqualityIndex kind) {
+        bool known = false;
+        forEachHash([&](const std::string &name, HashColumn &hash) {
+            if (name != column) return;
+            known = true;
+            hash.chosen = kind == EqualityIndex::Hash;
+            if (!hash.chosen) hash.index.clear();
+        });
+        return known;
+    }
+
+    // Same for the numeric columns ("floor_area", "lease_commence_date",
+    // "resale_price"): the tree, or a learned index. The tree is the default,
+    // since the learned index sorts its column at every start.
+    bool setRangeIndex(const std::string &column, RangeIndex kind) {
+        bool known = false;
+        forEachLearned([&](const std::string &name, auto &learned) {
+            if (name != column) return;
+            known = true;
+            learned.chosen = kind == RangeIndex::Learned;
+            if (!learned.chosen) learned.index.clear();
+        });
+        return known;
+    }
+
+    // (Re)build the chosen in-memory indexes over rows [0, rows): hash
+    // indexes from the dictionary codes, learned indexes from their columns
+    // (the only ones pinned). buildIndexes() calls it, and a start from a
+    // snapshot calls it before indexing the replayed rows.
+    void buildMemoryIndexes(const ColumnStore &cs, size_t rows) {
+        const Dictionary *dicts[] = { &cs.getMonthDict(), &cs.getTownDict(), &cs.getFlatTypeDict(),
+                                      &cs.getBlockDict(), &cs.getStreetNameDict(),
+                                      &cs.getStoreyRangeDict(), &cs.getFlatModelDict() };
+        // One task per index
+        TaskGroup group;
+        size_t i = 0;
+        forEachHash([&](const std::string &, HashColumn &hash) {
+            const Dictionary &dict = *dicts[i++];
+            if (!hash.chosen) return hash.index.clear();
+            group.run([&hash, &dict, rows] { hash.index.build(dict, std::min(rows, dict.rows())); });
+        });
+
+        auto model = [&group, rows](auto &learned, const auto *column) {
+            if (!learned.chosen) return learned.index.clear();
+            group.run([&learned, column, rows] {
+                const auto pinned = column->pin();
+                learned.index.build(rows, [&](size_t i) { return pinned.value(i); });
+            });
+        };
+        model(floorAreaModel, cs.getFloorAreas());
+        model(leaseDateModel, cs.getLeaseCommenceDates());
+        model(priceModel,     cs.getResalePrices());
+        group.wait();
+    }
 
     void buildIndexes(const ColumnStore &cs) {
         size_t rowCount = cs.getRowCount();
@@ -46,44 +149,206 @@ public:
         // Shortcut: if there’s no data, nothing to do
         if (rowCount == 0) return;
 
-        // Grab const references to each column’s data vector
-        const auto &months      = cs.getMonths()->getData();
-        const auto &towns       = cs.getTowns()->getData();
-        const auto &flatTypes   = cs.getFlatTypes()->getData();
-        const auto &blocks      = cs.getBlocks()->getData();
-        const auto &streets     = cs.getStreetNames()->getData();
-        const auto &storeys     = cs.getStoreyRanges()->getData();
-        const auto &areas       = cs.getFloorAreas()->getData();
-        const auto &models      = cs.getFlatModels()->getData();
-        const auto &leases      = cs.getLeaseCommenceDates()->getData();
-        const auto &prices      = cs.getResalePrices()->getData();
-
-        for (size_t i = 0; i < rowCount; i++) {
-            monthTree.insert(months[i], i);
-            townTree.insert(towns[i], i);
-            flatTypeTree.insert(flatTypes[i], i);
-            blockTree.insert(blocks[i], i);
-            streetTree.insert(streets[i], i);
-            storeyTree.insert(storeys[i], i);
-            floorAreaTree.insert(areas[i], i);
-            modelTree.insert(models[i], i);
-            leaseDateTree.insert(leases[i], i);
-            priceTree.insert(prices[i], i);
-
-            if ((i % 50) == 0) 
-            {
-                std::cout << "Indexed " << i << " / " << rowCount << " (<2min)\r" << std::flush;
+        // Pin every column in memory for the whole build
+        const auto months      = cs.getMonths()->pin();
+        const auto towns       = cs.getTowns()->pin();
+        const auto flatTypes   = cs.getFlatTypes()->pin();
+        const auto blocks      = cs.getBlocks()->pin();
+        const auto streets     = cs.getStreetNames()->pin();
+        const auto storeys     = cs.getStoreyRanges()->pin();
+        const auto areas       = cs.getFloorAreas()->pin();
+        const auto models      = cs.getFlatModels()->pin();
+        const auto leases      = cs.getLeaseCommenceDates()->pin();
+        const auto prices      = cs.getResalePrices()->pin();
+
+        buildMemoryIndexes(cs, rowCount);
+
+        // Every distinct key once, from the dictionaries
+        blockBloom  = bloomOver(cs.getBlockDict());
+        streetBloom = bloomOver(cs.getStreetNameDict());
+
+        // One task per tree on the shared pool. The trees share nothing, so
+        // each is filled with plain serial inserts while the others fill
+        // on other workers.
+        TaskGroup group;
+        auto fill = [&](auto &tree, const auto &column) {
+            group.run([&tree, &column, rowCount] {
+                for (size_t i = 0; i < rowCount; i++) tree.insert(column.value(i), int(i));
+            });
+        };
+        fill(monthTree,     months);
+        fill(townTree,      towns);
+        fill(flatTypeTree,  flatTypes);
+        fill(blockTree,     blocks);
+        fill(streetTree,    streets);
+        fill(storeyTree,    storeys);
+        fill(floorAreaTree, areas);
+        fill(modelTree,     models);
+        fill(leaseDateTree, leases);
+        fill(priceTree,     prices);
+
+        // The covering index has the widest keys and is the last to finish,
+        // so it reports progress for the whole build. A town or month its
+        // fields would cut could share a key with another, so then it is left
+        // empty and queries take the other paths.
+        ProgressReporter progress("Indexed", rowCount);
+        townMonthUsable = fitsTownMonth(cs.getTownDict(), cs.getMonthDict());
+        if (townMonthUsable) {
+            group.run([&] {
+                for (size_t i = 0; i < rowCount; i++) {
+                    townMonthTree.insert(TownMonthKey{ { towns.value(i), months.value(i) },
+                                                       { prices.value(i), areas.value(i) } }, int(i));
+                    progress.update(i + 1);
+                }
+            });
+        } else {
+            std::cerr << "A town or month is longer than the town_month index keeps ("
+                      << TownField::maxLength << " / " << MonthField::maxLength
+                      << " bytes); not building it." << std::endl;
+        }
+        group.wait();
+        progress.finish(rowCount);
+        std::cout << "Index build complete for " << rowCount << " rows.\n";   //should be 222834
+    }
+
+    // Index rows [begin, end) that ColumnStore::appendRows just staged. Runs
+    // next to queries, so it goes through the trees' concurrent insert; the
+    // store publishes the rows only after this returns.
+    void indexRows(const ColumnStore &cs, size_t begin, size_t end) {
+        // The new rows are in the tails, so the pins load nothing for them
+        const auto months    = cs.getMonths()->pinFrom(begin);
+        const auto towns     = cs.getTowns()->pinFrom(begin);
+        const auto flatTypes = cs.getFlatTypes()->pinFrom(begin);
+        const auto blocks    = cs.getBlocks()->pinFrom(begin);
+        const auto streets   = cs.getStreetNames()->pinFrom(begin);
+        const auto storeys   = cs.getStoreyRanges()->pinFrom(begin);
+        const auto areas     = cs.getFloorAreas()->pinFrom(begin);
+        const auto models    = cs.getFlatModels()->pinFrom(begin);
+        const auto leases    = cs.getLeaseCommenceDates()->pinFrom(begin);
+        const auto prices    = cs.getResalePrices()->pinFrom(begin);
+        auto hashed = [](HashColumn &hash, const std::string &key, int id) {
+            if (hash.usable()) hash.index.insert(key, id);
+        };
+        for (size_t i = begin; i < end; i++) {
+            int id = int(i);
+            hashed(monthHash,    months.value(i),    id);
+            hashed(townHash,     towns.value(i),     id);
+            hashed(flatTypeHash, flatTypes.value(i), id);
+            hashed(blockHash,    blocks.value(i),    id);
+            hashed(streetHash,   streets.value(i),   id);
+            hashed(storeyHash,   storeys.value(i),   id);
+            hashed(modelHash,    models.value(i),    id);
+            if (floorAreaModel.usable()) floorAreaModel.index.insert(areas.value(i), id);
+            if (leaseDateModel.usable()) leaseDateModel.index.insert(leases.value(i), id);
+            if (priceModel.usable())     priceModel.index.insert(prices.value(i), id);
+            monthTree.insertConcurrent(months.value(i), id);
+            townTree.insertConcurrent(towns.value(i), id);
+            flatTypeTree.insertConcurrent(flatTypes.value(i), id);
+            blockBloom.add(indexedKey(blocks.value(i)));     // before the tree, so no probe
+            streetBloom.add(indexedKey(streets.value(i)));   // can miss a key the tree has
+            blockTree.insertConcurrent(blocks.value(i), id);
+            streetTree.insertConcurrent(streets.value(i), id);
+            storeyTree.insertConcurrent(storeys.value(i), id);
+            floorAreaTree.insertConcurrent(areas.value(i), id);
+            modelTree.insertConcurrent(models.value(i), id);
+            leaseDateTree.insertConcurrent(leases.value(i), id);
+            priceTree.insertConcurrent(prices.value(i), id);
+            if (townMonthUsable && !fitsTownMonth(towns.value(i), months.value(i))) {
+                std::cerr << "Appended town or month is longer than the town_month index keeps; "
+                             "no longer using it." << std::endl;
+                townMonthUsable = false;   // before the store publishes the row
+            }
+            if (townMonthUsable) {
+                townMonthTree.insertConcurrent(TownMonthKey{ { towns.value(i), months.value(i) },
+                                                             { prices.value(i), areas.value(i) } }, id);
             }
-            if (i == (rowCount - 1))
-            {
-                //should be 222834
-                std::cout << "\nIndex build complete for " << i+1 << " rows.\n";
+        }
+    }
+
+    // Add every tree to `out` as "<tree>.tree" (its Shape), "<tree>.nodes"
+    // (the node space) and "<tree>.crc" (CRC-32C of each node block, so a
+    // restored tree can check nodes one at a time as it first reads them).
+    // Nothing may insert meanwhile.
+    bool writeSnapshot(SnapshotWriter &out) {
+        bool ok = true;
+        forEachTree([&](const std::string &name, auto &tree) {
+            auto shape = tree.shape();
+            std::vector<uint32_t> crcs;
+            crcs.reserve(shape.bytes / BLOCK_SIZE);
+            out.beginSection(name + ".nodes");
+            ok = tree.forEachBlock([&](const char *block) {
+                out.append(block, BLOCK_SIZE);
+                crcs.push_back(WriteAheadLog::crc32c(0, block, BLOCK_SIZE));
+            }) && ok;
+            out.endSection();
+            out.section(name + ".crc", crcs.data(), crcs.size() * sizeof(uint32_t));
+            out.section(name + ".tree", &shape, sizeof(shape));
+        });
+        forEachBloom([&](const std::string &name, BloomFilter &bloom) {
+            if (bloom.empty()) return;
+            std::vector<uint64_t> words(bloom.bytes() / sizeof(uint64_t));
+            bloom.copyTo(words.data());
+            out.section(name + ".bloom", words.data(), bloom.bytes());
+        });
+        return ok && out.ok();
+    }
+
+    // Serve every tree from the node images in `snapshot`, which must stay
+    // open as long as this manager. Only for a manager that has indexed
+    // nothing yet. Returns the rows the images cover, or 0 (and attaches
+    // nothing) if any tree is missing or damaged, or the images do not cover
+    // exactly `expectedRows` (the rows the store restored from the snapshot).
+    size_t attachSnapshot(const Snapshot &snapshot, size_t expectedRows) {
+        bool ok = true;
+        size_t rows = 0;
+        bool first = true;
+        forEachTree([&](const std::string &name, auto &tree) {
+            using Shape = typename std::decay_t<decltype(tree)>::Shape;
+            Snapshot::Section meta = snapshot.find(name + ".tree");
+            if (!ok || tree.size() != 0 || meta.size != sizeof(Shape) || !snapshot.verify(name + ".tree")) {
+                ok = false;
+                return;
             }
+            Shape shape;
+            std::memcpy(&shape, meta.data, sizeof(shape));
+            const bool skipped = name == "town_month" && shape.rows == 0;   // see buildIndexes
+            ok = snapshot.find(name + ".nodes").size == shape.bytes
+              && snapshot.find(name + ".crc").size == shape.bytes / BLOCK_SIZE * sizeof(uint32_t)
+              && snapshot.verify(name + ".crc")
+              && (first || skipped || shape.rows == rows);
+            if (!skipped) rows = size_t(shape.rows);
+            first = false;
+        });
+        if (!ok || rows == 0) {
+            std::cerr << "Snapshot index images are missing or damaged; rebuilding the indexes." << std::endl;
+            return 0;
+        }
+        if (rows != expectedRows) {
+            std::cerr << "Snapshot index images cover " << rows << " rows, not " << expectedRows
+                      << "; rebuilding the indexes." << std::endl;
+            return 0;
         }
+        forEachTree([&](const std::string &name, auto &tree) {
+            typename std::decay_t<decltype(tree)>::Shape shape;
+            std::memcpy(&shape, snapshot.find(name + ".tree").data, sizeof(shape));
+            tree.attachImage(shape, snapshot.find(name + ".nodes").data,
+                             reinterpret_cast<const uint32_t*>(snapshot.find(name + ".crc").data));
+        });
+        // A filter that is missing or damaged only costs its tree descents
+        forEachBloom([&](const std::string &name, BloomFilter &bloom) {
+            Snapshot::Section section = snapshot.find(name + ".bloom");
+            if (!section.data || !snapshot.verify(name + ".bloom") || !bloom.load(section.data, section.size)) {
+                bloom = BloomFilter();
+            }
+        });
+        townMonthUsable = townMonthTree.size() > 0;
+        std::cout << "Indexes restored from snapshot for " << rows << " rows." << std::endl;
+        return rows;
     }
 
     // Multi‐attribute search. Each param defaults to {} → “no filter → all records.”
-    std::vector<int> searchAll(
+    // The result and every intermediate list live on the query arena.
+    RowIdList searchAll(
         const std::vector<Interval<std::string>>&    monthIVs   = {},
         const std::vector<Interval<std::string>>&  townIVs      = {},
         const std::vector<Interval<std::string>>&  flatTypeIVs  = {},
@@ -93,55 +358,138 @@ public:
         const std::vector<Interval<double>>&       floorAreaIVs = {},
         const std::vector<Interval<std::string>>&  modelIVs     = {},
         const std::vector<Interval<int>>&          leaseDateIVs = {},
-        const std::vector<Interval<double>>&       priceIVs     = {}
+        const std::vector<Interval<double>>&       priceIVs     = {},
+        ProfileNode*                               profile      = nullptr
     ) {
-        // 1) Get the per‐column result lists
-        auto mRes  = monthTree.    searchIntervals(monthIVs);
-        std::cout << "Month filter returned "       << mRes.size() << " IDs\n";
-        auto tRes  = townTree.     searchIntervals(townIVs);
-        std::cout << "Town filter returned "        << tRes.size() << " IDs\n";
-        auto ftRes = flatTypeTree. searchIntervals(flatTypeIVs);
-        std::cout << "FlatType filter returned "    << ftRes.size() << " IDs\n";
-        auto bRes  = blockTree.    searchIntervals(blockIVs);
-        std::cout << "Block filter returned "       << bRes.size() << " IDs\n";
-        auto sRes  = streetTree.   searchIntervals(streetIVs);
-        std::cout << "StreetName filter returned "  << sRes.size() << " IDs\n";
-        auto srRes = storeyTree.   searchIntervals(storeyIVs);
-        std::cout << "StoreyRange filter returned " << srRes.size() << " IDs\n";
-        auto faRes = floorAreaTree.searchIntervals(floorAreaIVs);
-        std::cout << "FloorArea filter returned "   << faRes.size() << " IDs\n";
-        auto moRes = modelTree.    searchIntervals(modelIVs);
-        std::cout << "FlatModel filter returned "   << moRes.size() << " IDs\n";
-        auto ldRes = leaseDateTree.searchIntervals(leaseDateIVs);
-        std::cout << "LeaseDate filter returned "   << ldRes.size() << " IDs\n";
-        auto pRes  = priceTree.    searchIntervals(priceIVs);
-        std::cout << "ResalePrice filter returned " << pRes.size() << " IDs\n";
-
-        // 2) Put them into a vector for easy looping
-        std::vector<std::vector<int>> lists = {
-            std::move(mRes), std::move(tRes), std::move(ftRes), std::move(bRes),
-            std::move(sRes), std::move(srRes), std::move(faRes),
-            std::move(moRes), std::move(ldRes), std::move(pRes)
+        // 0) Equality keys on block and street name go past their Bloom
+        //    filters first. A key no row has matches nothing, and a column
+        //    left with no interval empties the whole conjunction.
+        std::vector<Interval<std::string>> blockKept  = dropAbsentKeys(blockBloom, blockIVs, "block", profile);
+        std::vector<Interval<std::string>> streetKept = dropAbsentKeys(streetBloom, streetIVs, "street_name", profile);
+        if (blockKept.size() < blockIVs.size() && blockKept.empty()) return RowIdList(QueryArena::current());
+        if (streetKept.size() < streetIVs.size() && streetKept.empty()) return RowIdList(QueryArena::current());
+
+        // 1) Get the per‐column result lists (one IndexScan operator per probed
+        //    tree). An unfiltered column would contribute every row ID, which
+        //    changes no intersection, so it is not scanned at all.
+        std::pmr::vector<RowIdList> lists(QueryArena::current());
+        lists.reserve(10);
+        auto scan = [&](auto &tree, const auto &ivs, const char *column) {
+            if (ivs.empty()) return;
+            ProfileNode *node = nullptr;
+            if (profile) {
+                node = profile->child(std::string("IndexScan ") + column + " [" + std::to_string(ivs.size()) + " intervals]");
+            }
+            ProfileScope scope(node);
+            lists.push_back(tree.searchIntervals(ivs));
+            if (node) node->rowsOut = lists.back().size();
+            HDB_LOG(Debug, Index, column << " filter returned " << lists.back().size() << " IDs");
+        };
+        // String columns: keys only go to the column's hash index when it
+        // has one, anything else to its tree
+        auto lookup = [&](const HashColumn &hash, auto &tree, const auto &ivs, const char *column) {
+            if (ivs.empty() || !hash.usable() || !HashIndex::pointsOnly(ivs)) return scan(tree, ivs, column);
+            ProfileNode *node = nullptr;
+            if (profile) {
+                node = profile->child(std::string("HashLookup ") + column + " [" + std::to_string(ivs.size()) + " keys]");
+            }
+            ProfileScope scope(node);
+            lists.push_back(hash.index.lookup(ivs));
+            EngineMetrics::get().hashLookups.inc(ivs.size());
+            if (node) node->rowsOut = lists.back().size();
+            HDB_LOG(Debug, Index, column << " hash lookup returned " << lists.back().size() << " IDs");
         };
+        // Numeric columns: the learned index where there is one
+        auto ranged = [&](const auto &learned, auto &tree, const auto &ivs, const char *column) {
+            if (ivs.empty() || !learned.usable()) return scan(tree, ivs, column);
+            ProfileNode *node = nullptr;
+            if (profile) {
+                node = profile->child(std::string("LearnedIndexScan ") + column + " [" + std::to_string(ivs.size()) + " intervals]");
+            }
+            ProfileScope scope(node);
+            lists.push_back(learned.index.searchIntervals(ivs));
+            EngineMetrics::get().learnedProbes.inc(ivs.size());
+            if (node) node->rowsOut = lists.back().size();
+            HDB_LOG(Debug, Index, column << " learned index returned " << lists.back().size() << " IDs");
+        };
+        lookup(monthHash,    monthTree,    monthIVs,    "month");
+        lookup(townHash,     townTree,     townIVs,     "town");
+        lookup(flatTypeHash, flatTypeTree, flatTypeIVs, "flat_type");
+        lookup(blockHash,    blockTree,    blockKept,   "block");
+        lookup(streetHash,   streetTree,   streetKept,  "street_name");
+        lookup(storeyHash,   storeyTree,   storeyIVs,   "storey_range");
+        ranged(floorAreaModel, floorAreaTree, floorAreaIVs, "floor_area_sqm");
+        lookup(modelHash,    modelTree,    modelIVs,    "flat_model");
+        ranged(leaseDateModel, leaseDateTree, leaseDateIVs, "lease_commence_date");
+        ranged(priceModel,     priceTree,     priceIVs,     "resale_price");
+        if (lists.empty()) return monthTree.searchIntervals();   // no filter at all
 
-        // 3) Intersect them all
-        return intersectAll(lists);
+        // 2) Intersect them all
+        ProfileNode *node = profile ? profile->child("Intersect") : nullptr;
+        ProfileScope scope(node);
+        auto result = intersectAll(lists);
+        size_t scanned = 0;
+        for (auto const &l : lists) scanned += l.size();
+        EngineMetrics::get().rowsScannedIndex.inc(scanned);
+        if (node) {
+            node->rowsIn  = scanned;
+            node->rowsOut = result.size();
+        }
+        return result;
+    }
+
+    bool hasTownMonthIndex() const { return townMonthUsable && townMonthTree.size() > 0; }
+
+    // True if the town_month key holds `town` and `month` whole
+    static bool fitsTownMonth(std::string_view town, std::string_view month) {
+        return town.size() <= TownField::maxLength && month.size() <= MonthField::maxLength;
+    }
+    // ... and every value of the two dictionaries
+    static bool fitsTownMonth(const Dictionary &towns, const Dictionary &months) {
+        auto longest = [](const Dictionary &dict) {
+            size_t n = 0;
+            for (uint32_t c = 0; c < dict.cardinality(); c++) n = std::max(n, dict.decode(c).size());
+            return n;
+        };
+        return longest(towns) <= TownField::maxLength && longest(months) <= MonthField::maxLength;
+    }
+
+    // Covering scan: every (town, month, price, area) entry for `town` with
+    // month in [fromMonth, toMonth], as one contiguous run of leaves. Results
+    // come in key order (month, then price), paired with their row IDs.
+    TownMonthTree::Result scanTownMonths(const std::string &town,
+                                         const std::string &fromMonth,
+                                         const std::string &toMonth,
+                                         ProfileNode *profile = nullptr)
+    {
+        ProfileNode *node = profile ? profile->child("CoveringIndexScan town_month") : nullptr;
+        ProfileScope scope(node);
+        if (!fitsTownMonth(town, fromMonth) || !fitsTownMonth(town, toMonth)) {
+            return TownMonthTree::Result(QueryArena::current());   // cut short it would match another key
+        }
+        const double lowest  = std::numeric_limits<double>::lowest();
+        const double highest = std::numeric_limits<double>::max();
+        TownMonthKey lo{ { town, fromMonth }, { lowest,  lowest  } };
+        TownMonthKey hi{ { town, toMonth   }, { highest, highest } };
+        auto entries = townMonthTree.searchRange(lo, hi);
+        EngineMetrics::get().rowsScannedIndex.inc(entries.size());
+        if (node) node->rowsOut = entries.size();
+        return entries;
     }
 
-private:
     // Efficient k‐way intersection of sorted, unique integer lists
-    static std::vector<int> intersectAll(
-        const std::vector<std::vector<int>>& lists
-    ) {
+    static RowIdList intersectAll(const std::pmr::vector<RowIdList>& lists) {
         // Start with the first non‐empty list; if all empty, return {}
-        std::vector<int> result;
+        RowIdList result(QueryArena::current());
+        RowIdList scratch(QueryArena::current());
         bool first = true;
         for (auto const& lst : lists) {
             if (first) {
-                result = lst;           // copy first list
+                result.assign(lst.begin(), lst.end());   // copy first list
                 first = false;
             } else {
-                result = intersectTwo(result, lst);
+                intersectTwo(result, lst, scratch);
+                result.swap(scratch);
             }
             if (result.empty())        // early out if no common elements
                 break;
@@ -149,12 +497,109 @@ private:
         return result;
     }
 
-    // Intersect two sorted unique vectors in linear time
-    static std::vector<int> intersectTwo(
-        const std::vector<int>& a,
-        const std::vector<int>& b
+private:
+    // fn(name, tree) for every tree; names match the .idx files
+    template<typename Fn>
+    void forEachTree(Fn &&fn) {
+        fn("month",               monthTree);
+        fn("town",                townTree);
+        fn("flat_type",           flatTypeTree);
+        fn("block",               blockTree);
+        fn("street_name",         streetTree);
+        fn("storey_range",        storeyTree);
+        fn("floor_area",          floorAreaTree);
+        fn("flat_model",          modelTree);
+        fn("lease_commence_date", leaseDateTree);
+        fn("resale_price",        priceTree);
+        fn("town_month",          townMonthTree);
+    }
+
+    // A string column's hash index, and whether queries should use it
+    struct HashColumn {
+        HashIndex index;
+        bool      chosen = false;
+        bool usable() const { return chosen && index.ready(); }
+    };
+
+    // fn(name, hash) for every string column, in ColumnStore order
+    template<typename Fn>
+    void forEachHash(Fn &&fn) {
+        fn("month",        monthHash);
+        fn("town",         townHash);
+        fn("flat_type",    flatTypeHash);
+        fn("block",        blockHash);
+        fn("street_name",  streetHash);
+        fn("storey_range", storeyHash);
+        fn("flat_model",   modelHash);
+    }
+
+    // A numeric column's learned index, and whether queries should use it
+    template<typename K>
+    struct LearnedColumn {
+        LearnedIndex<K> index;
+        bool            chosen = false;
+        bool usable() const { return chosen && index.ready(); }
+    };
+
+    // fn(name, learned) for every numeric column; names match their trees
+    template<typename Fn>
+    void forEachLearned(Fn &&fn) {
+        fn("floor_area",          floorAreaModel);
+        fn("lease_commence_date", leaseDateModel);
+        fn("resale_price",        priceModel);
+    }
+
+    // fn(name, filter) for every Bloom filter; names match their trees
+    template<typename Fn>
+    void forEachBloom(Fn &&fn) {
+        fn("block",       blockBloom);
+        fn("street_name", streetBloom);
+    }
+
+    // String trees keep the first FIXED_STRING_LEN - 1 bytes of a key, so
+    // their filters hash the same prefix
+    static std::string_view indexedKey(std::string_view key) {
+        return key.substr(0, FIXED_STRING_LEN - 1);
+    }
+
+    static BloomFilter bloomOver(const Dictionary &dict) {
+        BloomFilter bloom(dict.cardinality());
+        for (uint32_t code = 0; code < dict.cardinality(); code++) bloom.add(indexedKey(dict.decode(code)));
+        return bloom;
+    }
+
+    // `ivs` without the point intervals [k, k] whose key `bloom` has never seen
+    static std::vector<Interval<std::string>> dropAbsentKeys(const BloomFilter &bloom,
+                                                             const std::vector<Interval<std::string>> &ivs,
+                                                             const char *column, ProfileNode *profile) {
+        std::vector<Interval<std::string>> kept;
+        kept.reserve(ivs.size());
+        size_t rejected = 0;
+        for (auto const &iv : ivs) {
+            bool point = iv.type == IntervalType::ClosedClosed && iv.start == iv.end;
+            if (point && !bloom.mightContain(indexedKey(iv.start))) {
+                rejected++;
+                continue;
+            }
+            if (point) EngineMetrics::get().bloomPassed.inc();
+            kept.push_back(iv);
+        }
+        EngineMetrics::get().bloomRejected.inc(rejected);
+        if (profile && rejected > 0) {
+            ProfileNode *node = profile->child(std::string("BloomFilter ") + column + " [" + std::to_string(rejected)
+                                               + " of " + std::to_string(ivs.size()) + " keys absent]");
+            node->rowsOut = 0;
+        }
+        return kept;
+    }
+
+    // Intersect two sorted unique lists into `out` in linear time
+    static void intersectTwo(
+        const RowIdList& a,
+        const RowIdList& b,
+        RowIdList& out
     ) {
-        std::vector<int> out;
+        out.clear();
         out.reserve(std::min(a.size(), b.size()));
         size_t i = 0, j = 0;
         while (i < a.size() && j < b.size()) {
@@ -165,7 +610,6 @@ private:
                 ++i; ++j;
             }
         }
-        return out;
     }
 
     // Your per‑attribute trees:
@@ -181,6 +625,26 @@ private:
     ModelTree     modelTree;
     LeaseDateTree leaseDateTree;
     PriceTree     priceTree;
+    TownMonthTree townMonthTree;
+    std::atomic<bool> townMonthUsable{ false };   // every indexed town and month fit their fields
+
+    // Equality pre-checks for the high-cardinality string columns
+    BloomFilter   blockBloom;
+    BloomFilter   streetBloom;
+
+    // In-memory equality indexes, built where chosen
+    HashColumn    monthHash;
+    HashColumn    townHash;
+    HashColumn    flatTypeHash;
+    HashColumn    blockHash;
+    HashColumn    streetHash;
+    HashColumn    storeyHash;
+    HashColumn    modelHash;
+
+    // In-memory learned indexes, built where chosen
+    LearnedColumn<double> floorAreaModel;
+    LearnedColumn<int>    leaseDateModel;
+    LearnedColumn<double> priceModel;
 };
 
 
@@ -0,0 +1,255 @@
+// LearnedIndex.hpp
+#pragma once
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <type_traits>
+#include "Interval.h"
+#include "Constants.h"
+#include "QueryArena.hpp"
+
+// In-memory index over one numeric column that stores a model instead of a
+// tree (a PGM-style piecewise-linear index). The column's values are kept
+// sorted, and a chain of line segments maps a value to its position in that
+// order, off by at most LEARNED_INDEX_EPSILON. A probe binary-searches the
+// segment start keys, evaluates one line and finishes with a binary search
+// over 2 * epsilon + 2 keys. A smooth column needs few segments, so the model
+// is a few KB where the tree is a file of nodes.
+//
+// When the column is stored in value order (the store is clustered on it),
+// a position is the row ID itself and no row IDs are kept.
+//
+// The sorted part is fixed at build(). Rows appended later go to an
+// unsorted tail that every search scans, until the next build folds them in.
+template<typename K>
+class LearnedIndex {
+    static_assert(std::is_arithmetic_v<K>, "LearnedIndex needs a numeric key");
+
+public:
+    // Filled by build() and not cleared since
+    bool ready() const { return _ready; }
+
+    // Index rows [0, rows), reading row i as valueAt(i)
+    template<typename ValueAt>
+    void build(size_t rows, ValueAt &&valueAt) {
+        // 1) Row IDs in value order; ties stay in row order, so a column that
+        //    is already sorted keeps the identity and needs no ID array
+        std::vector<int> order(rows);
+        std::iota(order.begin(), order.end(), 0);
+        bool sorted = true;
+        for (size_t i = 1; i < rows && sorted; i++) sorted = !(valueAt(i) < valueAt(i - 1));
+        if (!sorted) {
+            std::stable_sort(order.begin(), order.end(),
+                             [&](int a, int b) { return valueAt(size_t(a)) < valueAt(size_t(b)); });
+        }
+        std::vector<K> keys(rows);
+        for (size_t i = 0; i < rows; i++) keys[i] = valueAt(size_t(order[i]));
+
+        // 2) Fit the segments over the sorted keys
+        std::vector<double>  starts;
+        std::vector<Segment> segments;
+        fit(keys, starts, segments);
+
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _keys.swap(keys);
+        if (sorted) _rows.clear();
+        else        _rows.swap(order);
+        _starts.swap(starts);
+        _segments.swap(segments);
+        _tail.clear();
+        _ready = true;
+    }
+
+    void clear() {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _keys.clear();
+        _rows.clear();
+        _starts.clear();
+        _segments.clear();
+        _tail.clear();
+        _ready = false;
+    }
+
+    // One appended row
+    void insert(K key, int id) {
+        std::unique_lock<std::shared_mutex> lock(_mutex);
+        _tail.push_back({ key, id });
+    }
+
+    // Same contract as BPlusTree::searchIntervals: the ascending IDs of the
+    // rows inside any of `intervals`, or every row for none
+    RowIdList searchIntervals(const std::vector<Interval<K>> &intervals = {}) const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        RowIdList ids(QueryArena::current());
+        if (intervals.empty()) {
+            ids.resize(_keys.size() + _tail.size());
+            std::iota(ids.begin(), ids.end(), 0);
+            return ids;
+        }
+
+        // 1) One run of sorted positions per interval
+        for (auto const &iv : intervals) {
+            size_t from = 0, to = _keys.size();
+            switch (iv.type) {
+                case IntervalType::ClosedClosed: from = lowerBound(iv.start); to = upperBound(iv.end); break;
+                case IntervalType::ClosedOpen:   from = lowerBound(iv.start); to = lowerBound(iv.end); break;
+                case IntervalType::OpenClosed:   from = upperBound(iv.start); to = upperBound(iv.end); break;
+                case IntervalType::OpenOpen:     from = upperBound(iv.start); to = lowerBound(iv.end); break;
+                case IntervalType::UpToClosed:   to   = upperBound(iv.end);   break;
+                case IntervalType::UpToOpen:     to   = lowerBound(iv.end);   break;
+                case IntervalType::FromClosed:   from = lowerBound(iv.start); break;
+                case IntervalType::FromOpen:     from = upperBound(iv.start); break;
+            }
+            for (size_t p = from; p < to; p++) ids.push_back(_rows.empty() ? int(p) : _rows[p]);
+        }
+
+        // 2) Appended rows, one by one
+        for (auto const &entry : _tail) {
+            for (auto const &iv : intervals) {
+                if (contains(iv, entry.key)) {
+                    ids.push_back(entry.id);
+                    break;
+                }
+            }
+        }
+        const bool positional = _rows.empty();   // read before a build() may swap it
+        lock.unlock();
+
+        // 3) Positions follow the values, not the rows, and overlapping
+        //    intervals repeat rows; one interval over a clustered column is
+        //    in order already
+        if (!positional || intervals.size() > 1 || !std::is_sorted(ids.begin(), ids.end())) {
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+        return ids;
+    }
+
+    // Line segments in the model
+    size_t segments() const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _segments.size();
+    }
+    // Memory of the model alone, and of the whole index (sorted keys, row IDs
+    // and appended rows too)
+    size_t modelBytes() const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _starts.size() * sizeof(double) + _segments.size() * sizeof(Segment);
+    }
+    size_t bytes() const {
+        std::shared_lock<std::shared_mutex> lock(_mutex);
+        return _starts.size() * sizeof(double) + _segments.size() * sizeof(Segment)
+             + _keys.size() * sizeof(K) + _rows.size() * sizeof(int) + _tail.size() * sizeof(TailEntry);
+    }
+
+private:
+    // position(x) = base + slope * (x - its start key)
+    struct Segment {
+        double slope;
+        double base;
+    };
+    struct TailEntry {
+        K   key;
+        int id;
+    };
+
+    // Greedy shrinking cone over (key, first position of the key): a segment
+    // grows while one slope still keeps every distinct key it covers within
+    // epsilon of its first position, which yields the fewest segments a
+    // single left-to-right pass can find
+    static void fit(const std::vector<K> &keys, std::vector<double> &starts, std::vector<Segment> &segments) {
+        const double eps = double(LEARNED_INDEX_EPSILON);
+        const size_t n = keys.size();
+        auto nextKey = [&](size_t i) {
+            while (i + 1 < n && keys[i + 1] == keys[i]) i++;
+            return i + 1;
+        };
+        size_t i = 0;
+        while (i < n) {
+            const double x0 = double(keys[i]), y0 = double(i);
+            double lo = 0.0, hi = std::numeric_limits<double>::infinity();
+            size_t j = nextKey(i);
+            while (j < n) {
+                const double dx = double(keys[j]) - x0;
+                const double newLo = std::max(lo, (double(j) - eps - y0) / dx);
+                const double newHi = std::min(hi, (double(j) + eps - y0) / dx);
+                if (newLo > newHi) break;
+                lo = newLo;
+                hi = newHi;
+                j = nextKey(j);
+            }
+            starts.push_back(x0);
+            segments.push_back({ std::isinf(hi) ? 0.0 : (lo + hi) / 2, y0 });
+            i = j;
+        }
+    }
+
+    // Position of the first key >= x (lower) or > x (upper)
+    size_t locate(K x, bool upper) const {
+        const size_t n = _keys.size();
+        if (n == 0) return 0;
+        const K *keys = _keys.data();
+        auto before = [&](K key) { return upper ? !(x < key) : key < x; };   // key belongs before the answer
+
+        // 1) Model: the segment whose start key is the last one <= x
+        auto seg = std::upper_bound(_starts.begin(), _starts.end(), double(x));
+        if (seg == _starts.begin()) return 0;
+        size_t s = size_t(seg - _starts.begin()) - 1;
+        double guess = _segments[s].base + _segments[s].slope * (double(x) - _starts[s]);
+        size_t pos = size_t(std::clamp(guess, 0.0, double(n)));
+
+        // 2) Last mile inside the error window
+        size_t from = pos > LEARNED_INDEX_EPSILON + 1 ? pos - LEARNED_INDEX_EPSILON - 1 : 0;
+        size_t to   = std::min(n, pos + LEARNED_INDEX_EPSILON + 2);
+        auto bound = [&](size_t a, size_t b) {
+            return upper ? size_t(std::upper_bound(keys + a, keys + b, x) - keys)
+                         : size_t(std::lower_bound(keys + a, keys + b, x) - keys);
+        };
+        size_t at = bound(from, to);
+
+        // 3) The model only promises epsilon at the keys it was fitted on; an
+        //    x between two keys (or past a long run of one key) can land
+        //    outside the window, so gallop out from its edge
+        if (at == from && from > 0 && !before(keys[from - 1])) {
+            size_t step = 1;
+            while (step < from && !before(keys[from - step - 1])) step *= 2;
+            return bound(from > step ? from - step : 0, from);
+        }
+        if (at == to && to < n) {
+            size_t step = 1;
+            while (to + step < n && before(keys[to + step])) step *= 2;
+            return bound(to, std::min(n, to + step + 1));
+        }
+        return at;
+    }
+    size_t lowerBound(K x) const { return locate(x, false); }
+    size_t upperBound(K x) const { return locate(x, true); }
+
+    static bool contains(const Interval<K> &iv, K key) {
+        switch (iv.type) {
+            case IntervalType::ClosedClosed: return !(key < iv.start) && !(iv.end < key);
+            case IntervalType::ClosedOpen:   return !(key < iv.start) && key < iv.end;
+            case IntervalType::OpenClosed:   return iv.start < key && !(iv.end < key);
+            case IntervalType::OpenOpen:     return iv.start < key && key < iv.end;
+            case IntervalType::UpToClosed:   return !(iv.end < key);
+            case IntervalType::UpToOpen:     return key < iv.end;
+            case IntervalType::FromClosed:   return !(key < iv.start);
+            case IntervalType::FromOpen:     return iv.start < key;
+        }
+        return false;
+    }
+
+    mutable std::shared_mutex _mutex;
+    std::vector<K>            _keys;       // every indexed value, sorted
+    std::vector<int>          _rows;       // row ID at each position; empty = the position
+    std::vector<double>       _starts;     // first key of each segment
+    std::vector<Segment>      _segments;
+    std::vector<TailEntry>    _tail;       // appended since build()
+    std::atomic<bool>         _ready{ false };
+};
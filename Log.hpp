@@ -0,0 +1,137 @@
+// Log.hpp
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+// Compile-time filtered logging. A trace point whose level is above
+// HDB_LOG_LEVEL, or whose category is masked out of HDB_LOG_CATEGORIES, is
+// discarded by `if constexpr`, so its arguments are never even evaluated.
+//
+//   -DHDB_LOG_LEVEL=5          keep everything up to Trace
+//   -DHDB_LOG_CATEGORIES=0x1   only the Index category
+
+#ifndef HDB_LOG_LEVEL
+#define HDB_LOG_LEVEL 3          // Info
+#endif
+
+#ifndef HDB_LOG_CATEGORIES
+#define HDB_LOG_CATEGORIES 0xFFu
+#endif
+
+enum class LogLevel : int {
+    Off   = 0,
+    Error = 1,
+    Warn  = 2,
+    Info  = 3,
+    Debug = 4,
+    Trace = 5
+};
+
+enum class LogCategory : unsigned {
+    Index   = 1u << 0,   // B+ trees and IndexManager
+    Storage = 1u << 1,   // column files, DiskManager
+    Query   = 1u << 2,   // query execution
+    IO      = 1u << 3    // async I/O backends
+};
+
+namespace hdblog {
+
+constexpr bool enabled(LogLevel level, LogCategory category) {
+    return static_cast<int>(level) <= HDB_LOG_LEVEL
+        && (static_cast<unsigned>(category) & static_cast<unsigned>(HDB_LOG_CATEGORIES)) != 0;
+}
+
+inline const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Error: return "ERROR";
+        case LogLevel::Warn:  return "WARN";
+        case LogLevel::Info:  return "INFO";
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Trace: return "TRACE";
+        default:              return "";
+    }
+}
+
+inline const char* categoryName(LogCategory category) {
+    switch (category) {
+        case LogCategory::Index:   return "index";
+        case LogCategory::Storage: return "storage";
+        case LogCategory::Query:   return "query";
+        case LogCategory::IO:      return "io";
+    }
+    return "";
+}
+
+// One whole line per call, so lines from concurrent threads don't interleave
+inline void write(LogLevel level, LogCategory category, const std::string &message) {
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::clog << "[" << levelName(level) << "][" << categoryName(category) << "] " << message << '\n';
+}
+
+} // namespace hdblog
+
+// HDB_LOG(Debug, Index, "found " << n << " keys");
+#define HDB_LOG(level, category, expr)                                                  \
+    do {                                                                                \
+        if constexpr (hdblog::enabled(LogLevel::level, LogCategory::category)) {        \
+            std::ostringstream hdb_log_stream_;                                         \
+            hdb_log_stream_ << expr;                                                    \
+            hdblog::write(LogLevel::level, LogCategory::category, hdb_log_stream_.str()); \
+        }                                                                               \
+    } while (0)
+
+// Progress line for long loops, redrawn at most once per `interval`. update()
+// only looks at the clock every CHECK_STRIDE calls, so it is cheap enough to
+// call once per row.
+class ProgressReporter {
+public:
+    ProgressReporter(std::string label, size_t total,
+                     std::chrono::milliseconds interval = std::chrono::milliseconds(500),
+                     std::ostream &out = std::cout)
+        : _label(std::move(label))
+        , _total(total)
+        , _interval(interval)
+        , _out(out)
+        , _start(std::chrono::steady_clock::now())
+        , _last(_start)
+    {}
+
+    void update(size_t done) {
+        if (++_calls % CHECK_STRIDE != 0) return;
+        auto now = std::chrono::steady_clock::now();
+        if (now - _last < _interval) return;
+        _last = now;
+        draw(done, now);
+    }
+
+    // Final line (always printed)
+    void finish(size_t done) {
+        draw(done, std::chrono::steady_clock::now());
+        _out << '\n' << std::flush;
+    }
+
+private:
+    static constexpr uint64_t CHECK_STRIDE = 1024;
+
+    void draw(size_t done, std::chrono::steady_clock::time_point now) {
+        double secs = std::chrono::duration<double>(now - _start).count();
+        _out << '\r' << _label << ' ' << done << " / " << _total;
+        if (_total > 0) _out << " (" << (100 * done / _total) << "%)";
+        if (secs > 0) _out << ", " << uint64_t(double(done) / secs) << " rows/s";
+        _out << std::flush;
+    }
+
+    std::string _label;
+    size_t      _total;
+    std::chrono::milliseconds _interval;
+    std::ostream &_out;
+    std::chrono::steady_clock::time_point _start, _last;
+    uint64_t    _calls = 0;
+};
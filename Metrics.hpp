@@ -0,0 +1,329 @@
+// Metrics.hpp
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <functional>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Process-wide metrics: striped counters that threads bump without sharing a
+// cache line, and log-linear (HDR-style) latency histograms. The registry
+// renders everything in Prometheus text format, to a file or over a socket.
+
+// Monotonic counter. Each thread adds into one of STRIPES padded slots, so
+// concurrent increments don't contend; value() sums the slots.
+class Counter {
+public:
+    void inc(uint64_t n = 1) {
+        _slots[stripe()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const {
+        uint64_t total = 0;
+        for (auto const &s : _slots) total += s.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    static constexpr size_t STRIPES = 16;
+    struct alignas(64) Slot { std::atomic<uint64_t> value{0}; };
+
+    static size_t stripe() {
+        thread_local size_t s = std::hash<std::thread::id>{}(std::this_thread::get_id()) % STRIPES;
+        return s;
+    }
+
+    Slot _slots[STRIPES];
+};
+
+// Latency histogram over nanoseconds with SUB_BUCKETS linear buckets per
+// power of two (values below SUB_BUCKETS are exact), so any recorded value
+// is known to within 1/SUB_BUCKETS (~6%) across the whole 64-bit range.
+class Histogram {
+public:
+    static constexpr int SUB_BITS    = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int NUM_BUCKETS = SUB_BUCKETS + (64 - SUB_BITS) * SUB_BUCKETS;
+
+    void record(uint64_t ns) {
+        _buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t sum()   const { return _sum.load(std::memory_order_relaxed); }
+
+    // Upper edge (ns) of the bucket holding the q-quantile; 0 when empty
+    uint64_t quantile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = uint64_t(q * double(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < NUM_BUCKETS; b++) {
+            seen += _buckets[b].load(std::memory_order_relaxed);
+            if (seen >= rank) return bucketUpper(b);
+        }
+        return bucketUpper(NUM_BUCKETS - 1);
+    }
+
+    static int bucketFor(uint64_t v) {
+        if (v < uint64_t(SUB_BUCKETS)) return int(v);
+        int e = 63 - __builtin_clzll(v);                  // >= SUB_BITS
+        int mantissa = int(v >> (e - SUB_BITS)) - SUB_BUCKETS;
+        return SUB_BUCKETS + (e - SUB_BITS) * SUB_BUCKETS + mantissa;
+    }
+
+    static uint64_t bucketUpper(int b) {
+        if (b < SUB_BUCKETS) return uint64_t(b);
+        int e = (b - SUB_BUCKETS) / SUB_BUCKETS + SUB_BITS;
+        int mantissa = (b - SUB_BUCKETS) % SUB_BUCKETS;
+        uint64_t width = uint64_t(1) << (e - SUB_BITS);
+        return (uint64_t(SUB_BUCKETS + mantissa) << (e - SUB_BITS)) + (width - 1);
+    }
+
+private:
+    std::atomic<uint64_t> _buckets[NUM_BUCKETS] = {};
+    std::atomic<uint64_t> _count{0};
+    std::atomic<uint64_t> _sum{0};
+};
+
+// Named metric families with optional labels. counter()/histogram() return
+// stable references, so hot paths look a metric up once and keep it.
+class MetricsRegistry {
+public:
+    static MetricsRegistry& shared() {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    // labels in Prometheus form without braces, e.g. `kind="leaf"`
+    Counter& counter(const std::string &name, const std::string &help, const std::string &labels = "") {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Family &f = family(name, help, "counter");
+        auto &slot = f.counters[labels];
+        if (!slot) slot = std::make_unique<Counter>();
+        return *slot;
+    }
+
+    Histogram& histogram(const std::string &name, const std::string &help, const std::string &labels = "") {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Family &f = family(name, help, "summary");
+        auto &slot = f.histograms[labels];
+        if (!slot) slot = std::make_unique<Histogram>();
+        return *slot;
+    }
+
+    // Prometheus text exposition format (0.0.4). Histograms are exported as
+    // summaries: p50/p90/p99/p999 plus _sum and _count, in seconds.
+    std::string renderPrometheus() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::ostringstream out;
+        for (auto const &kv : _families) {
+            const std::string &name = kv.first;
+            const Family &f = kv.second;
+            out << "# HELP " << name << " " << f.help << "\n"
+                << "# TYPE " << name << " " << f.type << "\n";
+            for (auto const &c : f.counters) {
+                out << name << braces(c.first) << " " << c.second->value() << "\n";
+            }
+            for (auto const &h : f.histograms) {
+                static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+                for (double q : quantiles) {
+                    std::ostringstream label;
+                    label << h.first << (h.first.empty() ? "" : ",") << "quantile=\"" << q << "\"";
+                    out << name << braces(label.str()) << " " << seconds(h.second->quantile(q)) << "\n";
+                }
+                out << name << "_sum"   << braces(h.first) << " " << seconds(h.second->sum()) << "\n";
+                out << name << "_count" << braces(h.first) << " " << h.second->count() << "\n";
+            }
+        }
+        return out.str();
+    }
+
+    // Write the dump next to `path` and rename it over, so readers never see
+    // a partial file
+    bool dumpToFile(const std::string &path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out) {
+                std::cerr << "Failed to open " << tmp << std::endl;
+                return false;
+            }
+            out << renderPrometheus();
+            if (!out) return false;
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::cerr << "Failed to rename " << tmp << " to " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Family {
+        std::string help, type;
+        std::map<std::string, std::unique_ptr<Counter>>   counters;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    };
+
+    Family& family(const std::string &name, const std::string &help, const char *type) {
+        Family &f = _families[name];
+        if (f.type.empty()) {
+            f.help = help;
+            f.type = type;
+        }
+        return f;
+    }
+
+    static std::string braces(const std::string &labels) {
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+    static std::string seconds(uint64_t ns) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.9g", double(ns) * 1e-9);
+        return buf;
+    }
+
+    mutable std::mutex             _mutex;
+    std::map<std::string, Family>  _families;
+};
+
+// The engine's own metrics, registered once
+struct EngineMetrics {
+    Counter &nodeReads;
+    Counter &nodeWrites;
+    Counter &nodeCacheHits;
+    Counter &nodeVisits;
+    Counter &leafSplits;
+    Counter &internalSplits;
+    Counter &olcRestarts;
+    Counter &blockReads;
+    Counter &blockBytesRead;
+    Counter &rowsScannedIndex;
+    Counter &rowsScannedColumn;
+    Counter &rowsReturned;
+    Counter &checksumFailures;
+    Counter &scrubbedBlocks;
+    Counter &bloomPassed;
+    Counter &bloomRejected;
+    Counter &hashLookups;
+    Counter &learnedProbes;
+
+    static EngineMetrics& get() {
+        static EngineMetrics m(MetricsRegistry::shared());
+        return m;
+    }
+
+    // End-to-end latency of one query category, e.g. "AVG(Price)"
+    static Histogram& queryLatency(const std::string &category) {
+        return MetricsRegistry::shared().histogram(
+            "hdb_query_duration_seconds", "Query latency by category",
+            "category=\"" + category + "\"");
+    }
+
+private:
+    explicit EngineMetrics(MetricsRegistry &r)
+        : nodeReads(r.counter("hdb_disk_node_reads_total", "B+ tree nodes read from disk"))
+        , nodeWrites(r.counter("hdb_disk_node_writes_total", "B+ tree nodes written to disk"))
+        , nodeCacheHits(r.counter("hdb_disk_node_cache_hits_total", "B+ tree node reads served by the node cache"))
+        , nodeVisits(r.counter("hdb_bptree_node_visits_total", "B+ tree nodes visited by searches and inserts"))
+        , leafSplits(r.counter("hdb_bptree_splits_total", "B+ tree node splits", "kind=\"leaf\""))
+        , internalSplits(r.counter("hdb_bptree_splits_total", "B+ tree node splits", "kind=\"internal\""))
+        , olcRestarts(r.counter("hdb_bptree_olc_restarts_total", "Concurrent B+ tree insert descents restarted by a split or version conflict"))
+        , blockReads(r.counter("hdb_column_block_reads_total", "Column file blocks read"))
+        , blockBytesRead(r.counter("hdb_column_bytes_read_total", "Column file bytes read"))
+        , rowsScannedIndex(r.counter("hdb_rows_scanned_total", "Rows examined by queries", "source=\"index\""))
+        , rowsScannedColumn(r.counter("hdb_rows_scanned_total", "Rows examined by queries", "source=\"column\""))
+        , rowsReturned(r.counter("hdb_rows_returned_total", "Rows returned by queries"))
+        , checksumFailures(r.counter("hdb_checksum_failures_total", "Column blocks, snapshot sections and tree nodes that failed their checksum"))
+        , scrubbedBlocks(r.counter("hdb_scrub_blocks_total", "Column file blocks checked by the background scrub"))
+        , bloomPassed(r.counter("hdb_bloom_probes_total", "Equality keys checked against an index Bloom filter", "result=\"maybe\""))
+        , bloomRejected(r.counter("hdb_bloom_probes_total", "Equality keys checked against an index Bloom filter", "result=\"absent\""))
+        , hashLookups(r.counter("hdb_hash_index_lookups_total", "Equality keys answered by an in-memory hash index"))
+        , learnedProbes(r.counter("hdb_learned_index_probes_total", "Intervals answered by a learned index"))
+    {}
+};
+
+// Serves the Prometheus dump over HTTP on 127.0.0.1:port from a background
+// thread, so a scraper (or curl) can pull it while the engine runs.
+class MetricsServer {
+public:
+    explicit MetricsServer(uint16_t port) {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (_fd < 0) return;
+        int one = 1;
+        ::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(_fd, 8) != 0) {
+            std::cerr << "Metrics: cannot listen on 127.0.0.1:" << port << ": " << std::strerror(errno) << std::endl;
+            ::close(_fd);
+            _fd = -1;
+            return;
+        }
+        _thread = std::thread([this] { serve(); });
+    }
+
+    ~MetricsServer() {
+        _stopping = true;
+        if (_thread.joinable()) _thread.join();
+        if (_fd >= 0) ::close(_fd);
+    }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool listening() const { return _fd >= 0; }
+
+private:
+    void serve() {
+        while (!_stopping) {
+            pollfd p{ _fd, POLLIN, 0 };
+            if (::poll(&p, 1, 200) <= 0) continue;    // wake up regularly to notice shutdown
+            int client = ::accept(_fd, nullptr, nullptr);
+            if (client < 0) continue;
+
+            // read (and ignore) the request line/headers, then answer any path
+            char request[1024];
+            pollfd c{ client, POLLIN, 0 };
+            if (::poll(&c, 1, 1000) > 0) (void)::recv(client, request, sizeof(request), 0);
+
+            std::string body = MetricsRegistry::shared().renderPrometheus();
+            std::string response = "HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t w = ::send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (w <= 0) break;
+                sent += size_t(w);
+            }
+            ::close(client);
+        }
+    }
+
+    int               _fd = -1;
+    std::thread       _thread;
+    std::atomic<bool> _stopping{false};
+};
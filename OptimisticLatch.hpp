@@ -0,0 +1,84 @@
+// OptimisticLatch.hpp
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Version latch for optimistic lock coupling. Readers never write to it:
+// they note the version, read the node, and validate that the version did
+// not move (otherwise they restart). Writers take the latch by bumping the
+// version to odd with a CAS from a version they validated, and release it by
+// bumping again, so every modification is visible to readers as a change.
+class OptimisticLatch {
+public:
+    // Wait out a writer; returns the version to validate against
+    uint64_t readLock() const {
+        uint64_t v;
+        for (int spins = 0; (v = _version.load(std::memory_order_acquire)) & LOCKED; spins++) {
+            if (spins >= SPIN_LIMIT) std::this_thread::yield();
+        }
+        return v;
+    }
+
+    // Nothing was written since `v` was read
+    bool validate(uint64_t v) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _version.load(std::memory_order_relaxed) == v;
+    }
+
+    // Take the latch iff nothing was written since `v`
+    bool upgrade(uint64_t v) {
+        return _version.compare_exchange_strong(v, v + LOCKED, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        _version.fetch_add(LOCKED, std::memory_order_release);
+    }
+
+private:
+    static constexpr uint64_t LOCKED = 1;
+    static constexpr int SPIN_LIMIT = 64;
+
+    std::atomic<uint64_t> _version{0};
+};
+
+// One latch per BLOCK_SIZE slot of a node file. Node offsets are ints, so
+// there are at most 2^31 / blockSize slots; latches are allocated a chunk at
+// a time on first use and never move, so lookups need no lock.
+template<size_t BlockSize>
+class NodeLatchTable {
+public:
+    NodeLatchTable() {
+        for (auto &c : _chunks) c.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~NodeLatchTable() {
+        for (auto &c : _chunks) delete[] c.load(std::memory_order_relaxed);
+    }
+
+    NodeLatchTable(const NodeLatchTable&) = delete;
+    NodeLatchTable& operator=(const NodeLatchTable&) = delete;
+
+    OptimisticLatch& at(int offset) {
+        size_t slot = size_t(offset) / BlockSize;
+        std::atomic<OptimisticLatch*> &chunk = _chunks[slot / CHUNK];
+        OptimisticLatch *latches = chunk.load(std::memory_order_acquire);
+        if (!latches) {
+            auto fresh = std::make_unique<OptimisticLatch[]>(CHUNK);
+            if (chunk.compare_exchange_strong(latches, fresh.get(), std::memory_order_acq_rel)) {
+                latches = fresh.release();
+            }   // else another thread won; `latches` now holds its chunk
+        }
+        return latches[slot % CHUNK];
+    }
+
+private:
+    static constexpr size_t CHUNK      = 4096;
+    static constexpr size_t MAX_SLOTS  = (size_t(1) << 31) / BlockSize;
+    static constexpr size_t MAX_CHUNKS = (MAX_SLOTS + CHUNK - 1) / CHUNK;
+
+    std::atomic<OptimisticLatch*> _chunks[MAX_CHUNKS];
+};
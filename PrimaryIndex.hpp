@@ -0,0 +1,149 @@
+// PrimaryIndex.hpp
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+#include "Constants.h"
+
+// Sparse primary index over a store whose rows are physically sorted by one or
+// more string key columns. It keeps the key of the first row of every granule
+// (PRIMARY_INDEX_GRANULE rows, a whole number of blocks in every column file),
+// so a key range maps to one contiguous run of blocks.
+class PrimaryIndex {
+public:
+    using Key = std::vector<std::string>;
+
+    PrimaryIndex() : _granule(PRIMARY_INDEX_GRANULE), _rowCount(0) {}
+
+    // keyColumns: names of the sort columns; keyData: their (already sorted) values
+    static PrimaryIndex build(const std::vector<std::string> &keyColumns,
+                              const std::vector<const std::vector<std::string>*> &keyData,
+                              size_t rowCount)
+    {
+        PrimaryIndex idx;
+        idx._keyColumns = keyColumns;
+        idx._rowCount   = rowCount;
+        for (size_t row = 0; row < rowCount; row += idx._granule) {
+            Key first;
+            first.reserve(keyData.size());
+            for (auto *col : keyData) first.push_back((*col)[row]);
+            idx._firstKeys.push_back(std::move(first));
+        }
+        return idx;
+    }
+
+    bool empty() const { return _keyColumns.empty(); }
+    void clear() { _keyColumns.clear(); _firstKeys.clear(); _rowCount = 0; }
+    const std::vector<std::string>& keyColumns() const { return _keyColumns; }
+    size_t rowCount() const { return _rowCount; }
+
+    // Candidate rows [begin, end) for all keys whose prefix lies in [lo, hi].
+    // lo and hi may be shorter than the full key (e.g. month only).
+    // The range is granule-aligned, so callers still filter the edge granules.
+    std::pair<size_t, size_t> lookup(const Key &lo, const Key &hi) const {
+        if (_firstKeys.empty()) return {0, 0};
+
+        // first granule starting at or after lo; rows equal to lo may start one earlier
+        auto first = std::lower_bound(_firstKeys.begin(), _firstKeys.end(), lo,
+            [&](const Key &k, const Key &v) { return comparePrefix(k, v) < 0; });
+        size_t beginGranule = size_t(first - _firstKeys.begin());
+        if (beginGranule > 0) beginGranule--;
+
+        // first granule starting strictly after hi
+        auto last = std::upper_bound(_firstKeys.begin(), _firstKeys.end(), hi,
+            [&](const Key &v, const Key &k) { return comparePrefix(k, v) > 0; });
+        size_t endGranule = size_t(last - _firstKeys.begin());
+
+        size_t begin = beginGranule * _granule;
+        size_t end   = std::min(endGranule * _granule, _rowCount);
+        if (begin >= end) return {0, 0};
+        return {begin, end};
+    }
+
+    // Compare the first prefix.size() fields of key against prefix
+    static int comparePrefix(const Key &key, const Key &prefix) {
+        size_t len = std::min(key.size(), prefix.size());
+        for (size_t i = 0; i < len; i++) {
+            int c = key[i].compare(prefix[i]);
+            if (c != 0) return c < 0 ? -1 : 1;
+        }
+        return 0;
+    }
+
+    // Layout: [numKeys][granule][rowCount][numEntries], key names, then entries,
+    // every string in a FIXED_STRING_LEN slot like the column files.
+    // Returns false if the file could not be created or written in full
+    bool storeToDisk(const std::string &path) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        write(file);
+        file.close();
+        return static_cast<bool>(file);
+    }
+
+    // Returns false (and leaves the index empty) if the file is missing or short
+    bool loadFromDisk(const std::string &path) {
+        clear();
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        return read(file);
+    }
+
+    // The same layout on any stream (the snapshot embeds it)
+    void write(std::ostream &file) const {
+        size_t header[4] = { _keyColumns.size(), _granule, _rowCount, _firstKeys.size() };
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (auto const &name : _keyColumns) writeFixed(file, name);
+        for (auto const &key : _firstKeys) {
+            for (auto const &field : key) writeFixed(file, field);
+        }
+    }
+
+    bool read(std::istream &file) {
+        clear();
+        size_t header[4] = {0, 0, 0, 0};
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (file.gcount() != sizeof(header) || header[0] == 0 || header[1] == 0) return false;
+
+        std::vector<std::string> names(header[0]);
+        for (auto &name : names) {
+            if (!readFixed(file, name)) return false;
+        }
+        std::vector<Key> firstKeys(header[3], Key(header[0]));
+        for (auto &key : firstKeys) {
+            for (auto &field : key) {
+                if (!readFixed(file, field)) return false;
+            }
+        }
+
+        _keyColumns = std::move(names);
+        _granule    = header[1];
+        _rowCount   = header[2];
+        _firstKeys  = std::move(firstKeys);
+        return true;
+    }
+
+private:
+    static void writeFixed(std::ostream &file, const std::string &s) {
+        char buffer[FIXED_STRING_LEN] = {0};
+        std::memcpy(buffer, s.data(), std::min(s.size(), FIXED_STRING_LEN - 1));
+        file.write(buffer, FIXED_STRING_LEN);
+    }
+
+    static bool readFixed(std::istream &file, std::string &s) {
+        char buffer[FIXED_STRING_LEN];
+        file.read(buffer, FIXED_STRING_LEN);
+        if (file.gcount() != std::streamsize(FIXED_STRING_LEN)) return false;
+        s.assign(buffer, strnlen(buffer, FIXED_STRING_LEN));
+        return true;
+    }
+
+    std::vector<std::string> _keyColumns;
+    size_t _granule;
+    size_t _rowCount;
+    std::vector<Key> _firstKeys;   // key of the first row in each granule
+};
@@ -0,0 +1,128 @@
+// QueryArena.hpp
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "Metrics.hpp"
+
+// Monotonic memory for the intermediates of one query: row-ID lists, scan
+// buffers, hash tables, fetched rows. Allocation bumps a pointer through a
+// list of blocks, deallocation does nothing, and reset() rewinds to the first
+// block in one step when the query ends. Blocks are kept, so once the arena
+// has grown to a query's high-water mark, later queries of that shape make
+// no malloc calls at all.
+//
+// Query code does not take an arena parameter: it builds its containers on
+// QueryArena::current(), the arena a Scope bound to this thread (TaskGroup
+// carries the binding over to its tasks), or the default heap outside one.
+class QueryArena : public std::pmr::memory_resource {
+public:
+    explicit QueryArena(size_t firstBlock = FIRST_BLOCK) : _nextBlock(firstBlock) {}
+
+    ~QueryArena() override {
+        for (auto &b : _blocks) std::pmr::new_delete_resource()->deallocate(b.data, b.size, BLOCK_ALIGN);
+    }
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    // Forget every allocation; whatever was built on the arena is gone
+    void reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &b : _blocks) b.used = 0;
+        _current = 0;
+    }
+
+    size_t bytesReserved() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t total = 0;
+        for (auto const &b : _blocks) total += b.size;
+        return total;
+    }
+
+    // Resource to build query intermediates on
+    static std::pmr::memory_resource* current() {
+        std::pmr::memory_resource *r = bound();
+        return r ? r : std::pmr::get_default_resource();
+    }
+
+    // Binds a resource to this thread for the lifetime of the object
+    class Bind {
+    public:
+        explicit Bind(std::pmr::memory_resource *resource) : _previous(bound()) { bound() = resource; }
+        ~Bind() { bound() = _previous; }
+        Bind(const Bind&) = delete;
+        Bind& operator=(const Bind&) = delete;
+    private:
+        std::pmr::memory_resource *_previous;
+    };
+
+    // One query: binds the arena, and resets it on the way out. Nothing
+    // built inside may outlive the scope.
+    class Scope {
+    public:
+        explicit Scope(QueryArena &arena) : _arena(arena), _bind(&arena) {}
+        ~Scope() { _arena.reset(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        QueryArena &_arena;
+        Bind        _bind;
+    };
+
+private:
+    static constexpr size_t FIRST_BLOCK = 64 * 1024;
+    static constexpr size_t BLOCK_ALIGN = 64;
+
+    struct Block { char *data; size_t size; size_t used; };
+
+    static std::pmr::memory_resource*& bound() {
+        thread_local std::pmr::memory_resource *resource = nullptr;
+        return resource;
+    }
+
+    // Tasks of one query may allocate from several threads at once
+    void* do_allocate(size_t bytes, size_t align) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (; _current < _blocks.size(); _current++) {
+            Block &b = _blocks[_current];
+            uintptr_t base  = reinterpret_cast<uintptr_t>(b.data);
+            uintptr_t start = (base + b.used + align - 1) & ~uintptr_t(align - 1);
+            if (start + bytes <= base + b.size) {
+                b.used = start + bytes - base;
+                return reinterpret_cast<void*>(start);
+            }
+        }
+        // Out of blocks: add one at least twice the last, kept from now on
+        size_t size = std::max(_nextBlock, bytes + align);
+        _nextBlock = size * 2;
+        char *data = static_cast<char*>(std::pmr::new_delete_resource()->allocate(size, BLOCK_ALIGN));
+        _blocks.push_back({ data, size, 0 });
+        _current = _blocks.size() - 1;
+        _blockAllocs.inc();
+        uintptr_t base  = reinterpret_cast<uintptr_t>(data);
+        uintptr_t start = (base + align - 1) & ~uintptr_t(align - 1);
+        _blocks.back().used = start + bytes - base;
+        return reinterpret_cast<void*>(start);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    mutable std::mutex _mutex;
+    std::vector<Block> _blocks;
+    size_t _current = 0;
+    size_t _nextBlock;
+
+    Counter &_blockAllocs = MetricsRegistry::shared().counter("hdb_query_arena_blocks_total", "Blocks query arenas took from the heap");
+};
+
+// Row IDs as every query stage passes them around
+using RowIdList = std::pmr::vector<int>;
@@ -0,0 +1,120 @@
+// QueryProfile.hpp
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+
+// I/O done on behalf of one operator
+struct IoStats {
+    uint64_t nodeReads  = 0;   // B+ tree nodes read from disk
+    uint64_t bufferHits = 0;   // B+ tree nodes served from the node cache
+    uint64_t blockReads = 0;   // column blocks read
+    uint64_t bytesRead  = 0;
+
+    IoStats& operator+=(const IoStats &o) {
+        nodeReads  += o.nodeReads;
+        bufferHits += o.bufferHits;
+        blockReads += o.blockReads;
+        bytesRead  += o.bytesRead;
+        return *this;
+    }
+};
+
+// Where the storage layer records I/O for the operator running on this
+// thread; nullptr when nobody is profiling.
+inline IoStats*& currentIoStats() {
+    thread_local IoStats *sink = nullptr;
+    return sink;
+}
+
+// One operator in a query plan, with what it cost
+struct ProfileNode {
+    std::string name;
+    double      ms = 0.0;
+    size_t      rowsIn = 0;
+    size_t      rowsOut = 0;
+    IoStats     io;
+    std::vector<std::unique_ptr<ProfileNode>> children;
+
+    explicit ProfileNode(std::string n = "") : name(std::move(n)) {}
+
+    // Append a child operator. Not thread-safe: create children before fanning out.
+    ProfileNode* child(const std::string &childName) {
+        children.push_back(std::make_unique<ProfileNode>(childName));
+        return children.back().get();
+    }
+
+    // I/O of this operator and everything below it
+    IoStats totalIo() const {
+        IoStats t = io;
+        for (auto const &c : children) t += c->totalIo();
+        return t;
+    }
+};
+
+// Times a scope into a ProfileNode and routes this thread's I/O counters to
+// it. A null node makes the scope a no-op.
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileNode *node) : _node(node) {
+        if (!_node) return;
+        _prevSink = currentIoStats();
+        currentIoStats() = &_node->io;
+        _start = std::chrono::steady_clock::now();
+    }
+    ~ProfileScope() { finish(); }
+
+    // End the scope early (e.g. before printing results); idempotent
+    void finish() {
+        if (!_node) return;
+        _node->ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+        currentIoStats() = _prevSink;
+        _node = nullptr;
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ProfileNode *_node;
+    IoStats     *_prevSink = nullptr;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// Per-query operator tree, printable as EXPLAIN ANALYZE
+class QueryProfile {
+public:
+    explicit QueryProfile(const std::string &query = "Query") : _root(query) {}
+
+    ProfileNode* root() { return &_root; }
+    const ProfileNode& root() const { return _root; }
+
+    std::string explainAnalyze() const {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3);
+        out << "EXPLAIN ANALYZE (total " << _root.ms << " ms)\n";
+        print(out, _root, 0);
+        return out.str();
+    }
+
+private:
+    static void print(std::ostringstream &out, const ProfileNode &node, int depth) {
+        IoStats io = node.totalIo();
+        out << std::string(size_t(depth) * 3, ' ') << "-> " << node.name
+            << "  (time=" << node.ms << " ms";
+        if (node.rowsIn)     out << " rows_in=" << node.rowsIn;
+        out << " rows=" << node.rowsOut;
+        if (io.nodeReads || io.bufferHits) out << " node_reads=" << io.nodeReads << " buffer_hits=" << io.bufferHits;
+        if (io.blockReads) out << " blocks=" << io.blockReads;
+        if (io.bytesRead)  out << " bytes=" << io.bytesRead;
+        out << ")\n";
+        for (auto const &c : node.children) print(out, *c, depth + 1);
+    }
+
+    ProfileNode _root;
+};
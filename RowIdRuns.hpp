@@ -0,0 +1,94 @@
+// RowIdRuns.hpp
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include "QueryArena.hpp"
+
+// Collects row IDs as a B+ tree range scan emits them (key order) and hands
+// them back in row-ID order without a full sort. Duplicates of one key sit in
+// the leaves in insertion order, i.e. ascending row ID, so the scan output is
+// a sequence of ascending runs; a new run starts wherever the ID drops.
+// finish() merges the runs with a heap, or through a bitmap when the IDs are
+// dense enough that walking the bitmap is cheaper. Everything it allocates,
+// the result included, comes from the query arena.
+class RowIdRuns {
+public:
+    RowIdRuns() : _ids(QueryArena::current()), _runStarts(QueryArena::current()) {}
+
+    void reserve(size_t n) { _ids.reserve(n); }
+
+    void add(int id) {
+        if (_ids.empty() || id < _ids.back()) _runStarts.push_back(_ids.size());
+        if (id > _maxId) _maxId = id;
+        _ids.push_back(id);
+    }
+
+    size_t size() const { return _ids.size(); }
+
+    // All IDs, ascending. Leaves the collector empty.
+    RowIdList finish() {
+        RowIdList out(_ids.get_allocator());
+        if (_runStarts.size() <= 1) {
+            out.swap(_ids);
+        } else if (_ids.size() * BITMAP_DENSITY >= size_t(_maxId) + 1) {
+            out = viaBitmap();
+        } else {
+            out = viaHeap();
+        }
+        _ids.clear();
+        _runStarts.clear();
+        _maxId = -1;
+        return out;
+    }
+
+private:
+    // Use the bitmap when at least one in BITMAP_DENSITY of [0, maxId] is set
+    static constexpr size_t BITMAP_DENSITY = 32;
+
+    RowIdList viaBitmap() const {
+        std::pmr::vector<uint64_t> bits(size_t(_maxId) / 64 + 1, 0, _ids.get_allocator());
+        for (int id : _ids) {
+            if (id >= 0) bits[size_t(id) / 64] |= uint64_t(1) << (id % 64);
+        }
+        RowIdList out(_ids.get_allocator());
+        out.reserve(_ids.size());
+        for (size_t w = 0; w < bits.size(); w++) {
+            for (uint64_t word = bits[w]; word; word &= word - 1) {
+                out.push_back(int(w * 64 + size_t(__builtin_ctzll(word))));
+            }
+        }
+        return out;
+    }
+
+    RowIdList viaHeap() const {
+        // (next ID, run) min-heap; each run's cursor advances as it is popped
+        using Head = std::pair<int, size_t>;
+        using Heap = std::priority_queue<Head, std::pmr::vector<Head>, std::greater<Head>>;
+        Heap heap(std::greater<Head>{}, std::pmr::vector<Head>(_ids.get_allocator()));
+        std::pmr::vector<size_t> cursor(_runStarts, _ids.get_allocator());
+        std::pmr::vector<size_t> runEnd(_runStarts.size(), _ids.get_allocator());
+        for (size_t r = 0; r < _runStarts.size(); r++) {
+            runEnd[r] = r + 1 < _runStarts.size() ? _runStarts[r + 1] : _ids.size();
+            heap.emplace(_ids[cursor[r]], r);
+        }
+
+        RowIdList out(_ids.get_allocator());
+        out.reserve(_ids.size());
+        while (!heap.empty()) {
+            auto [id, r] = heap.top();
+            heap.pop();
+            out.push_back(id);
+            if (++cursor[r] < runEnd[r]) heap.emplace(_ids[cursor[r]], r);
+        }
+        return out;
+    }
+
+    RowIdList                _ids;
+    std::pmr::vector<size_t> _runStarts;
+    int                 _maxId = -1;
+};
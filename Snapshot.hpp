@@ -0,0 +1,257 @@
+// Snapshot.hpp
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <system_error>
+#include <filesystem>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "WriteAheadLog.hpp"   // crc32c, syncPath
+
+// Single-file image of the whole store: columns, dictionaries, the primary
+// index and every B+ tree, so a restart maps one file instead of loading
+// ten column files and rebuilding the indexes.
+//
+// Layout: page 0 holds the header, then come the sections, then the table
+// of contents. Every section starts on a PAGE_SIZE boundary, so a node image
+// inside it can be read in place. The header has a CRC-32C over itself and
+// the TOC, and each TOC entry has one over its section.
+//
+//   [magic "HDBSNAP1"][u32 version][u32 sections][u32 tocCrc][u32 0][u64 tocOffset]
+//   ... pages of section data ... [TocEntry x sections]
+namespace snapshot_format {
+    constexpr char     MAGIC[8]  = { 'H', 'D', 'B', 'S', 'N', 'A', 'P', '1' };
+    constexpr uint32_t VERSION   = 1;
+    constexpr size_t   PAGE_SIZE = 4096;
+    constexpr size_t   NAME_LEN  = 40;
+
+    struct Header {
+        char     magic[8];
+        uint32_t version;
+        uint32_t sections;
+        uint32_t tocCrc;      // over the header (with this field zero) and the TOC
+        uint32_t reserved;
+        uint64_t tocOffset;
+    };
+
+    struct TocEntry {
+        char     name[NAME_LEN];   // NUL-padded
+        uint64_t offset;
+        uint64_t length;
+        uint32_t crc;              // CRC-32C of the section's bytes
+        uint32_t reserved;
+    };
+}
+
+// Builds a snapshot in `<path>.tmp` a section at a time. commit() writes the
+// TOC and header, fsyncs, and renames it over `path`, so a reader sees either the
+// previous snapshot or the complete new one.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string &path)
+        : _path(path), _out(path + ".tmp", std::ios::binary | std::ios::trunc) {
+        if (!_out) {
+            std::cerr << "Error: Could not create snapshot: " << path << ".tmp" << std::endl;
+            return;
+        }
+        // page 0 is filled in by commit()
+        std::string zeros(snapshot_format::PAGE_SIZE, '\0');
+        _out.write(zeros.data(), std::streamsize(zeros.size()));
+        _offset = zeros.size();
+    }
+
+    // A writer dropped before commit() leaves no file behind
+    ~SnapshotWriter() {
+        if (_committed) return;
+        _out.close();
+        std::error_code ec;
+        std::filesystem::remove(_path + ".tmp", ec);
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    bool ok() const { return bool(_out); }
+
+    void beginSection(const std::string &name) {
+        padToPage();
+        snapshot_format::TocEntry entry{};
+        std::memcpy(entry.name, name.data(), std::min(name.size(), snapshot_format::NAME_LEN - 1));
+        entry.offset = _offset;
+        _toc.push_back(entry);
+        _crc = 0;
+    }
+
+    void append(const void *data, size_t n) {
+        _out.write(static_cast<const char*>(data), std::streamsize(n));
+        _offset += n;
+        _crc = WriteAheadLog::crc32c(_crc, data, n);
+    }
+
+    void endSection() {
+        _toc.back().length = _offset - _toc.back().offset;
+        _toc.back().crc    = _crc;
+    }
+
+    void section(const std::string &name, const void *data, size_t n) {
+        beginSection(name);
+        append(data, n);
+        endSection();
+    }
+
+    bool commit() {
+        padToPage();
+        using namespace snapshot_format;
+        Header header{};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version   = VERSION;
+        header.sections  = uint32_t(_toc.size());
+        header.tocOffset = _offset;
+        header.tocCrc    = tocCrc(header, _toc.data());
+        _out.write(reinterpret_cast<const char*>(_toc.data()), std::streamsize(_toc.size() * sizeof(TocEntry)));
+        _out.seekp(0);
+        _out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        _out.close();
+
+        const std::string tmp = _path + ".tmp";
+        std::error_code ec;
+        if (!_out || !WriteAheadLog::syncPath(tmp)) {
+            std::cerr << "Error: Could not write snapshot: " << tmp << std::endl;
+            return false;
+        }
+        std::filesystem::rename(tmp, _path, ec);
+        if (ec) {
+            std::cerr << "Error: Could not rename " << tmp << " to " << _path << ": " << ec.message() << std::endl;
+            return false;
+        }
+        WriteAheadLog::syncPath(std::filesystem::path(_path).parent_path().string());
+        _committed = true;
+        return true;
+    }
+
+    static uint32_t tocCrc(snapshot_format::Header header, const snapshot_format::TocEntry *toc) {
+        header.tocCrc = 0;
+        uint32_t crc = WriteAheadLog::crc32c(0, &header, sizeof(header));
+        return WriteAheadLog::crc32c(crc, toc, header.sections * sizeof(snapshot_format::TocEntry));
+    }
+
+private:
+    void padToPage() {
+        size_t pad = (snapshot_format::PAGE_SIZE - _offset % snapshot_format::PAGE_SIZE) % snapshot_format::PAGE_SIZE;
+        std::string zeros(pad, '\0');
+        _out.write(zeros.data(), std::streamsize(pad));
+        _offset += pad;
+    }
+
+    std::string   _path;
+    std::ofstream _out;
+    size_t        _offset = 0;
+    uint32_t      _crc = 0;
+    bool          _committed = false;
+    std::vector<snapshot_format::TocEntry> _toc;
+};
+
+// A snapshot mapped read-only with one mmap. open() checks the header and
+// TOC only; section checksums are checked by verify(), so callers choose
+// which sections to pay for up front (B+ tree images carry per-node
+// checksums and are verified as nodes are first read instead).
+class Snapshot {
+public:
+    struct Section {
+        const char *data = nullptr;
+        size_t      size = 0;
+    };
+
+    Snapshot() = default;
+    ~Snapshot() { close(); }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    bool open(const std::string &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || size_t(st.st_size) < snapshot_format::PAGE_SIZE) {
+            ::close(fd);
+            return false;
+        }
+        void *base = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);   // the mapping keeps the file
+        if (base == MAP_FAILED) return false;
+        _base = static_cast<const char*>(base);
+        _size = size_t(st.st_size);
+        _path = path;
+
+        using namespace snapshot_format;
+        Header header;
+        std::memcpy(&header, _base, sizeof(header));
+        bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                  && header.version == VERSION
+                  && header.tocOffset % PAGE_SIZE == 0 && header.tocOffset <= _size
+                  && header.sections <= (_size - header.tocOffset) / sizeof(TocEntry);
+        _toc = reinterpret_cast<const TocEntry*>(_base + (valid ? header.tocOffset : 0));
+        valid = valid && SnapshotWriter::tocCrc(header, _toc) == header.tocCrc;
+        for (uint32_t i = 0; valid && i < header.sections; i++) {
+            valid = _toc[i].offset % PAGE_SIZE == 0 && _toc[i].offset <= _size
+                 && _toc[i].length <= _size - _toc[i].offset;
+        }
+        if (!valid) {
+            std::cerr << "Snapshot " << path << " has a damaged header; ignoring it." << std::endl;
+            close();
+            return false;
+        }
+        _sections = header.sections;
+        return true;
+    }
+
+    void close() {
+        if (_base) ::munmap(const_cast<char*>(_base), _size);
+        _base = nullptr;
+        _size = 0;
+        _sections = 0;
+    }
+
+    bool isOpen() const { return _base != nullptr; }
+    const std::string& path() const { return _path; }
+
+    // Section `name`, or an empty one if the snapshot has none by that name
+    Section find(const std::string &name) const {
+        const snapshot_format::TocEntry *entry = lookup(name);
+        if (!entry) return {};
+        return { _base + entry->offset, size_t(entry->length) };
+    }
+
+    // Section exists and its bytes match the checksum written with it
+    bool verify(const std::string &name) const {
+        const snapshot_format::TocEntry *entry = lookup(name);
+        if (!entry) return false;
+        if (WriteAheadLog::crc32c(0, _base + entry->offset, size_t(entry->length)) == entry->crc) return true;
+        std::cerr << "Snapshot section " << name << " fails its checksum." << std::endl;
+        EngineMetrics::get().checksumFailures.inc();
+        return false;
+    }
+
+private:
+    const snapshot_format::TocEntry* lookup(const std::string &name) const {
+        for (uint32_t i = 0; i < _sections; i++) {
+            if (name == std::string(_toc[i].name, strnlen(_toc[i].name, snapshot_format::NAME_LEN))) return &_toc[i];
+        }
+        return nullptr;
+    }
+
+    std::string _path;
+    const char *_base = nullptr;
+    size_t      _size = 0;
+    const snapshot_format::TocEntry *_toc = nullptr;
+    uint32_t    _sections = 0;
+};
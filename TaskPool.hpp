@@ -0,0 +1,317 @@
+// TaskPool.hpp
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <memory_resource>
+#include <type_traits>
+#include <new>
+#include <atomic>
+#include <exception>
+#include "QueryArena.hpp"
+#include "Constants.h"
+#include "Metrics.hpp"
+
+// Fixed set of worker threads shared by every parallel stage of the engine,
+// so concurrent callers queue work instead of spawning their own threads.
+//
+// Work stealing: each worker has its own deque. A task submitted from a
+// worker goes on that worker's deque, and the worker runs it newest first
+// (its data is still in cache). A task from any other thread is dealt to
+// the workers in turn. A worker whose deque is empty steals the oldest task
+// of another worker, usually the biggest piece of work left, before it goes
+// to sleep. Nested groups therefore stay on the worker that spawned them
+// unless someone is idle.
+class TaskPool {
+public:
+    explicit TaskPool(size_t threads = defaultThreads())
+        : _workers(std::max<size_t>(1, threads))
+        , _steals(MetricsRegistry::shared().counter("hdb_task_steals_total", "Tasks a pool worker took from another worker's deque"))
+    {
+        for (size_t i = 0; i < _workers.size(); i++) {
+            _workers[i].thread = std::thread([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~TaskPool() {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            _stopping = true;
+        }
+        _wake.notify_all();
+        for (auto &w : _workers) w.thread.join();
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // TASK_POOL_THREADS (Constants.h), or one per core when that is 0
+    static size_t defaultThreads() {
+        return TASK_POOL_THREADS != 0 ? TASK_POOL_THREADS : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Process-wide pool
+    static TaskPool& shared() {
+        static TaskPool pool(sharedThreads() != 0 ? sharedThreads().load() : defaultThreads());
+        return pool;
+    }
+
+    // Size of the shared pool (0 = defaultThreads()). Only counts before the
+    // first call to shared(), so call it at startup.
+    static void configureShared(size_t threads) { sharedThreads() = threads; }
+
+    size_t size() const { return _workers.size(); }
+
+    void submit(std::function<void()> task) {
+        const Local &me = local();
+        size_t target = me.pool == this ? me.index
+                                        : _nextWorker.fetch_add(1, std::memory_order_relaxed) % _workers.size();
+        {
+            std::lock_guard<std::mutex> lock(_workers[target].mutex);
+            _workers[target].tasks.pushBack(std::move(task));
+        }
+        // Counted after the push, so a worker that sees the count finds the task
+        _queued.fetch_add(1);
+        if (_sleeping.load() > 0) {
+            { std::lock_guard<std::mutex> lock(_sleepMutex); }
+            _wake.notify_one();
+        }
+    }
+
+    // Run one queued task on the calling thread; false if every deque was empty
+    bool runOne() {
+        const Local &me = local();
+        std::function<void()> task;
+        bool found = me.pool == this ? take(me.index, task)
+                                     : steal(_nextWorker.load(std::memory_order_relaxed), task);
+        if (found) task();
+        return found;
+    }
+
+private:
+    // Growable ring of tasks, worked from both ends. It only ever grows, so
+    // a steady stream of tasks allocates nothing once it has reached its
+    // peak depth.
+    class Deque {
+    public:
+        bool empty() const { return _size == 0; }
+        void pushBack(std::function<void()> task) {
+            if (_size == _ring.size()) {
+                std::vector<std::function<void()>> bigger(std::max<size_t>(16, _ring.size() * 2));
+                for (size_t i = 0; i < _size; i++) bigger[i] = std::move(_ring[(_head + i) % _ring.size()]);
+                _ring.swap(bigger);
+                _head = 0;
+            }
+            _ring[(_head + _size) % _ring.size()] = std::move(task);
+            _size++;
+        }
+        std::function<void()> popBack() {
+            size_t at = (_head + _size - 1) % _ring.size();
+            std::function<void()> task = std::move(_ring[at]);
+            _ring[at] = nullptr;
+            _size--;
+            return task;
+        }
+        std::function<void()> popFront() {
+            std::function<void()> task = std::move(_ring[_head]);
+            _ring[_head] = nullptr;
+            _head = (_head + 1) % _ring.size();
+            _size--;
+            return task;
+        }
+
+    private:
+        std::vector<std::function<void()>> _ring;
+        size_t                             _head = 0;
+        size_t                             _size = 0;
+    };
+
+    struct Worker {
+        std::mutex  mutex;
+        Deque       tasks;
+        std::thread thread;
+    };
+
+    // Which pool (if any) the calling thread works for, and its slot
+    struct Local {
+        const TaskPool *pool = nullptr;
+        size_t          index = 0;
+    };
+    static Local& local() {
+        thread_local Local me;
+        return me;
+    }
+
+    static std::atomic<size_t>& sharedThreads() {
+        static std::atomic<size_t> threads{ 0 };
+        return threads;
+    }
+
+    void workerLoop(size_t index) {
+        local() = { this, index };
+        while (true) {
+            std::function<void()> task;
+            if (take(index, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _sleeping.fetch_add(1);
+            _wake.wait(lock, [&] { return _stopping || _queued.load() > 0; });
+            _sleeping.fetch_sub(1);
+            if (_stopping && _queued.load() == 0) return;
+        }
+    }
+
+    // Newest task of worker `index`, else the oldest one of another worker
+    bool take(size_t index, std::function<void()> &task) {
+        {
+            Worker &own = _workers[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.popBack();
+                _queued.fetch_sub(1);
+                return true;
+            }
+        }
+        return steal(index + 1, task);
+    }
+
+    // Oldest task of the first non-empty worker from `first` on (wrapping)
+    bool steal(size_t first, std::function<void()> &task) {
+        for (size_t k = 0; k < _workers.size(); k++) {
+            Worker &victim = _workers[(first + k) % _workers.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = victim.tasks.popFront();
+            _queued.fetch_sub(1);
+            _steals.inc();
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<Worker>     _workers;
+    std::atomic<size_t>     _nextWorker{ 0 };   // deals out tasks from outside the pool
+    std::atomic<size_t>     _queued{ 0 };       // tasks in all deques
+    std::atomic<size_t>     _sleeping{ 0 };
+    std::mutex              _sleepMutex;
+    std::condition_variable _wake;
+    bool                    _stopping = false;
+    Counter                &_steals;
+};
+
+// A set of tasks on a TaskPool that can be waited for together.
+// wait() runs queued tasks itself while it waits, so groups may nest.
+// Tasks allocate from the query arena of the thread that queued them.
+// The first exception a task throws is rethrown by wait(); the destructor
+// only waits, so a group left without wait() drops it.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPool &pool = TaskPool::shared()) : _pool(pool) {}
+    ~TaskGroup() { drain(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // The task is moved onto the query arena, so the pool queue only holds
+    // two pointers, which std::function keeps inline without allocating
+    template<typename Fn>
+    void run(Fn &&fn) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pending++;
+        }
+        using Body = Task<std::decay_t<Fn>>;
+        std::pmr::memory_resource *arena = QueryArena::current();
+        Body *task = new (arena->allocate(sizeof(Body), alignof(Body))) Body(arena, std::forward<Fn>(fn));
+        _pool.submit([this, task] {
+            std::exception_ptr error;
+            try {
+                QueryArena::Bind bind(task->arena);
+                task->run();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            task->destroy();
+            // decrement under the lock: once wait() sees zero the group may be destroyed
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (error && !_error) _error = error;
+            if (--_pending == 0) _cv.notify_all();
+        });
+    }
+
+    void wait() {
+        drain();
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::swap(error, _error);
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    void drain() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (_pending == 0) return;
+            }
+            if (_pool.runOne()) continue;
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cv.wait(lock, [&] { return _pending == 0; });
+        }
+    }
+
+    struct TaskBase {
+        explicit TaskBase(std::pmr::memory_resource *r) : arena(r) {}
+        virtual ~TaskBase() = default;
+        virtual void run() = 0;
+        virtual void destroy() = 0;
+        std::pmr::memory_resource *arena;   // where it lives, and what it allocates from
+    };
+    template<typename Fn>
+    struct Task final : TaskBase {
+        Task(std::pmr::memory_resource *r, Fn f) : TaskBase(r), fn(std::move(f)) {}
+        void run() override { fn(); }
+        void destroy() override {
+            std::pmr::memory_resource *r = arena;
+            this->~Task();
+            r->deallocate(this, sizeof(Task), alignof(Task));
+        }
+        Fn fn;
+    };
+
+    TaskPool               &_pool;
+    size_t                  _pending = 0;
+    std::mutex              _mutex;
+    std::condition_variable _cv;
+    std::exception_ptr      _error;     // first thrown by a task, for wait()
+};
+
+// fn(lo, hi) over [begin, end) split into chunks of at least `grain`, a few
+// per worker so that idle workers have something to steal when chunks run
+// unevenly. The calling thread runs the first chunk and helps with the rest;
+// returns when all are done.
+template<typename Fn>
+void parallelFor(size_t begin, size_t end, size_t grain, Fn &&fn, TaskPool &pool = TaskPool::shared()) {
+    if (begin >= end) return;
+    const size_t n = end - begin;
+    const size_t chunks = std::min((n + grain - 1) / std::max<size_t>(1, grain), pool.size() * 4);
+    if (chunks <= 1) {
+        fn(begin, end);
+        return;
+    }
+    const size_t step = (n + chunks - 1) / chunks;
+    TaskGroup group(pool);
+    for (size_t lo = begin + step; lo < end; lo += step) {
+        group.run([&fn, lo, step, end] { fn(lo, std::min(end, lo + step)); });
+    }
+    fn(begin, begin + step);
+    group.wait();
+}
@@ -0,0 +1,259 @@
+// WriteAheadLog.hpp
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Metrics.hpp"
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// Append-only redo log. Each record is
+//   [u32 payload length][u32 crc32c][u64 lsn][u8 type][payload]
+// with the checksum over lsn, type and payload. append() only buffers the
+// record; commit(lsn) makes it durable. Concurrent committers share one
+// write + fdatasync: the first becomes the leader and flushes everything
+// buffered so far, the others wait for it and return if their LSN was
+// covered (group commit).
+class WriteAheadLog {
+public:
+    enum RecordType : uint8_t {
+        FileReady        = 1,   // [tmp path][final path]: tmp is complete and synced
+        FileRemoved      = 2,   // [final path]: delete it when the checkpoint applies
+        CheckpointCommit = 3,   // [u64 rowCount]: the checkpoint is decided
+        AppendRows       = 4    // [u64 first row][u64 count][rows]: rows added since the checkpoint
+    };
+
+    explicit WriteAheadLog(const std::string &path) : _path(path) {
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (_fd < 0) {
+            std::cerr << "WAL: cannot open " << path << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+
+    ~WriteAheadLog() {
+        if (_fd >= 0) ::close(_fd);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    bool isOpen() const { return _fd >= 0; }
+
+    // Buffer one record; returns its LSN
+    uint64_t append(RecordType type, const std::string &payload) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint64_t lsn = ++_lastLsn;
+
+        char header[HEADER_SIZE];
+        uint32_t len = uint32_t(payload.size());
+        std::memcpy(header + 8, &lsn, sizeof(lsn));
+        header[16] = char(type);
+        uint32_t crc = crc32c(0, header + 8, 9);
+        crc = crc32c(crc, payload.data(), payload.size());
+        std::memcpy(header, &len, sizeof(len));
+        std::memcpy(header + 4, &crc, sizeof(crc));
+
+        _pending.append(header, HEADER_SIZE);
+        _pending.append(payload);
+        _records.inc();
+        return lsn;
+    }
+
+    // Block until every record up to `lsn` is on stable storage
+    bool commit(uint64_t lsn) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_durableLsn < lsn) {
+            if (_flushing) {
+                _flushed.wait(lock);
+                continue;
+            }
+            // 1) Become the leader: take everything buffered so far
+            _flushing = true;
+            std::string batch;
+            batch.swap(_pending);
+            uint64_t upTo = _lastLsn;
+            lock.unlock();
+
+            // 2) One write and one fdatasync for the whole group
+            bool ok = writeAll(batch.data(), batch.size()) && ::fdatasync(_fd) == 0;
+            _syncs.inc();
+
+            lock.lock();
+            _flushing = false;
+            if (ok) _durableLsn = upTo;
+            _flushed.notify_all();
+            if (!ok) {
+                std::cerr << "WAL: write to " << _path << " failed: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // fn(lsn, type, payload) for each intact record, oldest first. Stops at
+    // the first torn or corrupt record and cuts the log there, so later
+    // appends never follow garbage. Returns the number of records replayed.
+    size_t replay(const std::function<void(uint64_t, RecordType, const std::string&)> &fn) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_fd < 0) return 0;
+
+        std::string log;
+        char chunk[1 << 16];
+        off_t pos = 0;
+        for (ssize_t r; (r = ::pread(_fd, chunk, sizeof(chunk), pos)) > 0; pos += r) {
+            log.append(chunk, size_t(r));
+        }
+
+        size_t off = 0, replayed = 0;
+        while (off + HEADER_SIZE <= log.size()) {
+            uint32_t len, crc;
+            uint64_t lsn;
+            std::memcpy(&len, log.data() + off, sizeof(len));
+            std::memcpy(&crc, log.data() + off + 4, sizeof(crc));
+            std::memcpy(&lsn, log.data() + off + 8, sizeof(lsn));
+            if (off + HEADER_SIZE + len > log.size()) break;
+            uint32_t actual = crc32c(0, log.data() + off + 8, 9);
+            actual = crc32c(actual, log.data() + off + HEADER_SIZE, len);
+            if (actual != crc) break;
+
+            fn(lsn, RecordType(uint8_t(log[off + 16])), log.substr(off + HEADER_SIZE, len));
+            _lastLsn = _durableLsn = lsn;
+            off += HEADER_SIZE + len;
+            replayed++;
+        }
+        if (off < log.size()) {
+            std::cerr << "WAL: discarding " << (log.size() - off) << " bytes of torn log tail" << std::endl;
+            if (::ftruncate(_fd, off_t(off)) != 0 || ::fdatasync(_fd) != 0) {
+                std::cerr << "WAL: cannot truncate " << _path << std::endl;
+            }
+        }
+        return replayed;
+    }
+
+    // Drop every record (after a checkpoint has made them redundant)
+    void truncate() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending.clear();
+        if (_fd >= 0 && (::ftruncate(_fd, 0) != 0 || ::fdatasync(_fd) != 0)) {
+            std::cerr << "WAL: cannot truncate " << _path << std::endl;
+        }
+        _durableLsn = _lastLsn;
+    }
+
+    // Payload helpers: length-prefixed strings and raw integers
+    static void putString(std::string &out, std::string_view s) {
+        uint32_t len = uint32_t(s.size());
+        out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.append(s);
+    }
+    static void putU64(std::string &out, uint64_t v) {
+        out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    // Read back in the same order; `pos` advances, false if the payload is short
+    static bool getString(const std::string &in, size_t &pos, std::string &s) {
+        uint32_t len;
+        if (pos + sizeof(len) > in.size()) return false;
+        std::memcpy(&len, in.data() + pos, sizeof(len));
+        pos += sizeof(len);
+        if (pos + len > in.size()) return false;
+        s.assign(in, pos, len);
+        pos += len;
+        return true;
+    }
+    static bool getU64(const std::string &in, size_t &pos, uint64_t &v) {
+        if (pos + sizeof(v) > in.size()) return false;
+        std::memcpy(&v, in.data() + pos, sizeof(v));
+        pos += sizeof(v);
+        return true;
+    }
+
+    // Flush a file (or, for a directory, the names in it) to stable storage
+    static bool syncPath(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    // CRC-32C (Castagnoli). Eight bytes per SSE4.2 crc32 instruction when
+    // the CPU has one, a bytewise table otherwise; both give the same value.
+    static uint32_t crc32c(uint32_t crc, const void *data, size_t n) {
+#if defined(__x86_64__)
+        static const bool hardware = __builtin_cpu_supports("sse4.2");
+        if (hardware) return crc32cHardware(crc, data, n);
+#endif
+        return crc32cTable(crc, data, n);
+    }
+
+    static uint32_t crc32cTable(uint32_t crc, const void *data, size_t n) {
+        static const auto table = [] {
+            std::vector<uint32_t> t(256);
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        const unsigned char *p = static_cast<const unsigned char*>(data);
+        crc = ~crc;
+        for (size_t i = 0; i < n; i++) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+private:
+    static constexpr size_t HEADER_SIZE = 17;
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32cHardware(uint32_t crc, const void *data, size_t n) {
+        const unsigned char *p = static_cast<const unsigned char*>(data);
+        uint64_t c = ~crc;
+        for (; n >= 8; p += 8, n -= 8) {
+            uint64_t word;
+            std::memcpy(&word, p, sizeof(word));
+            c = _mm_crc32_u64(c, word);
+        }
+        uint32_t c32 = uint32_t(c);
+        for (; n > 0; p++, n--) c32 = _mm_crc32_u8(c32, *p);
+        return ~c32;
+    }
+#endif
+
+    bool writeAll(const char *data, size_t n) {
+        while (n > 0) {
+            ssize_t w = ::write(_fd, data, n);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            data += w;
+            n -= size_t(w);
+        }
+        return true;
+    }
+
+    std::string _path;
+    int         _fd = -1;
+
+    std::mutex              _mutex;
+    std::condition_variable _flushed;
+    std::string _pending;             // appended, not yet written
+    uint64_t    _lastLsn = 0;
+    uint64_t    _durableLsn = 0;
+    bool        _flushing = false;
+
+    Counter &_records = MetricsRegistry::shared().counter("hdb_wal_records_total", "Records appended to the write-ahead log");
+    Counter &_syncs   = MetricsRegistry::shared().counter("hdb_wal_syncs_total", "Write-ahead log group commits (fdatasync calls)");
+};
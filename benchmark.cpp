@@ -0,0 +1,714 @@
+// benchmark.cpp
+//
+// Microbenchmarks for ingestion, column I/O, index build/probe, fetch and
+// aggregation on a synthetic dataset.
+//
+//   ./benchmark [--rows=N] [--index-rows=N] [--filter=substr]
+//               [--min-time=seconds] [--json=results.json]
+//
+// --rows sizes the column store (10M+ works; generation is streamed),
+// --index-rows sizes the B+ trees, whose build cost is per-node disk I/O.
+
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <cstdlib>
+#include <new>
+#include "Benchmark.hpp"
+#include "ColumnStore.h"
+#include "IndexManager.hpp"
+#include "GroupBy.hpp"
+#include "Aggregates.hpp"
+#include "QueryArena.hpp"
+#include "ArrowExport.hpp"
+#include "TaskPool.hpp"
+
+namespace fs = std::filesystem;
+
+// ─── heap allocation counting ───
+
+// Every operator new in the process lands here, so a benchmark can report
+// heap allocations per iteration
+static std::atomic<uint64_t> gHeapAllocs{0};
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    gHeapAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+// std::pmr::new_delete_resource() always takes this one
+__attribute__((noinline)) void* operator new(size_t size, std::align_val_t align) {
+    gHeapAllocs.fetch_add(1, std::memory_order_relaxed);
+    size_t a = std::max(size_t(align), sizeof(void*));
+    if (void *p = std::aligned_alloc(a, (size + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void *p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+// ─── synthetic dataset ───
+
+static const std::vector<std::string> kTowns = {
+    "ANG MO KIO", "BEDOK", "BISHAN", "BUKIT BATOK", "BUKIT MERAH", "BUKIT PANJANG",
+    "BUKIT TIMAH", "CENTRAL AREA", "CHOA CHU KANG", "CLEMENTI", "GEYLANG", "HOUGANG",
+    "JURONG EAST", "JURONG WEST", "KALLANG/WHAMPOA", "MARINE PARADE", "PASIR RIS",
+    "PUNGGOL", "QUEENSTOWN", "SEMBAWANG", "SENGKANG", "SERANGOON", "TAMPINES",
+    "TOA PAYOH", "WOODLANDS", "YISHUN"
+};
+static const std::vector<std::string> kFlatTypes = {
+    "1 ROOM", "2 ROOM", "3 ROOM", "4 ROOM", "5 ROOM", "EXECUTIVE", "MULTI-GENERATION"
+};
+static const std::vector<std::string> kStoreys = {
+    "01 TO 03", "04 TO 06", "07 TO 09", "10 TO 12", "13 TO 15", "16 TO 18", "19 TO 21"
+};
+static const std::vector<std::string> kModels = {
+    "IMPROVED", "NEW GENERATION", "MODEL A", "STANDARD", "SIMPLIFIED", "PREMIUM APARTMENT", "DBSS"
+};
+
+// Rows spread evenly over 2014-01 .. 2024-12 in month order, like the real file
+static void writeSyntheticCSV(const std::string &path, size_t rows, unsigned seed = 42) {
+    std::ofstream out(path, std::ios::trunc);
+    out << "month,town,flat_type,block,street_name,storey_range,floor_area_sqm,flat_model,"
+           "lease_commence_date,resale_price\n";
+    std::mt19937 rng(seed);
+    const size_t months = 11 * 12;
+    for (size_t i = 0; i < rows; i++) {
+        size_t m = i * months / rows;
+        char month[24];
+        std::snprintf(month, sizeof(month), "%04zu-%02zu", 2014 + m / 12, 1 + m % 12);
+        const std::string &town = kTowns[rng() % kTowns.size()];
+        double area  = 35.0 + double(rng() % 1100) / 10.0;
+        double price = std::round(area * (2500.0 + double(rng() % 4000)) / 1000.0) * 1000.0;
+        out << month << ',' << town << ',' << kFlatTypes[rng() % kFlatTypes.size()] << ','
+            << (1 + rng() % 999) << ',' << town << " STREET " << (1 + rng() % 90) << ','
+            << kStoreys[rng() % kStoreys.size()] << ',' << area << ','
+            << kModels[rng() % kModels.size()] << ',' << (1966 + rng() % 55) << ','
+            << price << '\n';
+    }
+}
+
+// Sorted random record IDs, k of them out of n
+static RowIdList randomIds(size_t k, size_t n, unsigned seed = 7) {
+    std::mt19937 rng(seed);
+    RowIdList ids(k);
+    for (auto &id : ids) id = int(rng() % n);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+struct Fixture {
+    fs::path dir;
+    size_t rows = 200000;
+    size_t indexRows = 100000;
+    std::string csvPath;
+    std::unique_ptr<ColumnStore> store;
+    std::unique_ptr<BPlusTree<double, n_double>> priceTree;
+    std::unique_ptr<TownMonthTree> townMonthTree;
+    std::unique_ptr<StreetTree> streetTree;
+    BloomFilter streetBloom;
+    HashIndex streetHash;
+
+    void setUp() {
+        dir = fs::temp_directory_path() / "hdb_bench";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        csvPath = (dir / "synthetic.csv").string();
+        writeSyntheticCSV(csvPath, rows);
+
+        store = std::make_unique<ColumnStore>((dir / "store").string());
+        store->loadFromCSV(csvPath);
+        store->saveToDisk();
+    }
+
+    // Built on first use: only probe benchmarks need it
+    BPlusTree<double, n_double>& prices() {
+        if (!priceTree) {
+            fs::remove(dir / "price.idx");
+            priceTree = std::make_unique<BPlusTree<double, n_double>>((dir / "price.idx").string());
+            const auto data = store->getResalePrices()->pin();
+            size_t n = std::min(indexRows, data.rows().size());
+            for (size_t i = 0; i < n; i++) priceTree->insert(data.value(i), int(i));
+        }
+        return *priceTree;
+    }
+
+    TownMonthTree& townMonths() {
+        if (!townMonthTree) {
+            fs::remove(dir / "town_month.idx");
+            townMonthTree = std::make_unique<TownMonthTree>((dir / "town_month.idx").string());
+            const auto months = store->getMonths()->pin();
+            const auto towns  = store->getTowns()->pin();
+            const auto prices = store->getResalePrices()->pin();
+            const auto areas  = store->getFloorAreas()->pin();
+            size_t n = std::min(indexRows, prices.rows().size());
+            for (size_t i = 0; i < n; i++) {
+                townMonthTree->insert(TownMonthKey{ { towns.value(i), months.value(i) },
+                                                    { prices.value(i), areas.value(i) } }, int(i));
+            }
+        }
+        return *townMonthTree;
+    }
+
+    // Street name tree, its Bloom filter and a hash index, over the same rows
+    StreetTree& streets() {
+        if (!streetTree) {
+            fs::remove(dir / "street.idx");
+            streetTree = std::make_unique<StreetTree>((dir / "street.idx").string());
+            const auto names = store->getStreetNames()->pin();
+            size_t n = std::min(indexRows, names.rows().size());
+            streetBloom = BloomFilter(store->getStreetNameDict().cardinality());
+            for (size_t i = 0; i < n; i++) {
+                streetBloom.add(std::string_view(names.value(i)).substr(0, FIXED_STRING_LEN - 1));
+                streetTree->insert(names.value(i), int(i));
+            }
+            streetHash.build(store->getStreetNameDict(), n);
+        }
+        return *streetTree;
+    }
+
+    void tearDown() {
+        priceTree.reset();
+        townMonthTree.reset();
+        streetTree.reset();
+        store.reset();
+        fs::remove_all(dir);
+    }
+};
+
+static Fixture fx;
+
+// ─── ingestion and column I/O ───
+
+static void BM_LoadFromCSV(bench::State &state) {
+    ColumnStore cs((fx.dir / "csv_load").string());
+    while (state.keepRunning()) {
+        cs.loadFromCSV(fx.csvPath);
+    }
+    state.setItemsProcessed(state.iterations() * int64_t(fx.rows));
+}
+
+// Live ingestion: appendFromCSV of arg rows into a copy of the saved store,
+// with every index kept up to date, next to no queries. Afterwards the
+// appended rows must come back from an index search and a fetch; a run where
+// they do not is labelled MISMATCH.
+static void BM_AppendFromCSV(bench::State &state) {
+    const fs::path storeDir = fx.dir / "append_store";
+    const std::string appendCsv = (fx.dir / "append.csv").string();
+    fs::remove_all(storeDir);
+    fs::remove_all(fx.dir / "append_idx");
+    fs::copy(fx.dir / "store", storeDir);
+    {
+        std::ofstream out(appendCsv, std::ios::trunc);
+        out << "month,town,flat_type,block,street_name,storey_range,floor_area_sqm,flat_model,"
+               "lease_commence_date,resale_price\n";
+        for (int64_t i = 0; i < state.range(0); i++) {
+            out << "2024-12,APPENDED TOWN,4 ROOM," << (1 + i % 999) << ",APPENDED STREET,01 TO 03,"
+                << "90,MODEL A,2000,500000\n";
+        }
+    }
+    ColumnStore cs(storeDir.string());
+    cs.loadFromDisk();
+    IndexManager idx((fx.dir / "append_idx").string());
+    idx.buildIndexes(cs);
+
+    size_t appended = 0;
+    while (state.keepRunning()) {
+        appended += cs.appendFromCSV(appendCsv, [&](size_t begin, size_t end) { idx.indexRows(cs, begin, end); });
+    }
+
+    auto view = cs.pin();
+    RowIdList ids = idx.searchAll({}, { { IntervalType::ClosedClosed, "APPENDED TOWN", "APPENDED TOWN" } },
+                                  {}, {}, {}, {}, {}, {}, {}, {});
+    view.clip(ids);
+    size_t good = 0;
+    for (auto const &[id, row] : cs.fetchRows(ids)) {
+        good += row.town == "APPENDED TOWN" && row.resalePrice == 500000 && size_t(id) >= fx.rows;
+    }
+    if (ids.size() != appended || good != appended) {
+        std::cerr << "BM_AppendFromCSV: appended " << appended << " rows, the town index finds " << ids.size()
+                  << " and " << good << " fetch back intact" << std::endl;
+        state.setLabel("MISMATCH");
+    }
+    state.counters["rows_after"] = double(view.rows);
+    state.setItemsProcessed(state.iterations() * state.range(0));
+}
+
+template<typename T>
+static std::unique_ptr<Column<T>> filledColumn(const std::string &file, const std::vector<T> &src) {
+    auto col = std::make_unique<Column<T>>("bench", (fx.dir / file).string());
+    for (auto const &v : src) col->addValue(v);
+    return col;
+}
+
+static void BM_ColumnStoreToDisk_Double(bench::State &state) {
+    auto col = filledColumn("bench_double.dat", fx.store->getResalePrices()->pin().rows());
+    while (state.keepRunning()) col->storeToDisk(col->getFileName());
+    state.setItemsProcessed(state.iterations() * int64_t(col->size()));
+}
+
+static void BM_ColumnStoreToDisk_String(bench::State &state) {
+    auto col = filledColumn("bench_string.dat", fx.store->getStreetNames()->pin().rows());
+    while (state.keepRunning()) col->storeToDisk(col->getFileName());
+    state.setItemsProcessed(state.iterations() * int64_t(col->size()));
+}
+
+static void BM_ColumnLoadFromDisk_Double(bench::State &state) {
+    auto col = filledColumn("bench_double.dat", fx.store->getResalePrices()->pin().rows());
+    col->storeToDisk(col->getFileName());
+    while (state.keepRunning()) col->loadFromDisk();
+    state.setItemsProcessed(state.iterations() * int64_t(col->size()));
+}
+
+static void BM_ColumnLoadFromDisk_String(bench::State &state) {
+    auto col = filledColumn("bench_string.dat", fx.store->getStreetNames()->pin().rows());
+    col->storeToDisk(col->getFileName());
+    while (state.keepRunning()) col->loadFromDisk();
+    state.setItemsProcessed(state.iterations() * int64_t(col->size()));
+}
+
+// Block checksums over a column file's worth of blocks: the bytewise table
+// (arg 0) against the SSE4.2 instruction used where the CPU has it (arg 1)
+static void BM_Crc32c(bench::State &state) {
+    std::string blocks(size_t(1) << 20, '\0');
+    for (size_t i = 0; i < blocks.size(); i++) blocks[i] = char(i * 2654435761u >> 24);
+    uint32_t crc = 0;
+    while (state.keepRunning()) {
+        for (size_t off = 0; off < blocks.size(); off += BLOCK_SIZE) {
+            crc += state.range(0) ? WriteAheadLog::crc32c(0, blocks.data() + off, BLOCK_SIZE)
+                                  : WriteAheadLog::crc32cTable(0, blocks.data() + off, BLOCK_SIZE);
+        }
+    }
+    state.counters["result"] = double(crc);
+    state.setItemsProcessed(state.iterations() * int64_t(blocks.size() / BLOCK_SIZE));
+    state.setBytesProcessed(state.iterations() * int64_t(blocks.size()));
+}
+
+// ─── index build and probe ───
+
+static void BM_BPlusTreeInsert(bench::State &state) {
+    fs::path file = fx.dir / "insert.idx";
+    fs::remove(file);
+    std::mt19937 rng(1);
+    {
+        BPlusTree<double, n_double> tree(file.string());
+        int i = 0;
+        while (state.keepRunning()) {
+            tree.insert(double(rng() % 1000000), i++);
+        }
+    }
+    fs::remove(file);
+    state.setItemsProcessed(state.iterations());
+}
+
+// Arg: insert threads. Each iteration inserts one batch of random keys into a
+// shared tree with insertConcurrent(); compare items/s with BM_BPlusTreeInsert.
+static void BM_BPlusTreeInsertConcurrent(bench::State &state) {
+    const size_t threads = size_t(state.range(0));
+    const size_t batch = 8192;
+    fs::path file = fx.dir / "insert_olc.idx";
+    fs::remove(file);
+    {
+        BPlusTree<double, n_double> tree(file.string());
+        TaskPool pool(threads);
+        std::atomic<int> next{0};
+        while (state.keepRunning()) {
+            TaskGroup group(pool);
+            for (size_t t = 0; t < threads; t++) {
+                group.run([&, t] {
+                    std::mt19937 rng(unsigned(next.load() + t));
+                    for (size_t i = t; i < batch; i += threads) {
+                        tree.insertConcurrent(double(rng() % 1000000), next.fetch_add(1));
+                    }
+                });
+            }
+            group.wait();
+        }
+    }
+    fs::remove(file);
+    state.setItemsProcessed(state.iterations() * int64_t(batch));
+}
+
+// Arg: pool threads. Sums the price column in parallelFor chunks; the pool is
+// the engine's, so this is the ceiling for every row-range stage
+static void BM_ParallelFor(bench::State &state) {
+    TaskPool pool(size_t(state.range(0)));
+    const auto prices = fx.store->getResalePrices()->pin();
+    const std::vector<double> &rows = prices.rows();
+    std::atomic<uint64_t> total{0};
+    while (state.keepRunning()) {
+        parallelFor(0, rows.size(), 16384, [&](size_t lo, size_t hi) {
+            double sum = 0;
+            for (size_t i = lo; i < hi; i++) sum += rows[i];
+            total.fetch_add(uint64_t(sum), std::memory_order_relaxed);
+        }, pool);
+    }
+    state.counters["result"] = double(total.load());
+    state.setItemsProcessed(state.iterations() * int64_t(rows.size()));
+}
+
+// Arg: IntervalType as int. Bounds select roughly the middle fifth of prices.
+static void BM_SearchRange(bench::State &state) {
+    auto &tree = fx.prices();
+    auto type = IntervalType(state.range(0));
+    std::vector<Interval<double>> ivs = { { type, 400000.0, 480000.0 } };
+    size_t matched = 0;
+    while (state.keepRunning()) {
+        matched = tree.searchIntervals(ivs).size();
+    }
+    state.counters["matches"] = double(matched);
+    state.setItemsProcessed(state.iterations() * int64_t(matched));
+}
+
+// The standard report on the covering (town, month) index: one town, two
+// months, price and area straight from the leaves
+static void BM_TownMonthScan(bench::State &state) {
+    auto &tree = fx.townMonths();
+    const double lowest = std::numeric_limits<double>::lowest(), highest = std::numeric_limits<double>::max();
+    TownMonthKey lo{ { "YISHUN", "2014-07" }, { lowest,  lowest  } };
+    TownMonthKey hi{ { "YISHUN", "2014-08" }, { highest, highest } };
+    size_t matched = 0;
+    while (state.keepRunning()) {
+        matched = tree.searchRange(lo, hi).size();
+    }
+    state.counters["matches"] = double(matched);
+    state.setItemsProcessed(state.iterations() * int64_t(matched));
+}
+
+// Equality lookups of street names no row has (numbers past the generated
+// 1..90): a tree descent each (arg 0), or the Bloom filter first (arg 1)
+static void BM_EqualityMiss(bench::State &state) {
+    auto &tree = fx.streets();
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 256; i++) keys.push_back(kTowns[i % kTowns.size()] + " STREET " + std::to_string(91 + i));
+    size_t probes = 0, matched = 0, descents = 0;
+    while (state.keepRunning()) {
+        const std::string &key = keys[probes++ % keys.size()];
+        if (state.range(0) && !fx.streetBloom.mightContain(std::string_view(key).substr(0, FIXED_STRING_LEN - 1))) continue;
+        descents++;
+        matched += tree.searchIntervals({ { IntervalType::ClosedClosed, key, key } }).size();
+    }
+    state.counters["matches"] = double(matched);
+    state.counters["descents"] = double(descents);
+    state.setItemsProcessed(state.iterations());
+}
+
+// Narrow price ranges: the disk B+ tree (arg 0) against a learned index over
+// the same rows (arg 1); footprint is the tree's node space against the
+// model alone and the whole in-memory index
+static void BM_LearnedIndex(bench::State &state) {
+    auto &tree = fx.prices();
+    const auto prices = fx.store->getResalePrices()->pin();
+    size_t n = std::min(fx.indexRows, prices.rows().size());
+    LearnedIndex<double> learned;
+    if (state.range(0)) learned.build(n, [&](size_t i) { return prices.value(i); });
+
+    std::mt19937 rng(3);
+    std::vector<Interval<double>> probes;
+    for (size_t i = 0; i < 256; i++) {
+        double low = prices.value(rng() % n);
+        probes.push_back({ IntervalType::ClosedClosed, low, low + 2000.0 });
+    }
+    size_t next = 0, matched = 0;
+    while (state.keepRunning()) {
+        std::vector<Interval<double>> ivs = { probes[next++ % probes.size()] };
+        matched += state.range(0) ? learned.searchIntervals(ivs).size() : tree.searchIntervals(ivs).size();
+    }
+    state.counters["matches"] = double(matched);
+    if (state.range(0)) {
+        state.counters["segments"]    = double(learned.segments());
+        state.counters["model_bytes"] = double(learned.modelBytes());
+        state.counters["index_bytes"] = double(learned.bytes());
+    } else {
+        state.counters["index_bytes"] = double(tree.shape().bytes);
+    }
+    state.setItemsProcessed(state.iterations());
+}
+
+// Equality lookups of street names that rows have: the B+ tree (arg 0)
+// against the in-memory hash index (arg 1)
+static void BM_EqualityLookup(bench::State &state) {
+    auto &tree = fx.streets();
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 256; i++) keys.push_back(kTowns[i % kTowns.size()] + " STREET " + std::to_string(1 + i % 90));
+    size_t probes = 0, matched = 0;
+    while (state.keepRunning()) {
+        const std::string &key = keys[probes++ % keys.size()];
+        std::vector<Interval<std::string>> ivs = { { IntervalType::ClosedClosed, key, key } };
+        matched += state.range(0) ? fx.streetHash.lookup(ivs).size() : tree.searchIntervals(ivs).size();
+    }
+    state.counters["matches"] = double(matched);
+    state.setItemsProcessed(state.iterations());
+}
+
+// Arg: size of the first list; the others are 1/2 and 1/4 of it
+static void BM_IntersectAll(bench::State &state) {
+    size_t k = size_t(state.range(0));
+    size_t n = std::max(fx.rows, k * 2);
+    std::pmr::vector<RowIdList> lists;
+    lists.push_back(randomIds(k, n, 1));
+    lists.push_back(randomIds(k / 2, n, 2));
+    lists.push_back(randomIds(k / 4, n, 3));
+    size_t matched = 0;
+    while (state.keepRunning()) {
+        matched = IndexManager::intersectAll(lists).size();
+    }
+    state.counters["matches"] = double(matched);
+    state.setItemsProcessed(state.iterations() * int64_t(k));
+}
+
+// ─── fetch ───
+
+// Arg: number of random record IDs
+static void BM_FetchRows(bench::State &state) {
+    auto ids = randomIds(size_t(state.range(0)), fx.store->getRowCount());
+    while (state.keepRunning()) {
+        auto rows = fx.store->fetchRows(ids);
+    }
+    state.setItemsProcessed(state.iterations() * int64_t(ids.size()));
+}
+
+// Arg: length of the contiguous range
+static void BM_FetchRowRange(bench::State &state) {
+    size_t len = std::min(size_t(state.range(0)), fx.store->getRowCount());
+    size_t begin = (fx.store->getRowCount() - len) / 2;
+    while (state.keepRunning()) {
+        auto rows = fx.store->fetchRowRange(begin, begin + len);
+    }
+    state.setItemsProcessed(state.iterations() * int64_t(len));
+}
+
+// ─── aggregation ───
+
+static ColumnStore::Rows aggregateInput() {
+    return fx.store->fetchRows(randomIds(10000, fx.store->getRowCount(), 11));
+}
+
+template<double (*Agg)(const ColumnStore::Rows&)>
+static void BM_Aggregate(bench::State &state) {
+    auto rows = aggregateInput();
+    double result = 0;
+    while (state.keepRunning()) {
+        result += Agg(rows);
+    }
+    state.counters["result"] = result / double(std::max<int64_t>(1, state.iterations()));
+    state.setItemsProcessed(state.iterations() * int64_t(rows.size()));
+}
+
+// Arg: number of qualifying rows
+static void BM_GroupByTown(bench::State &state) {
+    auto ids = randomIds(size_t(state.range(0)), fx.store->getRowCount(), 13);
+    GroupByEngine groupBy(*fx.store);
+    std::vector<AggregateSpec> aggs = {
+        { AggFunc::Avg, Measure::Price }, { AggFunc::Min, Measure::Price },
+        { AggFunc::StdDev, Measure::Price }, { AggFunc::Min, Measure::PricePerSqm }
+    };
+    size_t groups = 0;
+    while (state.keepRunning()) {
+        groups = groupBy.run(ids, { GroupKey::Town }, aggs).groups.size();
+    }
+    state.counters["groups"] = double(groups);
+    state.setItemsProcessed(state.iterations() * int64_t(ids.size()));
+}
+
+// ─── query memory ───
+
+// Arg: 0 = intermediates on the heap, 1 = on a reused QueryArena. One
+// iteration is a whole query: two price-range index scans, their
+// intersection, a row fetch and a town group-by. Reports heap allocations
+// per query, and how many of them the row fetch made; with the arena, what
+// is left is the group-by result.
+static void BM_QueryArena(bench::State &state) {
+    auto &tree = fx.prices();
+    const bool useArena = state.range(0) != 0;
+    std::vector<Interval<double>> band  = { { IntervalType::ClosedClosed, 300000.0, 500000.0 } };
+    std::vector<Interval<double>> above = { { IntervalType::FromClosed,   400000.0, 0.0 } };
+    std::vector<AggregateSpec> aggs = { { AggFunc::Avg, Measure::Price }, { AggFunc::Min, Measure::PricePerSqm } };
+    GroupByEngine groupBy(*fx.store);
+    QueryArena arena;
+
+    size_t matched = 0;
+    uint64_t allocs = 0, rowAllocs = 0;
+    while (state.keepRunning()) {
+        std::optional<QueryArena::Scope> scope;
+        if (useArena) scope.emplace(arena);
+        uint64_t before = gHeapAllocs.load(std::memory_order_relaxed);
+
+        std::pmr::vector<RowIdList> lists(QueryArena::current());
+        lists.reserve(2);
+        lists.push_back(tree.searchIntervals(band));
+        lists.push_back(tree.searchIntervals(above));
+        RowIdList ids = IndexManager::intersectAll(lists);
+        uint64_t beforeFetch = gHeapAllocs.load(std::memory_order_relaxed);
+        ColumnStore::Rows rows = fx.store->fetchRows(ids);
+        rowAllocs += gHeapAllocs.load(std::memory_order_relaxed) - beforeFetch;
+        matched = rows.size() + groupBy.run(ids, { GroupKey::Town }, aggs).groups.size();
+
+        allocs += gHeapAllocs.load(std::memory_order_relaxed) - before;
+    }
+    int64_t iters = std::max<int64_t>(1, state.iterations());
+    state.counters["heap_allocs_per_query"] = double(allocs) / double(iters);
+    state.counters["fetch_allocs_per_query"] = double(rowAllocs) / double(iters);
+    state.counters["arena_bytes"] = double(arena.bytesReserved());
+    state.counters["matches"] = double(matched);
+    state.setItemsProcessed(state.iterations());
+}
+
+// ─── export ───
+
+// Arg: 0 = the whole store as CSV text (what downstream tools parsed
+// before), 1 = as an Arrow IPC file. Both read the rows in the same batches.
+static void BM_ExportStore(bench::State &state) {
+    const std::string path = (fx.dir / (state.range(0) ? "export.arrow" : "export.csv")).string();
+    while (state.keepRunning()) {
+        if (state.range(0)) {
+            ArrowExport::exportStore(*fx.store, path);
+            continue;
+        }
+        std::ofstream out(path, std::ios::trunc);
+        QueryArena arena;
+        for (size_t begin = 0; begin < fx.store->getRowCount(); begin += ArrowExport::BATCH_ROWS) {
+            QueryArena::Scope scope(arena);
+            for (auto const &pr : fx.store->fetchRowRange(begin, begin + ArrowExport::BATCH_ROWS)) {
+                const auto &r = pr.second;
+                out << r.month << ',' << r.town << ',' << r.flatType << ',' << r.block << ','
+                    << r.streetName << ',' << r.storeyRange << ',' << r.floorArea << ','
+                    << r.flatModel << ',' << r.leaseDate << ',' << r.resalePrice << '\n';
+            }
+        }
+    }
+    state.counters["file_bytes"] = double(fs::file_size(path));
+    state.setItemsProcessed(state.iterations() * int64_t(fx.store->getRowCount()));
+}
+
+// ─── cold start ───
+
+// From a copy of the saved store to a queryable store with every index.
+// Arg: 0 = load the column files and build the indexes, 1 = open the
+// snapshot and attach its index images.
+static void BM_ColdStart(bench::State &state) {
+    const fs::path storeDir = fx.dir / "cold_store";
+    const fs::path indexDir = fx.dir / "cold_idx";
+    if (!fs::exists(storeDir)) {
+        fs::copy(fx.dir / "store", storeDir);
+        ColumnStore cs(storeDir.string());
+        cs.loadFromDisk();
+        IndexManager idx(indexDir.string());
+        idx.buildIndexes(cs);
+        SnapshotWriter out(cs.snapshotPath());
+        if (!(cs.writeSnapshot(out) && idx.writeSnapshot(out) && out.commit())) {
+            std::cerr << "BM_ColdStart: could not write the snapshot" << std::endl;
+        }
+    }
+    size_t resident = 0;
+    while (state.keepRunning()) {
+        ColumnStore cs(storeDir.string());
+        Snapshot snapshot;
+        IndexManager idx(indexDir.string());
+        if (state.range(0) && snapshot.open(cs.snapshotPath())) {
+            size_t rows = cs.loadFromSnapshot(snapshot);
+            if (rows == 0 || idx.attachSnapshot(snapshot, rows) == 0) state.setLabel("snapshot not usable");
+            else idx.buildMemoryIndexes(cs, rows);
+        } else {
+            cs.loadFromDisk();
+            idx.buildIndexes(cs);
+        }
+        resident = cs.getResidentColumnBytes();
+    }
+    state.counters["snapshot_bytes"] = double(fs::file_size(storeDir / "hdb.snapshot"));
+    state.counters["resident_column_bytes"] = double(resident);
+    state.setItemsProcessed(state.iterations() * int64_t(fx.rows));
+}
+
+// A query touching one numeric column after another, with room for every
+// column (arg 0) or for a single one (arg 1), so each pin reads its file again
+static void BM_ColumnBudget(bench::State &state) {
+    ColumnStore cs((fx.dir / "store").string());
+    cs.loadFromDisk();
+    if (state.range(0)) cs.setColumnMemoryBudget(fx.rows * sizeof(double));
+    const uint64_t loadsBefore = MetricsRegistry::shared().counter("hdb_column_loads_total", "").value();
+    double sum = 0;
+    while (state.keepRunning()) {
+        for (auto *col : { cs.getResalePrices(), cs.getFloorAreas() }) {
+            const auto pinned = col->pin();
+            for (double v : pinned.rows()) sum += v;
+        }
+    }
+    state.counters["result"] = sum / double(std::max<int64_t>(1, state.iterations()));
+    state.counters["column_loads"] = double(MetricsRegistry::shared().counter("hdb_column_loads_total", "").value() - loadsBefore);
+    state.counters["resident_column_bytes"] = double(cs.getResidentColumnBytes());
+    state.setItemsProcessed(state.iterations() * 2 * int64_t(fx.rows));
+}
+
+int main(int argc, char **argv) {
+    bench::Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&](const std::string &flag) { return arg.substr(flag.size()); };
+        if      (arg.rfind("--rows=", 0) == 0)       fx.rows = std::stoull(value("--rows="));
+        else if (arg.rfind("--index-rows=", 0) == 0) fx.indexRows = std::stoull(value("--index-rows="));
+        else if (arg.rfind("--filter=", 0) == 0)     opt.filter = value("--filter=");
+        else if (arg.rfind("--min-time=", 0) == 0)   opt.minTime = std::stod(value("--min-time="));
+        else if (arg.rfind("--json=", 0) == 0)       opt.jsonPath = value("--json=");
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // Engine progress/trace output would drown the report: mute std::cout
+    std::ostream report(std::cout.rdbuf());
+    opt.report = &report;
+    report << "Generating " << fx.rows << " synthetic rows..." << std::endl;
+    std::cout.rdbuf(nullptr);
+    fx.setUp();
+
+    const int64_t n = int64_t(fx.rows);
+    bench::registerBenchmark("BM_LoadFromCSV", BM_LoadFromCSV);
+    bench::registerBenchmark("BM_AppendFromCSV", BM_AppendFromCSV)->Arg(1000)->Arg(10000);
+    bench::registerBenchmark("BM_ColumnStoreToDisk_Double", BM_ColumnStoreToDisk_Double);
+    bench::registerBenchmark("BM_ColumnStoreToDisk_String", BM_ColumnStoreToDisk_String);
+    bench::registerBenchmark("BM_ColumnLoadFromDisk_Double", BM_ColumnLoadFromDisk_Double);
+    bench::registerBenchmark("BM_ColumnLoadFromDisk_String", BM_ColumnLoadFromDisk_String);
+    bench::registerBenchmark("BM_Crc32c", BM_Crc32c)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_BPlusTreeInsert", BM_BPlusTreeInsert);
+    auto *olc = bench::registerBenchmark("BM_BPlusTreeInsertConcurrent", BM_BPlusTreeInsertConcurrent);
+    for (int threads = 1; threads <= 32; threads *= 2) olc->Arg(threads);
+    auto *search = bench::registerBenchmark("BM_SearchRange", BM_SearchRange);
+    for (int t = int(IntervalType::ClosedClosed); t <= int(IntervalType::FromOpen); t++) search->Arg(t);
+    bench::registerBenchmark("BM_TownMonthScan", BM_TownMonthScan);
+    bench::registerBenchmark("BM_ParallelFor", BM_ParallelFor)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+    bench::registerBenchmark("BM_EqualityMiss", BM_EqualityMiss)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_EqualityLookup", BM_EqualityLookup)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_LearnedIndex", BM_LearnedIndex)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_IntersectAll", BM_IntersectAll)->Arg(1000)->Arg(100000)->Arg(n / 2);
+    bench::registerBenchmark("BM_FetchRows", BM_FetchRows)->Arg(100)->Arg(10000)->Arg(n / 4);
+    bench::registerBenchmark("BM_FetchRowRange", BM_FetchRowRange)->Arg(1000)->Arg(n / 4);
+    bench::registerBenchmark("BM_Aggregate_AVG", BM_Aggregate<average_result>);
+    bench::registerBenchmark("BM_Aggregate_MIN", BM_Aggregate<min_result>);
+    bench::registerBenchmark("BM_Aggregate_SD", BM_Aggregate<sd_result>);
+    bench::registerBenchmark("BM_Aggregate_MIN_per_sqm", BM_Aggregate<min_result_per_sqm>);
+    bench::registerBenchmark("BM_GroupByTown", BM_GroupByTown)->Arg(10000)->Arg(n);
+    bench::registerBenchmark("BM_QueryArena", BM_QueryArena)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_ExportStore", BM_ExportStore)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_ColdStart", BM_ColdStart)->Arg(0)->Arg(1);
+    bench::registerBenchmark("BM_ColumnBudget", BM_ColumnBudget)->Arg(0)->Arg(1);
+
+    bench::runAll(opt, { { "rows", std::to_string(fx.rows) },
+                         { "index_rows", std::to_string(fx.indexRows) } });
+
+    fx.tearDown();
+    std::cout.rdbuf(report.rdbuf());
+    return 0;
+}
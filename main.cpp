@@ -5,6 +5,14 @@
 #include <filesystem>
 #include <algorithm> 
 #include "IndexManager.hpp"
+#include "GroupBy.hpp"
+#include "Aggregates.hpp"
+#include "QueryProfile.hpp"
+#include "Metrics.hpp"
+#include "QueryArena.hpp"
+#include "ArrowExport.hpp"
+#include "Snapshot.hpp"
+#include "ColumnScrubber.hpp"
 #include <fstream>
 
 namespace fs = std::filesystem;
@@ -18,16 +26,20 @@ void writeResultToCSV(const std::string& filename,
     bool writeHeader);
 
 std::string formatYearMonth(int year, int month);
-double sd_result(std::vector<std::pair<int, ColumnStore::DataRow>> rows);
-double min_result_per_sqm(std::vector<std::pair<int, ColumnStore::DataRow>> rows);
-double min_result(std::vector<std::pair<int, ColumnStore::DataRow>> rows);
-double average_result(std::vector<std::pair<int, ColumnStore::DataRow>> rows);
 
 int main() {
 
     const std::string dataFolder = "hdb_data_store";
     const std::string csvFile = "ResalePricesSingapore.csv";
     const std::string checkFilename = "col_months.dat";
+    // Physical sort order for the column files; every standard query is month range + town
+    const std::vector<std::string> clusterKey = { "months", "towns" };
+    const std::string metricsFile = "hdb_metrics.prom";
+    const std::string storeExportFile = "hdb_store.arrow";
+
+    // Scrape endpoint for the metrics registry; the menu can also dump it to a file
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (METRICS_PORT != 0) metricsServer = std::make_unique<MetricsServer>(METRICS_PORT);
 
 
     std::cout << "Using data folder: " << dataFolder << std::endl;
@@ -36,21 +48,44 @@ int main() {
     fs::path checkFilePath = fs::path(dataFolder) / checkFilename;
     bool dataExistsOnDisk = fs::exists(checkFilePath);
 
+    // The snapshot stays mapped while the indexes restored from it run
+    Snapshot snapshot;
+    IndexManager idxMgr("bptree");
+    bool indexesRestored = false;
+
     auto startTime = std::chrono::high_resolution_clock::now();
 
     if (dataExistsOnDisk) {
-        std::cout << "Found existing column data files in '" << dataFolder
-                  << "' (checked: " << checkFilename << "). Loading data from disk..." << std::endl;
-        store.loadFromDisk();
+        // Cold start from the snapshot when there is a usable one: one mapped
+        // file instead of the column files plus a full index rebuild
+        size_t snapshotRows = 0;
+        if (snapshot.open(store.snapshotPath())) snapshotRows = store.loadFromSnapshot(snapshot);
+        if (snapshotRows > 0 && idxMgr.attachSnapshot(snapshot, snapshotRows) > 0) {
+            try {
+                idxMgr.buildMemoryIndexes(store, snapshotRows);   // never in the snapshot
+            } catch (const std::runtime_error& e) {
+                std::cerr << "Error: " << e.what() << std::endl;   // a damaged numeric column
+                return 1;
+            }
+            idxMgr.indexRows(store, snapshotRows, store.getRowCount());   // rows logged after it
+            indexesRestored = true;
+        } else {
+            snapshot.close();
+            std::cout << "Found existing column data files in '" << dataFolder
+                      << "' (checked: " << checkFilename << "). Loading data from disk..." << std::endl;
+            // A damaged store is rebuilt from the CSV below rather than queried
+            dataExistsOnDisk = store.loadFromDisk();
+        }
+    }
 
-    } else {
-        std::cout << "No existing column data found in '" << dataFolder
+    if (!dataExistsOnDisk) {
+        std::cout << "No usable column data found in '" << dataFolder
                   << "' (checked: " << checkFilename << "). Processing CSV file '" << csvFile << "'..." << std::endl;
         store.loadFromCSV(csvFile);
 
         if (store.getRowCount() > 0) {
             std::cout << "Saving processed data to disk for future use..." << std::endl;
-            store.saveToDisk();
+            store.saveToDisk(clusterKey);
         } else {
             std::cerr << "Warning: No records loaded from CSV. Nothing to save." << std::endl;
         }
@@ -70,27 +105,50 @@ int main() {
         std::cout << "----------------------------------------------------------------" << std::endl;
 
         size_t sampleSize = std::min(store.getRowCount(), static_cast<size_t>(5));
-        for (size_t i = 0; i < sampleSize; i++) {
-            // Access data using getData() and [] operator
-            std::cout << store.getMonths()->getData()[i] << "\t"
-                      << store.getTowns()->getData()[i] << "\t"
-                      << store.getFlatTypes()->getData()[i] << "\t"
-                      << store.getFloorAreas()->getData()[i] << "\t\t" 
-                      << store.getResalePrices()->getData()[i] << std::endl;
+        size_t unreadable = 0;
+        // A short range read, so the sample loads no whole column into memory
+        for (auto const& [id, row] : store.fetchRowRange(0, sampleSize, nullptr, &unreadable)) {
+            std::cout << row.month << "\t"
+                      << row.town << "\t"
+                      << row.flatType << "\t"
+                      << row.floorArea << "\t\t" 
+                      << row.resalePrice << std::endl;
+        }
+        if (unreadable > 0) {
+            std::cerr << "Warning: " << unreadable << " sample rows are in damaged column blocks" << std::endl;
         }
 
         std::cout << "\nColumn store is ready for querying." << std::endl;
-        std::cout << "Use the column accessor methods (e.g., store.getTowns()->getData()[index]) to retrieve data." << std::endl;
+        std::cout << "Use the column accessor methods (e.g., store.getTowns()->pin().value(index)) to retrieve data." << std::endl;
 
     } else {
         std::cout << "No data loaded into the column store." << std::endl;
     }
 
-    // 1) Build the B+ tree indexes
-    std::cout << "Building the B+ Tree....." << std::endl;
-    IndexManager idxMgr("bptree");
-    idxMgr.buildIndexes(store); //takes about 2min
+    // 1) Build the B+ tree indexes, and snapshot the result for the next start
+    if (!indexesRestored) {
+        std::cout << "Building the B+ Tree....." << std::endl;
+        try {
+            idxMgr.buildIndexes(store); //takes about 2min
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;   // a damaged numeric column
+            return 1;
+        }
+
+        if (store.getCheckpointRowCount() > 0) {
+            SnapshotWriter out(store.snapshotPath());
+            if (store.writeSnapshot(out) && idxMgr.writeSnapshot(out) && out.commit()) {
+                std::cout << "Wrote snapshot " << store.snapshotPath() << " for the next start." << std::endl;
+            }
+        }
+    }
     
+    // Recheck the column files in the background while queries run
+    std::unique_ptr<ColumnScrubber> scrubber;
+    if (SCRUB_INTERVAL_SECONDS != 0) {
+        scrubber = std::make_unique<ColumnScrubber>(store, std::chrono::seconds(SCRUB_INTERVAL_SECONDS));
+    }
+
     // Query User Interface --> ask for query category and filters.
     if(store.getRowCount() > 0){
     int queryChoice = 0;
@@ -102,6 +160,8 @@ int main() {
     std::string outputFilename;
     bool writeHeader = true;
     bool askFilename = true;
+    int queryNumber = 0;   // numbers each query's Arrow result file
+    QueryArena arena;   // intermediates of one query; rewound after each
     
     while (true){
         std::cout << "=== Query Interface ===\n";
@@ -113,14 +173,18 @@ int main() {
             std::cout << "Input '2': MIN(Price)\n";
             std::cout << "Input '3': SD(Price)\n";
             std::cout << "Input '4': MIN(Price_per_sqm)\n";
+            std::cout << "Input '5': ALL CATEGORIES FOR EVERY TOWN (GROUP BY town)\n";
+            std::cout << "Input '6': DUMP METRICS (Prometheus text) to " << metricsFile << "\n";
+            std::cout << "Input '7': EXPORT THE WHOLE STORE (Arrow IPC) to " << storeExportFile << "\n";
+            std::cout << "Input '8': APPEND ROWS from a CSV file (same columns as " << csvFile << ")\n";
             std::cout << "Input '0': END QUERY\n";
-            std::cout << "Enter choice (0-4): ";
+            std::cout << "Enter choice (0-8): ";
 
             if (std::cin >> queryChoice) {
-                if (queryChoice >= 0 && queryChoice <= 4) {
+                if (queryChoice >= 0 && queryChoice <= 8) {
                     break;  // valid integer in range
                 } else {
-                    std::cout << "Invalid number. Please enter a number between 1 and 4.\n";
+                    std::cout << "Invalid number. Please enter a number between 1 and 8.\n";
                 }
             } else {
                 // Clear the fail state and ignore invalid input
@@ -130,12 +194,36 @@ int main() {
             }
         }
         if(queryChoice == 0) break;
+        if(queryChoice == 6) {
+            if (MetricsRegistry::shared().dumpToFile(metricsFile)) {
+                std::cout << "Metrics written to " << metricsFile << "\n";
+            }
+            continue;
+        }
+        if(queryChoice == 7) {
+            if (ArrowExport::exportStore(store, storeExportFile)) {
+                std::cout << "Store written to " << storeExportFile << "\n";
+            }
+            continue;
+        }
+        if(queryChoice == 8) {
+            // Logged and indexed before they are published, so the next
+            // query sees them; the column files take them at the next save
+            std::string appendFile;
+            std::cout << "Enter the CSV file to append:\n";
+            std::cin >> std::ws;
+            std::getline(std::cin, appendFile);
+            store.appendFromCSV(appendFile, [&](size_t begin, size_t end) { idxMgr.indexRows(store, begin, end); });
+            std::cout << "Total records available: " << store.getRowCount() << std::endl;
+            continue;
+        }
 
         switch (queryChoice) {
             case 1: queryCategory = "AVG(Price)"; break;
             case 2: queryCategory = "MIN(Price)"; break;
             case 3: queryCategory = "SD(Price)"; break;
             case 4: queryCategory = "MIN(Price_per_sqm)"; break;
+            case 5: queryCategory = "GROUP BY town"; break;
         }
         std::cin.ignore(); // clear newline from input buffer
 
@@ -175,9 +263,13 @@ int main() {
         }
         std::cin.ignore(); // clear newline from input buffer
 
-        // Ask for filter: town
+        // Ask for filter: town (a grouped report covers every town)
+        if (queryChoice != 5) {
         std::cout << "Enter town (e.g.,BEDOK, BUKIT PANJANG, CLEMENTI, CHOA CHU KANG, HOUGANG, JURONG WEST, PASIR RIS, TAMPINES, WOODLANDS, YISHUN):\n";
         std::getline(std::cin, town);
+        } else {
+            town = "ALL";
+        }
     
         // Ask for output filename
         if (askFilename){
@@ -196,6 +288,7 @@ int main() {
         std::cout << "Processing Query....." << std::endl;
 
         //Process Query
+        QueryArena::Scope arenaScope(arena);
         // 1) Construct intervals for:
         //    Month BETWEEN '2022-07' AND '2022-08'
         std::vector<Interval<std::string>> monthIVs;
@@ -205,28 +298,167 @@ int main() {
             monthIVs.push_back({ IntervalType::ClosedClosed, formatYearMonth(startYear,startMonth), formatYearMonth(startYear+1,1)});
         }
 
+        //    Area >= 80
+        std::vector<Interval<double>> areaIVs;
+        areaIVs.push_back({ IntervalType::FromClosed, 80.0, 0.0});
+
+        // Grouped report: one scan over the month/area matches, every category per town
+        if (queryChoice == 5) {
+            QueryProfile profile(queryCategory + " " + formatYearMonth(startYear, startMonth));
+            GroupByResult grouped;
+            RowIdList recordIds(QueryArena::current());
+            std::vector<AggregateSpec> aggs = {
+                { AggFunc::Avg,    Measure::Price },
+                { AggFunc::Min,    Measure::Price },
+                { AggFunc::StdDev, Measure::Price },
+                { AggFunc::Min,    Measure::PricePerSqm }
+            };
+            {
+                ProfileScope queryScope(profile.root());
+                auto view = store.pin();
+                recordIds = idxMgr.searchAll(
+                    monthIVs, /*townIVs=*/{},
+                    /*flatTypeIVs=*/{}, /*blockIVs=*/{}, /*streetIVs=*/{},
+                    /*storeyIVs=*/{}, areaIVs,
+                    /*modelIVs=*/{}, /*leaseDateIVs=*/{}, /*priceIVs=*/{},
+                    profile.root()
+                );
+                view.clip(recordIds);
+                GroupByEngine groupBy(store);
+                try {
+                    grouped = groupBy.run(recordIds, { GroupKey::Town }, aggs, profile.root());
+                } catch (const std::runtime_error& e) {
+                    // a numeric column read for the first time turned out damaged
+                    std::cerr << "Error: " << e.what() << "\nQuery failed; no result written." << std::endl;
+                    continue;
+                }
+                profile.root()->rowsOut = grouped.groups.size();
+            }
+            EngineMetrics::get().rowsReturned.inc(grouped.groups.size());
+            EngineMetrics::queryLatency(queryCategory).record(uint64_t(profile.root()->ms * 1e6));
+
+            std::cout << "\nGrouped Results (" << recordIds.size() << " rows, "
+                      << grouped.groups.size() << " towns):\n";
+            for (auto const& g : grouped.groups) {
+                std::cout << g.keyValues[0] << " (" << g.count << " rows)";
+                for (size_t a = 0; a < aggs.size(); a++) {
+                    std::cout << ", " << aggregateName(aggs[a]) << ": " << g.values[a];
+                    writeResultToCSV(outputFilename, aggregateName(aggs[a]), startYear, startMonth,
+                                     g.keyValues[0], g.values[a], writeHeader);
+                    writeHeader = false;
+                }
+                std::cout << '\n';
+            }
+            std::cout << '\n' << profile.explainAnalyze();
+            continue;
+        }
+
         //    Town = 'YISHUN'
         std::vector<Interval<std::string>> townIVs;
         townIVs.push_back({ IntervalType::ClosedClosed, town, town });
 
-        //    Area >= 80
-        std::vector<Interval<double>> areaIVs;
-        areaIVs.push_back({ IntervalType::FromClosed, 80.0, 0.0});
+        QueryProfile profile(queryCategory + " " + town + " " + formatYearMonth(startYear, startMonth));
+        ProfileScope queryScope(profile.root());
+        auto view = store.pin();   // rows appended from here on are not seen
+
+        ColumnStore::Rows rows(QueryArena::current());
+        bool covered = false;   // rows hold only month, town, floor area and price
+        size_t unreadable = 0;  // matching rows left out because a column block is damaged
+        if (idxMgr.hasTownMonthIndex()) {
+            // 2) Covering (town, month) index: one contiguous leaf scan carries
+            //    price and area, so no column file is read; area is filtered inline
+            auto entries = idxMgr.scanTownMonths(town, monthIVs[0].start, monthIVs[0].end, profile.root());
+            const Dictionary& townDict  = store.getTownDict();
+            const Dictionary& monthDict = store.getMonthDict();
+            for (auto const& e : entries) {
+                const TownMonthKey& key = e.first;
+                if (!view.sees(e.second) || key.second.second < areaIVs[0].start) continue;
+                ColumnStore::DataRow row{};
+                row.town        = townDict.decode(townDict.code(size_t(e.second)));
+                row.month       = monthDict.decode(monthDict.code(size_t(e.second)));
+                row.resalePrice = key.second.first;
+                row.floorArea   = key.second.second;
+                rows.emplace_back(e.second, std::move(row));
+            }
+            // Entries come in key order (month, price); aggregate in row
+            // order like the other paths, so the sums round the same way
+            std::sort(rows.begin(), rows.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+            covered = true;
+        } else if (store.isClustered() && store.getPrimaryIndex().keyColumns() == clusterKey
+                   && store.getPrimaryIndex().rowCount() == view.rows) {
+            // 2) Clustered by (month, town): each month's rows for the town are one
+            //    contiguous run of blocks, read sequentially; area is filtered inline
+            const auto& monthValues = store.getMonthDict().values;
+            const std::string& fromMonth = monthIVs[0].start;
+            const std::string& toMonth   = monthIVs[0].end;
+            for (auto m = std::lower_bound(monthValues.begin(), monthValues.end(), fromMonth);
+                 m != monthValues.end() && *m <= toMonth; ++m) {
+                ProfileNode* scan = profile.root()->child("ClusteredScan (" + *m + ", " + town + ")");
+                ProfileScope scanScope(scan);
+                auto range = store.clusteredRowRange({ *m, town }, { *m, town });
+                size_t missing = 0;
+                auto candidates = store.fetchRowRange(range.first, range.second, scan, &missing);
+                unreadable += missing;
+                size_t before = rows.size();
+                for (auto& pr : candidates) {
+                    if (pr.second.floorArea >= areaIVs[0].start) rows.push_back(std::move(pr));
+                }
+                scan->rowsIn  = candidates.size();
+                scan->rowsOut = rows.size() - before;
+                EngineMetrics::get().rowsScannedColumn.inc(candidates.size());
+            }
+        } else {
+            // 2) Run the multi‑attribute search
+            auto recordIds = idxMgr.searchAll(
+                monthIVs, townIVs,
+                /*flatTypeIVs=*/{}, /*blockIVs=*/{}, /*streetIVs=*/{},
+                /*storeyIVs=*/{}, areaIVs,
+                /*modelIVs=*/{}, /*leaseDateIVs=*/{}, /*priceIVs=*/{},
+                profile.root()
+            );
+            view.clip(recordIds);
+
+            // 3) Fetch the matching rows, rows is vector<pair<recordID, DataRow>>
+            ProfileNode* fetch = profile.root()->child("Fetch");
+            ProfileScope fetchScope(fetch);
+            rows = store.fetchRows(recordIds, fetch, &unreadable);
+            fetch->rowsIn = fetch->rowsOut = rows.size();
+        }
+        if (unreadable > 0) {
+            // an aggregate over the rows that could be read would be wrong, not partial
+            std::cerr << "Error: " << unreadable << " matching rows are in damaged column blocks"
+                      << "\nQuery failed; no result written." << std::endl;
+            continue;
+        }
+
+        // 4) Get result
+        {
+            ProfileNode* agg = profile.root()->child("Aggregate " + queryCategory);
+            ProfileScope aggScope(agg);
+            switch (queryChoice) {
+                case 1: calculated_result = average_result(rows); break;
+                case 2: calculated_result = min_result(rows); break;
+                case 3: calculated_result = sd_result(rows); break;
+                case 4: calculated_result = min_result_per_sqm(rows); break;
+            }
+            agg->rowsIn  = rows.size();
+            agg->rowsOut = 1;
+        }
+        profile.root()->rowsOut = 1;
+        queryScope.finish();
+        EngineMetrics::get().rowsReturned.inc(rows.size());
+        EngineMetrics::queryLatency(queryCategory).record(uint64_t(profile.root()->ms * 1e6));
 
-        // 2) Run the multi‑attribute search
-        auto recordIds = idxMgr.searchAll(
-            monthIVs, townIVs,
-            /*flatTypeIVs=*/{}, /*blockIVs=*/{}, /*streetIVs=*/{},
-            /*storeyIVs=*/{}, areaIVs,
-            /*modelIVs=*/{}, /*leaseDateIVs=*/{}, /*priceIVs=*/{}
-        );
-
-        // 3) Fetch and print the matching rows, rows is vector<pair<recordID, DataRow>>
-        auto rows = store.fetchRows(recordIds);
-        std::cout << "\nQuery Results (" << recordIds.size() << " rows):\n";
+        // 5) Print the matching rows
+        std::cout << "\nQuery Results (" << rows.size() << " rows):\n";
         for (auto const& pr : rows) {
             const auto& r = pr.second;
             const auto& idx = pr.first;
+            if (covered) {
+                std::cout << idx << ": " << r.month << ", " << r.town << ", "
+                          << r.floorArea << ", " << r.resalePrice << "\n";
+                continue;
+            }
             std::cout
                 << idx       << ": "
                 << r.month       << ", "
@@ -241,16 +473,17 @@ int main() {
                 << r.resalePrice << "\n";
         }
 
-        // 5)Get result
-        switch (queryChoice) {
-            case 1: calculated_result = average_result(rows); break;
-            case 2: calculated_result = min_result(rows); break;
-            case 3: calculated_result = sd_result(rows); break;
-            case 4: calculated_result = min_result_per_sqm(rows); break;
-        }
-
         std::cout << "Calculated Result " << queryCategory << ": " << calculated_result << '\n';
 
+        // 6) The matching rows, typed and columnar, for downstream tools
+        std::string arrowFile = fs::path(outputFilename).stem().string() + "_" + std::to_string(++queryNumber) + ".arrow";
+        unsigned arrowColumns = covered ? ArrowExport::Month | ArrowExport::Town | ArrowExport::FloorArea | ArrowExport::ResalePrice
+                                        : ArrowExport::AllColumns;
+        if (ArrowExport::exportRows(store, rows, arrowFile, arrowColumns)) {
+            std::cout << "Matching rows written to " << arrowFile << " (Arrow IPC)\n";
+        }
+        std::cout << '\n' << profile.explainAnalyze();
+
         writeResultToCSV(outputFilename, queryCategory,startYear,startMonth,town,calculated_result,writeHeader);
         writeHeader = false;
     }
@@ -297,52 +530,3 @@ std::string formatYearMonth(int year, int month) {
         << std::setw(2) << std::setfill('0') << month;
     return oss.str();
 }
-
-double average_result(std::vector<std::pair<int, ColumnStore::DataRow>> rows){
-    double sum = 0.00;
-    int count = 0;
-    for (auto const& pr : rows) {
-        const auto& r = pr.second;
-        sum = sum + r.resalePrice;
-        count++;
-    }
-    return sum/count;
-}
-
-double min_result(std::vector<std::pair<int, ColumnStore::DataRow>> rows){
-    double min = 999999999999;
-    for (auto const& pr : rows) {
-        const auto& r = pr.second;
-        if(min>= r.resalePrice){
-            min = r.resalePrice;
-        }
-    }
-    return min;
-}
-
-double min_result_per_sqm(std::vector<std::pair<int, ColumnStore::DataRow>> rows){
-    double min = 999999999999;
-    for (auto const& pr : rows) {
-        const auto& r = pr.second;
-        if(min>= r.resalePrice / r.floorArea){
-            min = r.resalePrice / r.floorArea;
-        }
-    }
-    return min;
-}
-
-double sd_result(std::vector<std::pair<int, ColumnStore::DataRow>> rows){
-    double sum = 0.00;
-    double squared_sum = 0.00;
-    int count = 0;
-    for (auto const& pr : rows) {
-        const auto& r = pr.second;
-        sum = sum + r.resalePrice;
-        squared_sum = squared_sum + r.resalePrice * r.resalePrice;
-        count++;
-    }
-
-    double mean = sum/count;
-    double variance = squared_sum/count - mean * mean;
-    return std::sqrt(variance);
-}
\ No newline at end of file